@@ -0,0 +1,295 @@
+#ifndef D1A7C3F5_2E9B_4B60_8F4D_6C0E5A9B7D32
+#define D1A7C3F5_2E9B_4B60_8F4D_6C0E5A9B7D32
+
+#include "calculator.hpp"
+#include "counter_random.hpp"
+#include "fit_options.hpp"
+#include "math_function.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The BootstrapAnalysis class estimates the uncertainty of fitted
+ * coefficients and the stability of the model selection by resampling.
+ *
+ * A resample is never copied: replicate r fits the original points with
+ * weights w[i] * c[i], where c[i] is how often point i was drawn (bootstrap)
+ * or 0 for the left-out point and 1 otherwise (jackknife). Every replicate
+ * runs the full model selection, which gives the selection frequencies, and
+ * refits the function selected on the full data, which gives the
+ * coefficient distributions.
+ *
+ * The draws of replicate r come from a counter-based generator keyed by
+ * (seed, r), so the results do not depend on the number of workers or on
+ * which worker runs which replicate. Replicates are spread over the workers
+ * with parallel_for; each worker reuses one weight and count buffer.
+ */
+class BootstrapAnalysis {
+public:
+  /**
+   * @brief The resampling scheme.
+   */
+  enum class Method {
+    Bootstrap, /**< Draw n points with replacement, percentile intervals. */
+    Jackknife  /**< Leave out one point per replicate, normal intervals. */
+  };
+
+  /**
+   * @brief The Settings struct configures an analysis.
+   */
+  struct Settings {
+    Method method{Method::Bootstrap}; /**< The resampling scheme. */
+    int replicates{1000};             /**< Resamples (jackknife: n). */
+    std::uint64_t seed{1};            /**< The seed of the resampling. */
+    double confidence{0.95};          /**< The coverage of the intervals. */
+    unsigned workers{0};              /**< Worker threads, zero for all. */
+  };
+
+  /**
+   * @brief The uncertainty of one coefficient.
+   */
+  struct Interval {
+    double estimate;       /**< The coefficient fitted on the full data. */
+    double lower;          /**< The lower bound of the interval. */
+    double upper;          /**< The upper bound of the interval. */
+    double standard_error; /**< The resampling standard error. */
+  };
+
+  /**
+   * @brief How often one function won the model selection.
+   */
+  struct Selection {
+    Function function; /**< The selected function. */
+    int wins;          /**< The number of replicates that selected it. */
+  };
+
+  /**
+   * @brief The Report struct holds the result of an analysis.
+   */
+  struct Report {
+    Function function{Function::Type::Polynomial, 1}; /**< Full-data fit. */
+    std::vector<double> coefficients;  /**< Full-data coefficients. */
+    std::vector<Interval> intervals;   /**< One per coefficient. */
+    std::vector<Selection> selections; /**< By decreasing wins. */
+    int replicates{0};                 /**< The replicates run. */
+    int failed{0}; /**< Replicates without finite coefficients. */
+  };
+
+  /**
+   * @brief Fits the data and resamples it according to settings.
+   * @param x The x-values of the data points.
+   * @param y The y-values of the data points.
+   * @param w The weights of the data points (empty for unit weights).
+   * @param options The options used for model selection and fitting.
+   * @param settings The resampling settings.
+   * @return The full-data fit with coefficient intervals and selection
+   * frequencies.
+   */
+  static Report analyze(std::vector<double> const &x,
+                        std::vector<double> const &y,
+                        std::vector<double> const &w,
+                        FitOptions const &options, Settings const &settings) {
+    auto n = static_cast<int>(x.size());
+    Report report;
+    report.function =
+        ApproximationCalculator::find_best_function(n, x, y, w, options);
+    report.coefficients = ApproximationCalculator::approximation_calculation(
+        report.function, n, x, y, w, options);
+    auto jackknife = settings.method == Method::Jackknife;
+    report.replicates = jackknife ? n : std::max(0, settings.replicates);
+
+    auto p = report.coefficients.size();
+    auto replicates = static_cast<std::size_t>(report.replicates);
+    std::vector<double> samples(replicates * p, NAN);
+    std::vector<Function> winners(replicates, report.function);
+
+    auto workers = settings.workers == 0 ? worker_count() : settings.workers;
+    std::vector<Workspace> workspaces(workers);
+    parallel_for(
+        replicates,
+        [&](std::size_t begin, std::size_t end, unsigned worker) {
+          auto &workspace = workspaces[worker];
+          workspace.weights.resize(n);
+          workspace.counts.resize(n);
+          for (auto r = begin; r < end; ++r) {
+            if (jackknife) {
+              leave_out(w, static_cast<int>(r), workspace);
+            } else {
+              resample(w, settings.seed, r, workspace);
+            }
+            auto const &weights = workspace.weights;
+            winners[r] = ApproximationCalculator::find_best_function(
+                n, x, y, weights, options);
+            // In the basis of the full-data fit, so that the coefficient
+            // samples are comparable
+            auto coefficients =
+                ApproximationCalculator::approximation_in_basis(
+                    report.function, n, x, y, weights, options);
+            if (coefficients.size() == p) {
+              std::copy(coefficients.begin(), coefficients.end(),
+                        samples.begin() + r * p);
+            }
+          }
+        },
+        workers);
+
+    report.intervals.reserve(p);
+    std::vector<double> values;
+    for (std::size_t k = 0; k < p; ++k) {
+      values.clear();
+      for (std::size_t r = 0; r < replicates; ++r) {
+        if (std::isfinite(samples[r * p + k])) {
+          values.push_back(samples[r * p + k]);
+        }
+      }
+      report.intervals.push_back(
+          jackknife ? jackknife_interval(report.coefficients[k], values,
+                                         settings.confidence)
+                    : percentile_interval(report.coefficients[k], values,
+                                          settings.confidence));
+    }
+    for (std::size_t r = 0; r < replicates; ++r) {
+      auto finite = true;
+      for (std::size_t k = 0; k < p; ++k) {
+        finite = finite && std::isfinite(samples[r * p + k]);
+      }
+      report.failed += !finite;
+    }
+
+    for (std::size_t r = 0; r < replicates; ++r) {
+      auto name = winners[r].to_string();
+      auto it = std::find_if(
+          report.selections.begin(), report.selections.end(),
+          [&name](auto const &s) { return s.function.to_string() == name; });
+      if (it == report.selections.end()) {
+        report.selections.push_back({winners[r], 1});
+      } else {
+        ++it->wins;
+      }
+    }
+    std::stable_sort(
+        report.selections.begin(), report.selections.end(),
+        [](auto const &a, auto const &b) { return a.wins > b.wins; });
+    return report;
+  }
+
+  /**
+   * @brief Computes the quantile of the standard normal distribution.
+   * @param probability The probability, in (0, 1).
+   */
+  static double normal_quantile(double probability) {
+    // Bisection on the CDF; 64 halvings of [-10, 10] reach full precision
+    auto low = -10.0;
+    auto high = 10.0;
+    for (int i = 0; i < 64; ++i) {
+      auto middle = 0.5 * (low + high);
+      if (0.5 * std::erfc(-middle / std::sqrt(2.0)) < probability) {
+        low = middle;
+      } else {
+        high = middle;
+      }
+    }
+    return 0.5 * (low + high);
+  }
+
+private:
+  /**
+   * @brief The buffers one worker reuses for all of its replicates.
+   */
+  struct Workspace {
+    std::vector<double> weights; /**< The replicate weights. */
+    std::vector<int> counts;     /**< How often each point was drawn. */
+  };
+
+  /**
+   * @brief Fills workspace.weights with the weights of bootstrap replicate r.
+   */
+  static void resample(std::vector<double> const &w, std::uint64_t seed,
+                       std::size_t r, Workspace &workspace) {
+    auto n = workspace.counts.size();
+    std::fill(workspace.counts.begin(), workspace.counts.end(), 0);
+    CounterRandom random(seed, r);
+    for (std::size_t i = 0; i < n; ++i) {
+      ++workspace.counts[random.below(n)];
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      workspace.weights[i] =
+          ApproximationCalculator::weight_at(w, static_cast<int>(i)) *
+          workspace.counts[i];
+    }
+  }
+
+  /**
+   * @brief Fills workspace.weights with the weights of jackknife replicate r.
+   */
+  static void leave_out(std::vector<double> const &w, int r,
+                        Workspace &workspace) {
+    auto n = static_cast<int>(workspace.weights.size());
+    for (int i = 0; i < n; ++i) {
+      workspace.weights[i] = ApproximationCalculator::weight_at(w, i);
+    }
+    workspace.weights[r] = 0.0;
+  }
+
+  static double standard_deviation(std::vector<double> const &values) {
+    if (values.size() < 2) {
+      return NAN;
+    }
+    auto mean = 0.0;
+    for (auto value : values) {
+      mean += value;
+    }
+    mean /= static_cast<double>(values.size());
+    auto squares = 0.0;
+    for (auto value : values) {
+      squares += (value - mean) * (value - mean);
+    }
+    return std::sqrt(squares / static_cast<double>(values.size() - 1));
+  }
+
+  /**
+   * @brief Builds the bootstrap percentile interval of one coefficient.
+   */
+  static Interval percentile_interval(double estimate,
+                                      std::vector<double> &values,
+                                      double confidence) {
+    if (values.empty()) {
+      return {estimate, NAN, NAN, NAN};
+    }
+    std::sort(values.begin(), values.end());
+    auto quantile = [&values](double probability) {
+      // Linear interpolation between the closest order statistics
+      auto position = probability * static_cast<double>(values.size() - 1);
+      auto index = static_cast<std::size_t>(position);
+      auto next = std::min(index + 1, values.size() - 1);
+      auto fraction = position - static_cast<double>(index);
+      return values[index] + fraction * (values[next] - values[index]);
+    };
+    auto tail = 0.5 * (1.0 - confidence);
+    return {estimate, quantile(tail), quantile(1.0 - tail),
+            standard_deviation(values)};
+  }
+
+  /**
+   * @brief Builds the jackknife normal interval of one coefficient.
+   *
+   * The jackknife standard error is sqrt((m - 1) / m * sum((c_i - mean)^2))
+   * over the m leave-one-out coefficients c_i.
+   */
+  static Interval jackknife_interval(double estimate,
+                                     std::vector<double> const &values,
+                                     double confidence) {
+    auto m = static_cast<double>(values.size());
+    auto error = standard_deviation(values) * (m - 1.0) / std::sqrt(m);
+    auto z = normal_quantile(0.5 + 0.5 * confidence);
+    return {estimate, estimate - z * error, estimate + z * error, error};
+  }
+};
+
+#endif /* D1A7C3F5_2E9B_4B60_8F4D_6C0E5A9B7D32 */
@@ -1,9 +1,18 @@
 #ifndef B31A80AB_5724_4C6A_81ED_F301F749F738
 #define B31A80AB_5724_4C6A_81ED_F301F749F738
+#include "cholesky.hpp"
+#include "fit_options.hpp"
+#include "fit_result.hpp"
 #include "math_function.hpp"
+#include "polynomial_moments.hpp"
+#include "summation.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <numeric>
+#include <stdexcept>
+#include <tuple>
 #include <vector>
 
 /**
@@ -11,32 +20,188 @@
  * approximation.
  */
 class ApproximationCalculator {
+  friend class BootstrapAnalysis;
+  friend class FitEngine;
+  friend class MultiSeriesFitter;
+  friend class ResultWriter;
+  friend class RollingWindowFitter;
+  friend class SampledFitter;
+  friend class SegmentedFitter;
+
 private:
   Function function;     /**< The type of function to approximate. */
   std::vector<double> x; /**< The x-values of the data points. */
   std::vector<double> y; /**< The y-values of the data points. */
+  std::vector<double> w; /**< The weights of the data points (empty for unit
+                            weights). */
   std::vector<double>
-      coefficients; /**< The coefficients of the approximated function. */
+      coefficients;   /**< The coefficients of the approximated function. */
+  FitOptions options; /**< The options used when fitting the function. */
   constexpr static double ACC =
       1e-4; /**< The accuracy for approximation calculations. */
+  constexpr static double NORMALIZED_ACC =
+      1e-10; /**< The solver accuracy for data mapped onto [-1, 1]. */
+  constexpr static int MAX_SWEEPS =
+      1000; /**< Gauss-Seidel sweeps before the direct solver takes over. */
+  constexpr static double MAX_EXPANSION_GROWTH =
+      1e2; /**< The growth of the terms up to which coefficients expand. */
+  constexpr static int CANCEL_POLL_ROWS =
+      1 << 14; /**< Rows between polls of FitOptions::cancel. */
+
+  /**
+   * @brief Checks every CANCEL_POLL_ROWS rows of a pass over the data
+   * whether the fit was cancelled, so that long passes stop early.
+   */
+  static bool cancelled_at(int i, FitOptions const &options) {
+    return i % CANCEL_POLL_ROWS == 0 && options.is_cancelled();
+  }
+
+  /**
+   * @brief The affine change of variable v -> (v - shift) / scale applied to
+   * the data before fitting.
+   */
+  struct AffineMap {
+    double shift = 0.0; /**< The value mapped to zero. */
+    double scale = 1.0; /**< The half-width mapped to one. */
+
+    /**
+     * @brief Maps the first n values onto [-1, 1], or returns the identity
+     * if they do not span a finite, non-empty range.
+     */
+    static AffineMap onto_unit_interval(std::vector<double> const &values,
+                                        int n) {
+      if (n <= 0) {
+        return {};
+      }
+      auto [low, high] =
+          std::minmax_element(values.begin(), values.begin() + n);
+      AffineMap map{0.5 * (*low + *high), 0.5 * (*high - *low)};
+      if (!(map.scale > 0.0) || !std::isfinite(map.scale) ||
+          !std::isfinite(map.shift)) {
+        return {};
+      }
+      return map;
+    }
+
+    double operator()(double v) const { return (v - shift) / scale; }
+  };
+
+  /**
+   * @brief Maps the values of t (x, or ln x) of the data onto [-1, 1], or
+   * returns the identity if they do not span a finite, non-empty range.
+   *
+   * For ln x the half-width is taken as ln(high / low), which keeps its
+   * digits for narrow ranges far from x = 1.
+   */
+  static AffineMap variable_map(Function const &func, int n,
+                                std::vector<double> const &x) {
+    if (!func.is_of_log_x()) {
+      return AffineMap::onto_unit_interval(x, n);
+    }
+    if (n <= 0) {
+      return {};
+    }
+    auto [low, high] = std::minmax_element(x.begin(), x.begin() + n);
+    if (!(*low > 0.0)) {
+      return {};
+    }
+    AffineMap map{0.5 * (std::log(*low) + std::log(*high)),
+                  0.5 * std::log(*high / *low)};
+    if (!(map.scale > 0.0) || !std::isfinite(map.scale) ||
+        !std::isfinite(map.shift)) {
+      return {};
+    }
+    return map;
+  }
+
+  /**
+   * @brief Retrieves func in the basis its data are fitted in: t mapped onto
+   * [-1, 1], or t itself if options.normalize_data is off.
+   */
+  static Function fitting_basis(Function const &func, int n,
+                                std::vector<double> const &x,
+                                FitOptions const &options) {
+    AffineMap map;
+    if (options.normalize_data) {
+      map = variable_map(func, n, x);
+    }
+    return func.in_basis(map.shift, map.scale);
+  }
+
+  /**
+   * @brief Expands coefficients fitted in a basis to coefficients of t when
+   * that is well conditioned over the data, and keeps the basis otherwise.
+   *
+   * The expansion is accepted when its terms, bounded over the data range,
+   * grow by at most MAX_EXPANSION_GROWTH against the curve: in the basis
+   * |u| <= 1, so the curve is bounded by the sum of |c_k|. Data far from the
+   * origin, such as timestamps, keep the basis and their digits.
+   */
+  static void expand_if_well_conditioned(Function &func,
+                                         std::vector<double> &coefficients) {
+    if (!func.has_basis()) {
+      return;
+    }
+    auto expanded = func.rebase(coefficients, 0.0, 1.0);
+    for (auto &&c : expanded) {
+      if (!std::isfinite(c)) {
+        return;
+      }
+    }
+    auto reach = std::max(std::fabs(func.get_shift() - func.get_scale()),
+                          std::fabs(func.get_shift() + func.get_scale()));
+    auto growth = 0.0;
+    switch (func.get_type()) {
+    case Function::Type::Polynomial:
+    case Function::Type::Logarithmic: {
+      auto size = 0.0;
+      auto terms = 0.0;
+      auto power = 1.0;
+      for (std::size_t k = 0; k < coefficients.size(); ++k) {
+        size += std::fabs(coefficients[k]);
+        terms += std::fabs(expanded[k]) * power;
+        power *= reach;
+      }
+      growth = size > 0.0 ? terms / size : 1.0;
+      break;
+    }
+    case Function::Type::Exponential:
+    case Function::Type::Power:
+      // The exponent over the data, which exp() turns into relative error
+      growth = (1.0 + std::fabs(expanded[1]) * reach) /
+               (1.0 + std::fabs(coefficients[1]));
+      if (expanded[0] == 0.0 && coefficients[0] != 0.0) {
+        return;
+      }
+      break;
+    }
+    if (growth <= MAX_EXPANSION_GROWTH) {
+      func = func.in_basis(0.0, 1.0);
+      coefficients = expanded;
+    }
+  }
 
-  static double get_function_value(Function func,
+  static double get_function_value(Function const &func,
                                    std::vector<double> const &coefficients,
                                    double x) {
     switch (func.get_type()) {
     case Function::Type::Polynomial: {
+      auto u = func.basis_value(x);
       double sum = 0.0;
-      for (int i = 0; i < func.get_m(); ++i) {
-        sum += coefficients[i] * pow(x, i);
+      for (int i = func.get_m(); i >= 0; --i) {
+        sum = sum * u + coefficients[i];
       }
       return sum;
     }
     case Function::Type::Exponential:
-      return coefficients[0] * exp(coefficients[1] * x);
+      return coefficients[0] * exp(coefficients[1] * func.basis_value(x));
     case Function::Type::Logarithmic:
-      return coefficients[0] + coefficients[1] * log(x);
+      return coefficients[0] + coefficients[1] * func.basis_value(x);
     case Function::Type::Power:
-      return coefficients[0] * pow(x, coefficients[1]);
+      if (!func.has_basis()) {
+        return coefficients[0] * pow(x, coefficients[1]);
+      }
+      return coefficients[0] * exp(coefficients[1] * func.basis_value(x));
     default:
       throw std::invalid_argument("Unsupported function");
     }
@@ -46,7 +211,7 @@ private:
   linear_interpolation(int n, std::vector<std::vector<double>> &a,
                        std::vector<double> const &b, double e) {
     std::vector<double> v_x(n, 0.0);
-    while (true) {
+    for (int sweep = 0; sweep < MAX_SWEEPS; ++sweep) {
       auto delta = 0.0;
       for (int i = 0; i < n; ++i) {
         auto s = 0.0;
@@ -63,68 +228,365 @@ private:
         v_x[i] = x_new;
       }
       if (delta < e) {
-        break;
+        return v_x;
       }
     }
+    // Slow convergence means an ill-conditioned matrix; solve it directly
+    CholeskyDecomposition cholesky(a);
+    if (cholesky.is_positive_definite()) {
+      return cholesky.solve(b);
+    }
     return v_x;
   }
 
+  static double weight_at(std::vector<double> const &w, int i) {
+    return w.empty() ? 1.0 : w[i];
+  }
+
+  /**
+   * @brief Invokes body with a default-constructed accumulator of the kind
+   * selected by precision, so that one templated kernel serves every mode.
+   * Float has no kernel here: its data is stored as float only by the
+   * multivariate regression, and the entry points reject it for the fits.
+   */
+  template <typename Body>
+  static auto with_accumulator(FitOptions::Precision precision, Body &&body) {
+    switch (precision) {
+    case FitOptions::Precision::Compensated:
+      return body(KahanSum());
+    case FitOptions::Precision::Pairwise:
+      return body(PairwiseSum());
+    case FitOptions::Precision::Double:
+    case FitOptions::Precision::Float:
+    default:
+      return body(PlainSum());
+    }
+  }
+
+  /**
+   * @brief Accumulates the weighted normal equations of a polynomial fit of
+   * degree m.
+   *
+   * The matrix is a Hankel matrix of the power sums sum(w * x^k), so only
+   * 2m + 1 sums plus the m + 1 right-hand side sums are accumulated, in a
+   * single pass over the data. The points are mapped by x_map and y_map on
+   * the fly. A cancelled fit stops the pass early.
+   */
+  static void accumulate_moments(int m, int n, std::vector<double> const &x,
+                                 std::vector<double> const &y,
+                                 std::vector<double> const &w,
+                                 AffineMap x_map, AffineMap y_map,
+                                 std::vector<std::vector<double>> &matrix,
+                                 std::vector<double> &b,
+                                 FitOptions const &options) {
+    with_accumulator(options.precision, [&](auto accumulator) {
+      BasicPolynomialMoments<decltype(accumulator)> moments(m);
+      for (int j = 0; j < n && !cancelled_at(j, options); ++j) {
+        moments.add(x_map(x[j]), y_map(y[j]), weight_at(w, j));
+      }
+      matrix = moments.normal_matrix(m);
+      b = moments.right_hand_side(m);
+    });
+  }
+
+  /**
+   * @brief Fits y = a * exp(b * t) by Levenberg-Marquardt with an analytic
+   * Jacobian, starting from the given coefficients.
+   *
+   * Exponential models use t = x and power models use t = ln(x), so both
+   * share this kernel. The basis values exp(b * t) are evaluated once per
+   * objective evaluation into a contiguous buffer and reused for the
+   * residuals and both Jacobian columns. At most
+   * options.max_refinement_iterations steps are accepted; a step rejects
+   * trials only until the damping leaves [1e-12, 1e12], so it evaluates the
+   * objective at most about 25 times, which bounds the cost of a fit. A
+   * cancelled fit stops early.
+   */
   static std::vector<double>
-  approximation_calculation(Function func, int n, std::vector<double> const &x,
-                            std::vector<double> const &y) {
-    switch (func.get_type()) {
-    case Function::Type::Polynomial: {
-      std::vector<double> b(func.get_m() + 1, 0.0);
-      std::vector<std::vector<double>> matrix(
-          func.get_m() + 1, std::vector<double>(func.get_m() + 1, 0.0));
-      for (int i = 0; i <= func.get_m(); ++i) {
-        for (int j = 0; j < n; ++j) {
-          b[i] += std::pow(x[j], i) * y[j];
-        }
+  levenberg_marquardt(std::vector<double> const &t,
+                      std::vector<double> const &y,
+                      std::vector<double> const &w,
+                      std::vector<double> coefficients,
+                      FitOptions const &options) {
+    auto n = static_cast<int>(t.size());
+    std::vector<double> basis(n);
+    std::vector<double> trial_basis(n);
+
+    auto sum_of_squares = [&](double a, double b, std::vector<double> &g) {
+      auto sum = 0.0;
+      for (int i = 0; i < n; ++i) {
+        g[i] = std::exp(b * t[i]);
+        auto r = y[i] - a * g[i];
+        sum += weight_at(w, i) * r * r;
       }
-      for (int i = 0; i <= func.get_m(); ++i) {
-        for (int j = 0; j <= func.get_m(); ++j) {
-          auto val = 0.0;
-          for (auto &&xi : x) {
-            val += std::pow(xi, i + j);
+      return sum;
+    };
+
+    auto a = coefficients[0];
+    auto b = coefficients[1];
+    auto sse = sum_of_squares(a, b, basis);
+    if (!std::isfinite(sse)) {
+      return coefficients;
+    }
+    auto lambda = 1e-3;
+    for (int iteration = 0; iteration < options.max_refinement_iterations &&
+                            sse > 0.0 && !options.is_cancelled();
+         ++iteration) {
+      // Normal equations J^T W J and J^T W r at the current point
+      auto jaa = 0.0;
+      auto jab = 0.0;
+      auto jbb = 0.0;
+      auto ra = 0.0;
+      auto rb = 0.0;
+      for (int i = 0; i < n; ++i) {
+        auto wi = weight_at(w, i);
+        auto ga = basis[i];
+        auto gb = a * t[i] * basis[i];
+        auto r = y[i] - a * basis[i];
+        jaa += wi * ga * ga;
+        jab += wi * ga * gb;
+        jbb += wi * gb * gb;
+        ra += wi * ga * r;
+        rb += wi * gb * r;
+      }
+
+      auto improved = false;
+      auto converged = false;
+      while (!improved && !options.is_cancelled()) {
+        auto m00 = jaa * (1.0 + lambda);
+        auto m11 = jbb * (1.0 + lambda);
+        auto det = m00 * m11 - jab * jab;
+        if (!(det > 0.0)) {
+          lambda *= 10.0;
+          if (lambda > 1e12) {
+            return {a, b};
+          }
+          continue;
+        }
+        auto da = (ra * m11 - jab * rb) / det;
+        auto db = (m00 * rb - jab * ra) / det;
+        auto trial_sse = sum_of_squares(a + da, b + db, trial_basis);
+        if (std::isfinite(trial_sse) && trial_sse < sse) {
+          converged = std::fabs(da) <= ACC * (std::fabs(a) + ACC) &&
+                      std::fabs(db) <= ACC * (std::fabs(b) + ACC);
+          a += da;
+          b += db;
+          sse = trial_sse;
+          std::swap(basis, trial_basis);
+          lambda = std::max(lambda / 10.0, 1e-12);
+          improved = true;
+        } else {
+          lambda *= 10.0;
+          if (lambda > 1e12) {
+            return {a, b};
           }
-          matrix[i][j] = val;
         }
       }
-      return linear_interpolation(func.get_m() + 1, matrix, b, ACC);
+      if (converged) {
+        break;
+      }
     }
-    case Function::Type::Exponential: {
-      std::vector<double> lny;
-      lny.reserve(y.size());
-      for (auto &&yi : y) {
-        lny.push_back(std::log(yi));
+    return {a, b};
+  }
+
+  /**
+   * @brief Fits the function by (weighted) least squares.
+   *
+   * The data are fitted in the basis returned by fitting_basis, where the
+   * normal equations are well conditioned for any range, and the
+   * coefficients are then converted to the basis of func.
+   */
+  static std::vector<double> least_squares_calculation(
+      Function func, int n, std::vector<double> const &x,
+      std::vector<double> const &y, std::vector<double> const &w,
+      FitOptions const &options) {
+    auto const basis = fitting_basis(func, n, x, options);
+    switch (func.get_type()) {
+    case Function::Type::Polynomial: {
+      // On [-1, 1] the power sums stay within a few orders of magnitude, so
+      // the solver converges in a bounded number of sweeps for any range
+      AffineMap const x_map{basis.get_shift(), basis.get_scale()};
+      AffineMap y_map;
+      if (options.normalize_data) {
+        y_map = AffineMap::onto_unit_interval(y, n);
+      }
+      std::vector<double> b;
+      std::vector<std::vector<double>> matrix;
+      accumulate_moments(func.get_m(), n, x, y, w, x_map, y_map, matrix, b,
+                         options);
+      auto c = linear_interpolation(
+          func.get_m() + 1, matrix, b,
+          options.normalize_data ? NORMALIZED_ACC : ACC);
+      for (auto &ck : c) {
+        ck *= y_map.scale;
       }
-      auto a = approximation_calculation(
-          Function(Function::Type::Polynomial, 1), n, x, lny);
-      a[0] = std::exp(a[0]);
-      return a;
+      c[0] += y_map.shift;
+      return basis.rebase(c, func.get_shift(), func.get_scale());
     }
+    case Function::Type::Logarithmic: {
+      // u is taken from x directly rather than from a rounded ln x
+      std::vector<double> u(n);
+      for (int i = 0; i < n; ++i) {
+        if (!(x[i] > 0.0)) {
+          return {NAN, NAN};
+        }
+        u[i] = basis.basis_value(x[i]);
+      }
+      auto c = least_squares_calculation(
+          Function(Function::Type::Polynomial, 1), n, u, y, w, options);
+      return basis.rebase(c, func.get_shift(), func.get_scale());
+    }
+    case Function::Type::Exponential:
     case Function::Type::Power: {
-      std::vector<double> lnx;
-      lnx.reserve(x.size());
+      // y = a * exp(b * u), with u the basis value of t = x for exponential
+      // and of t = ln(x) for power models
+      auto const is_power = func.get_type() == Function::Type::Power;
+      std::vector<double> u(n);
+      for (int i = 0; i < n; ++i) {
+        if ((is_power && !(x[i] > 0.0)) || cancelled_at(i, options)) {
+          return {NAN, NAN};
+        }
+        u[i] = basis.basis_value(x[i]);
+      }
+
+      // Initial estimate from the log-linear fit over the positive y values
+      std::vector<double> log_u;
       std::vector<double> lny;
-      lny.reserve(y.size());
-      return approximation_calculation(Function(Function::Type::Polynomial, 1),
-                                       n, lnx, lny);
-    }
+      std::vector<double> log_w;
+      log_u.reserve(n);
+      lny.reserve(n);
+      log_w.reserve(w.size());
+      for (int i = 0; i < n; ++i) {
+        if (cancelled_at(i, options)) {
+          return {NAN, NAN};
+        }
+        if (y[i] > 0.0) {
+          log_u.push_back(u[i]);
+          lny.push_back(std::log(y[i]));
+          if (!w.empty()) {
+            log_w.push_back(w[i]);
+          }
+        }
+      }
+      std::vector<double> a;
+      if (log_u.size() >= 2) {
+        a = least_squares_calculation(Function(Function::Type::Polynomial, 1),
+                                      static_cast<int>(log_u.size()), log_u,
+                                      lny, log_w, options);
+        a[0] = std::exp(a[0]);
+      } else {
+        a = {std::accumulate(y.begin(), y.begin() + n, 0.0) / n, 0.0};
+      }
 
-    case Function::Type::Logarithmic: {
-      std::vector<double> lnx;
-      lnx.reserve(x.size());
-      return approximation_calculation(Function(Function::Type::Polynomial, 1),
-                                       n, lnx, y);
+      if (options.nonlinear_refinement) {
+        a = levenberg_marquardt(u, y, w, a, options);
+      }
+      return basis.rebase(a, func.get_shift(), func.get_scale());
     }
     }
     return {};
   }
 
+  /**
+   * @brief Fits the function by iteratively reweighted least squares.
+   *
+   * Each pass scales the residuals by their median absolute deviation, turns
+   * them into Huber or Tukey weights and re-solves the weighted normal
+   * equations. The loop stops once the coefficients settle or after
+   * options.max_robust_iterations passes.
+   */
+  static std::vector<double>
+  irls_calculation(Function func, int n, std::vector<double> const &x,
+                   std::vector<double> const &y, std::vector<double> const &w,
+                   FitOptions const &options) {
+    auto coefficients = least_squares_calculation(func, n, x, y, w, options);
+    auto const huber = options.robust_loss == FitOptions::RobustLoss::Huber;
+    auto tuning = options.robust_tuning > 0.0 ? options.robust_tuning
+                  : huber                     ? 1.345
+                                              : 4.685;
+    std::vector<double> abs_residuals(n);
+    std::vector<double> robust_w(n);
+    for (int iteration = 0; iteration < options.max_robust_iterations &&
+                            !options.is_cancelled();
+         ++iteration) {
+      auto residuals = differences_calculation(func, n, coefficients, x, y);
+      for (int i = 0; i < n; ++i) {
+        abs_residuals[i] = std::fabs(residuals[i]);
+      }
+      auto median = abs_residuals.begin() + n / 2;
+      std::nth_element(abs_residuals.begin(), median, abs_residuals.end());
+      auto scale = tuning * 1.4826 * *median;
+      if (!(scale > 0.0) || !std::isfinite(scale)) {
+        break;
+      }
+
+      for (int i = 0; i < n; ++i) {
+        auto u = std::fabs(residuals[i]) / scale;
+        double robust_weight;
+        if (huber) {
+          robust_weight = u <= 1.0 ? 1.0 : 1.0 / u;
+        } else {
+          robust_weight = u < 1.0 ? (1.0 - u * u) * (1.0 - u * u) : 0.0;
+        }
+        robust_w[i] = weight_at(w, i) * robust_weight;
+      }
+
+      auto next = least_squares_calculation(func, n, x, y, robust_w, options);
+      auto converged = true;
+      for (std::size_t i = 0; i < next.size(); ++i) {
+        if (!std::isfinite(next[i])) {
+          return coefficients;
+        }
+        if (std::fabs(next[i] - coefficients[i]) >
+            ACC * (std::fabs(coefficients[i]) + ACC)) {
+          converged = false;
+        }
+      }
+      coefficients = next;
+      if (converged) {
+        break;
+      }
+    }
+    return coefficients;
+  }
+
+  /**
+   * @brief Fits the function, returning its coefficients in the basis of
+   * func, so that fits of resampled data share one basis.
+   */
+  static std::vector<double>
+  approximation_in_basis(Function const &func, int n,
+                         std::vector<double> const &x,
+                         std::vector<double> const &y,
+                         std::vector<double> const &w = {},
+                         FitOptions const &options = FitOptions()) {
+    if (options.robust_loss != FitOptions::RobustLoss::None) {
+      return irls_calculation(func, n, x, y, w, options);
+    }
+    return least_squares_calculation(func, n, x, y, w, options);
+  }
+
+  /**
+   * @brief Fits the function and chooses the basis of its coefficients.
+   *
+   * The coefficients are fitted in t mapped onto [-1, 1] and expanded to
+   * coefficients of t only when expand_if_well_conditioned allows it. On
+   * return func holds the basis of the coefficients.
+   */
+  static std::vector<double>
+  approximation_calculation(Function &func, int n,
+                            std::vector<double> const &x,
+                            std::vector<double> const &y,
+                            std::vector<double> const &w = {},
+                            FitOptions const &options = FitOptions()) {
+    func = fitting_basis(func, n, x, options);
+    auto coefficients = approximation_in_basis(func, n, x, y, w, options);
+    expand_if_well_conditioned(func, coefficients);
+    return coefficients;
+  }
+
   static std::vector<double> differences_calculation(
-      Function f, int n, std::vector<double> const &coefficients,
+      Function const &f, int n, std::vector<double> const &coefficients,
       std::vector<double> const &x, std::vector<double> const &y) {
     std::vector<double> diff(n, 0.0);
 
@@ -135,13 +597,368 @@ private:
     return diff;
   }
 
-  static double standard_deviation_calculation(std::vector<double> const &diffs,
-                                               int n) {
-    double sum = 0.0;
-    for (auto &&diff : diffs) {
-      sum += diff * diff;
+  static double standard_deviation_calculation(
+      std::vector<double> const &diffs, int n,
+      std::vector<double> const &w = {},
+      FitOptions::Precision precision = FitOptions::Precision::Double) {
+    return with_accumulator(precision, [&](auto sum) {
+      if (w.empty()) {
+        for (auto &&diff : diffs) {
+          sum.add(diff * diff);
+        }
+        return std::sqrt(sum.value() / n);
+      }
+      auto weight_sum = sum;
+      for (int i = 0; i < n; ++i) {
+        sum.add(w[i] * diffs[i] * diffs[i]);
+        weight_sum.add(w[i]);
+      }
+      return std::sqrt(sum.value() / weight_sum.value());
+    });
+  }
+
+  /**
+   * @brief Robust counterpart of standard_deviation_calculation: the scaled
+   * median absolute residual over the points with positive weight, so that
+   * outliers do not decide the model selection of a robust fit.
+   */
+  static double
+  robust_deviation_calculation(std::vector<double> const &diffs, int n,
+                               std::vector<double> const &w = {}) {
+    std::vector<double> abs_diffs;
+    abs_diffs.reserve(n);
+    for (int i = 0; i < n; ++i) {
+      if (weight_at(w, i) > 0.0) {
+        abs_diffs.push_back(std::fabs(diffs[i]));
+      }
+    }
+    if (abs_diffs.empty()) {
+      return NAN;
+    }
+    auto median = abs_diffs.begin() + abs_diffs.size() / 2;
+    std::nth_element(abs_diffs.begin(), median, abs_diffs.end());
+    return 1.4826 * *median;
+  }
+
+  static double deviation_calculation(std::vector<double> const &diffs, int n,
+                                      std::vector<double> const &w,
+                                      FitOptions const &options) {
+    if (options.robust_loss != FitOptions::RobustLoss::None) {
+      return robust_deviation_calculation(diffs, n, w);
+    }
+    return standard_deviation_calculation(diffs, n, w, options.precision);
+  }
+
+  /**
+   * @brief The least-squares problem solved by a fit, linearized at its
+   * solution.
+   *
+   * Row i has the gradient phi_i of the fitted value with respect to the
+   * coefficients, the fitted value eta_i and residual r_i in the space the
+   * fit minimizes, and the weight of the row. For polynomial and logarithmic
+   * models this space is linear in the coefficients, so the leave-one-out and
+   * k-fold formulas below are exact; exponential and power models fitted in
+   * log space predict exp(eta), and refined models use their Jacobian.
+   */
+  struct LinearizedFit {
+    int p = 0;                     /**< The number of coefficients. */
+    std::vector<double> design;    /**< Row-major n * p gradients. */
+    std::vector<double> fitted;    /**< The fitted values eta_i. */
+    std::vector<double> residuals; /**< The residuals r_i. */
+    std::vector<double> weights;   /**< The weights of the rows. */
+    bool log_space = false;        /**< Whether predictions are exp(eta). */
+  };
+
+  static LinearizedFit linearize(Function func, int n,
+                                 std::vector<double> const &x,
+                                 std::vector<double> const &y,
+                                 std::vector<double> const &w,
+                                 std::vector<double> const &coefficients,
+                                 FitOptions const &options) {
+    LinearizedFit fit;
+    fit.p = static_cast<int>(coefficients.size());
+    fit.design.resize(static_cast<std::size_t>(n) * fit.p);
+    fit.fitted.resize(n);
+    fit.residuals.resize(n);
+    fit.weights.resize(n);
+    auto const type = func.get_type();
+    auto const refined = options.nonlinear_refinement;
+    // The design columns are expressed in the normalized variable. That is
+    // an invertible change of basis, so leverages and cross-validated
+    // predictions are unchanged while the Gram matrix stays well conditioned
+    auto const basis_map = variable_map(func, n, x);
+    auto const design_basis =
+        func.in_basis(basis_map.shift, basis_map.scale);
+    for (int i = 0; i < n; ++i) {
+      if (cancelled_at(i, options)) {
+        return fit;
+      }
+      auto *phi = &fit.design[static_cast<std::size_t>(i) * fit.p];
+      auto const u = design_basis.basis_value(x[i]);
+      auto const v = func.basis_value(x[i]);
+      fit.weights[i] = weight_at(w, i);
+      switch (type) {
+      case Function::Type::Polynomial: {
+        auto power = 1.0;
+        for (int k = 0; k < fit.p; ++k) {
+          phi[k] = power;
+          power *= u;
+        }
+        break;
+      }
+      case Function::Type::Logarithmic:
+        phi[0] = 1.0;
+        phi[1] = u;
+        break;
+      case Function::Type::Exponential:
+      case Function::Type::Power: {
+        if (refined) {
+          auto g = std::exp(coefficients[1] * v);
+          phi[0] = g;
+          phi[1] = coefficients[0] * u * g;
+        } else {
+          phi[0] = 1.0;
+          phi[1] = u;
+        }
+        break;
+      }
+      }
+      if (!refined && (type == Function::Type::Exponential ||
+                       type == Function::Type::Power)) {
+        // Fitted as ln(y) = ln(a) + b * v over the positive y values
+        fit.log_space = true;
+        fit.fitted[i] = std::log(coefficients[0]) + coefficients[1] * v;
+        if (y[i] > 0.0) {
+          fit.residuals[i] = std::log(y[i]) - fit.fitted[i];
+        } else {
+          fit.residuals[i] = 0.0;
+          fit.weights[i] = 0.0;
+        }
+      } else {
+        fit.fitted[i] = get_function_value(func, coefficients, x[i]);
+        fit.residuals[i] = y[i] - fit.fitted[i];
+      }
+    }
+    return fit;
+  }
+
+  /**
+   * @brief Computes the leave-one-out prediction errors of a fit in closed
+   * form.
+   *
+   * With G = sum(w * phi * phi^T) and the leverage h_i = w_i * phi_i^T *
+   * G^-1 * phi_i, dropping row i moves its fitted value to eta_i - h_i * r_i
+   * / (1 - h_i), so a single factorization of G yields all n errors.
+   */
+  static std::vector<double>
+  leave_one_out_residuals(LinearizedFit const &fit, int n,
+                          std::vector<double> const &y,
+                          FitOptions const &options) {
+    auto p = fit.p;
+    std::vector<double> gram(p * p, 0.0);
+    std::vector<double> errors(n, NAN);
+    for (int i = 0; i < n; ++i) {
+      if (cancelled_at(i, options)) {
+        return errors;
+      }
+      auto const *phi = &fit.design[static_cast<std::size_t>(i) * p];
+      for (int r = 0; r < p; ++r) {
+        for (int c = 0; c <= r; ++c) {
+          gram[r * p + c] += fit.weights[i] * phi[r] * phi[c];
+        }
+      }
+    }
+    CholeskyDecomposition cholesky(p, gram.data());
+    if (!cholesky.is_positive_definite()) {
+      return errors;
+    }
+    std::vector<double> z(p);
+    for (int i = 0; i < n; ++i) {
+      if (cancelled_at(i, options)) {
+        return errors;
+      }
+      auto const *phi = &fit.design[static_cast<std::size_t>(i) * p];
+      std::copy(phi, phi + p, z.begin());
+      cholesky.forward_substitution(z.data());
+      auto h = 0.0;
+      for (auto &&zi : z) {
+        h += zi * zi;
+      }
+      h *= fit.weights[i];
+      if (h >= 1.0 - 1e-12) {
+        return errors;
+      }
+      auto eta = fit.fitted[i] - h * fit.residuals[i] / (1.0 - h);
+      errors[i] = y[i] - (fit.log_space ? std::exp(eta) : eta);
+    }
+    return errors;
+  }
+
+  /**
+   * @brief Computes the k-fold prediction errors of a fit.
+   *
+   * Point i belongs to fold i % k, so sorted inputs give folds that span the
+   * whole x range. The per-fold Gram matrices and gradients are accumulated
+   * in one pass; each training set is then the global sums minus its fold, so
+   * the k solves only touch p * p numbers instead of refitting the data.
+   * More folds than points are clamped to leave-one-out folds of one point.
+   */
+  static std::vector<double> k_fold_residuals(LinearizedFit const &fit, int n,
+                                              std::vector<double> const &y,
+                                              int k,
+                                              FitOptions const &options) {
+    auto p = fit.p;
+    std::vector<double> errors(n, NAN);
+    k = std::min(k, n);
+    if (k < 2) {
+      return errors;
+    }
+    std::vector<double> gram(static_cast<std::size_t>(k + 1) * p * p, 0.0);
+    std::vector<double> gradient(static_cast<std::size_t>(k) * p, 0.0);
+    auto *total = &gram[static_cast<std::size_t>(k) * p * p];
+    for (int i = 0; i < n; ++i) {
+      if (cancelled_at(i, options)) {
+        return errors;
+      }
+      auto const *phi = &fit.design[static_cast<std::size_t>(i) * p];
+      auto *fold_gram = &gram[static_cast<std::size_t>(i % k) * p * p];
+      auto *fold_gradient = &gradient[static_cast<std::size_t>(i % k) * p];
+      auto wi = fit.weights[i];
+      for (int r = 0; r < p; ++r) {
+        for (int c = 0; c <= r; ++c) {
+          fold_gram[r * p + c] += wi * phi[r] * phi[c];
+        }
+        fold_gradient[r] += wi * phi[r] * fit.residuals[i];
+      }
+    }
+    for (int f = 0; f < k; ++f) {
+      for (int e = 0; e < p * p; ++e) {
+        total[e] += gram[static_cast<std::size_t>(f) * p * p + e];
+      }
+    }
+
+    // Coefficient shift of each training set: -(G - G_f)^-1 * g_f
+    std::vector<double> shifts(static_cast<std::size_t>(k) * p);
+    std::vector<double> train(p * p);
+    for (int f = 0; f < k; ++f) {
+      for (int e = 0; e < p * p; ++e) {
+        train[e] = total[e] - gram[static_cast<std::size_t>(f) * p * p + e];
+      }
+      CholeskyDecomposition cholesky(p, train.data());
+      if (!cholesky.is_positive_definite()) {
+        return errors;
+      }
+      auto *shift = &shifts[static_cast<std::size_t>(f) * p];
+      for (int r = 0; r < p; ++r) {
+        shift[r] = -gradient[static_cast<std::size_t>(f) * p + r];
+      }
+      cholesky.solve_in_place(shift);
+    }
+
+    for (int i = 0; i < n; ++i) {
+      if (cancelled_at(i, options)) {
+        return errors;
+      }
+      auto const *phi = &fit.design[static_cast<std::size_t>(i) * p];
+      auto const *shift = &shifts[static_cast<std::size_t>(i % k) * p];
+      auto eta = fit.fitted[i];
+      for (int r = 0; r < p; ++r) {
+        eta += phi[r] * shift[r];
+      }
+      errors[i] = y[i] - (fit.log_space ? std::exp(eta) : eta);
+    }
+    return errors;
+  }
+
+  /**
+   * @brief Scores a fitted function according to options.selection.
+   */
+  static double selection_deviation(Function func, int n,
+                                    std::vector<double> const &x,
+                                    std::vector<double> const &y,
+                                    std::vector<double> const &w,
+                                    std::vector<double> const &coefficients,
+                                    FitOptions const &options) {
+    for (auto &&c : coefficients) {
+      if (!std::isfinite(c)) {
+        return NAN;
+      }
+    }
+    std::vector<double> differences;
+    switch (options.selection) {
+    case FitOptions::Selection::InSample:
+      differences = differences_calculation(func, n, coefficients, x, y);
+      break;
+    case FitOptions::Selection::LeaveOneOut:
+      differences = leave_one_out_residuals(
+          linearize(func, n, x, y, w, coefficients, options), n, y, options);
+      break;
+    case FitOptions::Selection::KFold:
+      differences = k_fold_residuals(
+          linearize(func, n, x, y, w, coefficients, options), n, y,
+          options.cv_folds, options);
+      break;
     }
-    return std::sqrt(sum / n);
+    if (options.is_cancelled()) {
+      return NAN;
+    }
+    for (auto &&d : differences) {
+      if (!std::isfinite(d)) {
+        return NAN;
+      }
+    }
+    return deviation_calculation(differences, n, w, options);
+  }
+
+  /**
+   * @brief Calculates the (weighted) Pearson correlation coefficient.
+   * @return A pair containing the correlation coefficient and an error message
+   * (if any).
+   */
+  static std::pair<double, std::string>
+  pearson_correlation(std::vector<double> const &x,
+                      std::vector<double> const &y,
+                      std::vector<double> const &w,
+                      FitOptions::Precision precision) {
+    // With weights every sum is weighted and n becomes the total weight. The
+    // sums are taken about the first point, which leaves r unchanged but
+    // keeps them from cancelling when the data lie far from the origin
+    auto const x0 = x.empty() ? 0.0 : x[0];
+    auto const y0 = y.empty() ? 0.0 : y[0];
+    std::array<double, 6> sums = with_accumulator(
+        precision, [&](auto accumulator) {
+          std::array<decltype(accumulator), 6> s;
+          for (int i = 0; i < static_cast<int>(x.size()); ++i) {
+            auto wi = weight_at(w, i);
+            auto dx = x[i] - x0;
+            auto dy = y[i] - y0;
+            s[0].add(wi);
+            s[1].add(wi * dx);
+            s[2].add(wi * dy);
+            s[3].add(wi * dx * dy);
+            s[4].add(wi * dx * dx);
+            s[5].add(wi * dy * dy);
+          }
+          std::array<double, 6> values;
+          for (std::size_t k = 0; k < s.size(); ++k) {
+            values[k] = s[k].value();
+          }
+          return values;
+        });
+    auto [n, sum_x, sum_y, sum_xy, sum_x_squared, sum_y_squared] = sums;
+
+    auto numerator = n * sum_xy - sum_x * sum_y;
+    auto denominator = std::sqrt((n * sum_x_squared - sum_x * sum_x) *
+                                 (n * sum_y_squared - sum_y * sum_y));
+    if (denominator == 0.0) {
+      return {0.0, "Division by zero"};
+    }
+    auto r = numerator / denominator;
+    if (std::fabs(r) < 0.8) {
+      return {0.0, "No strong linear dependency detected."};
+    }
+
+    return {r, ""};
   }
 
 public:
@@ -151,51 +968,89 @@ public:
    * @param func The type of function to approximate.
    * @param x The x-values of the data points.
    * @param y The y-values of the data points.
+   * @param options The options used when fitting the function.
+   */
+  ApproximationCalculator(Function func, std::vector<double> const &x,
+                          std::vector<double> const &y,
+                          FitOptions const &options = FitOptions())
+      : function(func), x(x), y(y), options(options) {}
+
+  /**
+   * @brief Constructs an ApproximationCalculator object for weighted data
+   * points.
+   * @param func The type of function to approximate.
+   * @param x The x-values of the data points.
+   * @param y The y-values of the data points.
+   * @param w The non-negative weights of the data points.
+   * @param options The options used when fitting the function.
    */
   ApproximationCalculator(Function func, std::vector<double> const &x,
-                          std::vector<double> const &y)
-      : function(func), x(x), y(y) {}
+                          std::vector<double> const &y,
+                          std::vector<double> const &w,
+                          FitOptions const &options = FitOptions())
+      : function(func), x(x), y(y), w(w), options(options) {}
+
+  /**
+   * @brief Finds the function with the lowest root-mean-square error in
+   * linear space.
+   *
+   * Models that are undefined for the data (e.g. logarithmic and power models
+   * for non-positive x) are skipped.
+   */
+  static Function find_best_function(int n, std::vector<double> const &x,
+                                     std::vector<double> const &y,
+                                     FitOptions const &options = FitOptions()) {
+    return find_best_function(n, x, y, {}, options);
+  }
 
+  /**
+   * @brief Finds the function with the lowest weighted root-mean-square error
+   * in linear space.
+   *
+   * Depending on options.selection the error is measured in-sample or by
+   * leave-one-out or k-fold cross-validation, which does not reward the
+   * higher-degree polynomials for fitting noise. Robust fits are ranked by
+   * the scaled median absolute error instead. If no function can be scored,
+   * the linear polynomial is returned; a cancelled search returns the best
+   * function scored so far.
+   * @param w The weights of the data points (empty for unit weights).
+   */
   static Function find_best_function(int n, std::vector<double> const &x,
-                                     std::vector<double> const &y) {
+                                     std::vector<double> const &y,
+                                     std::vector<double> const &w,
+                                     FitOptions const &options) {
     std::vector<std::pair<double, Function>> deviations;
 
     // Polynomial of degree 1 to 3
-    for (int i = 1; i <= 3; ++i) {
+    for (int i = 1; i <= 3 && !options.is_cancelled(); ++i) {
       auto func = Function(Function::Type::Polynomial, i);
-      auto approx = approximation_calculation(func, n, x, y);
-      auto differences = differences_calculation(func, n, approx, x, y);
-      auto deviation = standard_deviation_calculation(differences, n);
-      deviations.push_back({deviation, func});
-    }
-
-    // Exponential
-    {
-      auto func = Function(Function::Type::Exponential);
-      auto approximations = approximation_calculation(func, n, x, y);
-      auto differences = differences_calculation(func, n, approximations, x, y);
-      auto deviation = standard_deviation_calculation(differences, n);
-      deviations.push_back({deviation, func});
+      auto approx = approximation_calculation(func, n, x, y, w, options);
+      auto deviation =
+          selection_deviation(func, n, x, y, w, approx, options);
+      if (std::isfinite(deviation)) {
+        deviations.push_back({deviation, func});
+      }
     }
 
-    // Logarithmic
-    {
-      auto func = Function(Function::Type::Logarithmic);
-      auto approximations = approximation_calculation(func, n, x, y);
-      auto differences = differences_calculation(func, n, approximations, x, y);
-      auto deviation = standard_deviation_calculation(differences, n);
-      deviations.push_back({deviation, func});
+    // Exponential, logarithmic and power
+    for (auto type : {Function::Type::Exponential, Function::Type::Logarithmic,
+                      Function::Type::Power}) {
+      if (options.is_cancelled()) {
+        break;
+      }
+      auto func = Function(type);
+      auto approximations =
+          approximation_calculation(func, n, x, y, w, options);
+      auto deviation =
+          selection_deviation(func, n, x, y, w, approximations, options);
+      if (std::isfinite(deviation)) {
+        deviations.push_back({deviation, func});
+      }
     }
 
-    // Power
-    {
-      auto func = Function(Function::Type::Power);
-      auto approximations = approximation_calculation(func, n, x, y);
-      auto differences = differences_calculation(func, n, approximations, x, y);
-      auto deviation = standard_deviation_calculation(differences, n);
-      deviations.push_back({deviation, func});
+    if (deviations.empty()) {
+      return Function(Function::Type::Polynomial, 1);
     }
-
     std::sort(deviations.begin(), deviations.end(),
               [](const auto &a, const auto &b) {
                 return std::get<0>(a) < std::get<0>(b);
@@ -209,33 +1064,7 @@ public:
    * (if any).
    */
   std::pair<double, std::string> calculate_pearson_correlation() {
-    auto n = this->x.size();
-    auto sum_x = std::accumulate(x.begin(), x.end(), 0.0);
-    auto sum_y = std::accumulate(y.begin(), y.end(), 0.0);
-    auto sum_xy = 0.0;
-    for (int i = 0; i < n; ++i) {
-      sum_xy += x[i] * y[i];
-    }
-    auto sum_x_squared = 0.0;
-    auto sum_y_squared = 0.0;
-    for (int i = 0; i < n; ++i) {
-      sum_x_squared += pow(x[i], 2);
-      sum_y_squared += pow(y[i], 2);
-    }
-
-    auto numerator = static_cast<double>(n) * sum_xy - sum_x * sum_y;
-    auto denominator =
-        std::sqrt((static_cast<double>(n) * sum_x_squared - sum_x * sum_x) *
-                  (static_cast<double>(n) * sum_y_squared - sum_y * sum_y));
-    if (denominator == 0.0) {
-      return {0.0, "Division by zero"};
-    }
-    auto r = numerator / denominator;
-    if (std::fabs(r) < 0.8) {
-      return {0.0, "No strong linear dependency detected."};
-    }
-
-    return {r, ""};
+    return pearson_correlation(x, y, w, options.precision);
   }
 
   /**
@@ -259,7 +1088,7 @@ public:
   std::vector<double> get_epsilon_values() const {
     std::vector<double> epsilon_values;
     epsilon_values.reserve(x.size());
-    for (int i = 0; i < x.size(); ++i) {
+    for (int i = 0; i < static_cast<int>(x.size()); ++i) {
       epsilon_values.push_back(
           y[i] - get_function_value(function, coefficients, x[i]));
     }
@@ -269,13 +1098,86 @@ public:
 
   /**
    * @brief Calculates the coefficients of the approximated function.
+   *
+   * The coefficients are of u = (t - shift) / scale with the basis of
+   * get_function(), not of x or ln x, unless they expand to powers of t well
+   * conditioned; fits over ranges far from zero, such as x = 59..83, keep
+   * the basis. Check Function::has_basis() before reading them as
+   * coefficients of t.
    * @return The coefficients of the approximated function.
    */
   std::vector<double> calculate_coefficients() {
-    coefficients =
-        approximation_calculation(function, static_cast<int>(x.size()), x, y);
+    coefficients = approximation_calculation(
+        function, static_cast<int>(x.size()), x, y, w, options);
     return coefficients;
   }
+
+  /**
+   * @brief Retrieves the function, in the basis chosen for its coefficients
+   * by calculate_coefficients.
+   */
+  Function get_function() const { return function; }
+
+  /**
+   * @brief Computes the fitted values and residuals of a result from its
+   * function and coefficients.
+   * @param result The result whose phi_values and epsilon_values are set.
+   * @param x The x-values of the data points.
+   * @param y The y-values of the data points.
+   */
+  static void fill_residuals(FitResult &result, std::vector<double> const &x,
+                             std::vector<double> const &y) {
+    result.phi_values.resize(x.size());
+    result.epsilon_values.resize(x.size());
+    for (std::size_t i = 0; i < x.size(); ++i) {
+      result.phi_values[i] =
+          get_function_value(result.function, result.coefficients, x[i]);
+      result.epsilon_values[i] = y[i] - result.phi_values[i];
+    }
+  }
+
+  /**
+   * @brief Finds the best function for the data and computes everything
+   * reported about it.
+   * @param x The x-values of the data points.
+   * @param y The y-values of the data points.
+   * @param w The weights of the data points (empty for unit weights).
+   * @param options The options used for model selection and fitting.
+   * @return The best function with its coefficients, fitted values,
+   * residuals and statistics, or only the error "cancelled" if
+   * options.cancel was set during the fit.
+   */
+  static FitResult fit_best_function(std::vector<double> const &x,
+                                     std::vector<double> const &y,
+                                     std::vector<double> const &w,
+                                     FitOptions const &options) {
+    auto n = static_cast<int>(x.size());
+    FitResult result;
+    result.function = find_best_function(n, x, y, w, options);
+    if (options.is_cancelled()) {
+      result.error = "cancelled";
+      return result;
+    }
+    ApproximationCalculator calc(result.function, x, y, w, options);
+    result.coefficients = calc.calculate_coefficients();
+    result.function = calc.get_function();
+    if (options.is_cancelled()) {
+      result = FitResult();
+      result.error = "cancelled";
+      return result;
+    }
+    fill_residuals(result, x, y);
+    std::tie(result.pearson_correlation, result.error) =
+        calc.calculate_pearson_correlation();
+    result.deviation =
+        standard_deviation_calculation(result.epsilon_values, n, w,
+                                       options.precision);
+    for (auto const &epsilon : result.epsilon_values) {
+      result.max_abs_epsilon =
+          std::max(result.max_abs_epsilon, std::fabs(epsilon));
+    }
+    return result;
+  }
 };
 
 #endif /* B31A80AB_5724_4C6A_81ED_F301F749F738 */
@@ -0,0 +1,169 @@
+#ifndef D1270D5C_B49E_4ABE_8359_3B2A2A1A67BB
+#define D1270D5C_B49E_4ABE_8359_3B2A2A1A67BB
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief The CholeskyDecomposition class factors a small symmetric positive
+ * definite matrix as L * L^T and solves linear systems with it.
+ *
+ * The factor is stored row-major in a single contiguous buffer. Only the lower
+ * triangle of the input matrix is read.
+ */
+class CholeskyDecomposition {
+private:
+  int n;                        /**< The order of the matrix. */
+  std::vector<double> l;        /**< The lower triangular factor. */
+  bool positive_definite{true}; /**< False if the factorization broke down. */
+
+  void factorize() {
+    for (int j = 0; j < n; ++j) {
+      auto d = l[j * n + j];
+      for (int k = 0; k < j; ++k) {
+        d -= l[j * n + k] * l[j * n + k];
+      }
+      if (!(d > 0.0)) {
+        positive_definite = false;
+        return;
+      }
+      d = std::sqrt(d);
+      l[j * n + j] = d;
+      for (int i = j + 1; i < n; ++i) {
+        auto s = l[i * n + j];
+        for (int k = 0; k < j; ++k) {
+          s -= l[i * n + k] * l[j * n + k];
+        }
+        l[i * n + j] = s / d;
+      }
+      for (int k = j + 1; k < n; ++k) {
+        l[j * n + k] = 0.0;
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Factors a matrix given as a vector of rows.
+   * @param matrix The symmetric positive definite matrix.
+   */
+  explicit CholeskyDecomposition(
+      std::vector<std::vector<double>> const &matrix)
+      : n(static_cast<int>(matrix.size())), l(n * n) {
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j <= i; ++j) {
+        l[i * n + j] = matrix[i][j];
+      }
+    }
+    factorize();
+  }
+
+  /**
+   * @brief Factors a matrix stored row-major in a contiguous buffer.
+   * @param n The order of the matrix.
+   * @param matrix The n * n symmetric positive definite matrix.
+   */
+  CholeskyDecomposition(int n, double const *matrix)
+      : n(n), l(matrix, matrix + n * n) {
+    factorize();
+  }
+
+  /**
+   * @brief Retrieves the order of the factored matrix.
+   */
+  int size() const { return n; }
+
+  /**
+   * @brief Checks whether the factorization succeeded.
+   * @return False if the matrix is not (numerically) positive definite, in
+   * which case the solve methods must not be used.
+   */
+  bool is_positive_definite() const { return positive_definite; }
+
+  /**
+   * @brief Solves L * z = b in place.
+   */
+  void forward_substitution(double *b) const {
+    for (int i = 0; i < n; ++i) {
+      auto s = b[i];
+      for (int k = 0; k < i; ++k) {
+        s -= l[i * n + k] * b[k];
+      }
+      b[i] = s / l[i * n + i];
+    }
+  }
+
+  /**
+   * @brief Solves L^T * x = z in place.
+   */
+  void backward_substitution(double *z) const {
+    for (int i = n - 1; i >= 0; --i) {
+      auto s = z[i];
+      for (int k = i + 1; k < n; ++k) {
+        s -= l[k * n + i] * z[k];
+      }
+      z[i] = s / l[i * n + i];
+    }
+  }
+
+  /**
+   * @brief Solves A * x = b in place.
+   */
+  void solve_in_place(double *b) const {
+    forward_substitution(b);
+    backward_substitution(b);
+  }
+
+  /**
+   * @brief Solves A * X = B for a matrix of right-hand sides in place.
+   *
+   * B is stored row-major with one column per right-hand side, so each
+   * substitution step updates a whole contiguous row at once and the inner
+   * loops run over the columns.
+   * @param b The n * columns right-hand side matrix.
+   * @param columns The number of right-hand sides.
+   */
+  void solve_matrix_in_place(double *b, int columns) const {
+    for (int i = 0; i < n; ++i) {
+      auto *row = b + static_cast<std::size_t>(i) * columns;
+      for (int k = 0; k < i; ++k) {
+        auto const lik = l[i * n + k];
+        auto const *other = b + static_cast<std::size_t>(k) * columns;
+        for (int c = 0; c < columns; ++c) {
+          row[c] -= lik * other[c];
+        }
+      }
+      auto const inverse = 1.0 / l[i * n + i];
+      for (int c = 0; c < columns; ++c) {
+        row[c] *= inverse;
+      }
+    }
+    for (int i = n - 1; i >= 0; --i) {
+      auto *row = b + static_cast<std::size_t>(i) * columns;
+      for (int k = i + 1; k < n; ++k) {
+        auto const lki = l[k * n + i];
+        auto const *other = b + static_cast<std::size_t>(k) * columns;
+        for (int c = 0; c < columns; ++c) {
+          row[c] -= lki * other[c];
+        }
+      }
+      auto const inverse = 1.0 / l[i * n + i];
+      for (int c = 0; c < columns; ++c) {
+        row[c] *= inverse;
+      }
+    }
+  }
+
+  /**
+   * @brief Solves A * x = b.
+   * @param b The right-hand side.
+   * @return The solution x.
+   */
+  std::vector<double> solve(std::vector<double> b) const {
+    solve_in_place(b.data());
+    return b;
+  }
+};
+
+#endif /* D1270D5C_B49E_4ABE_8359_3B2A2A1A67BB */
@@ -0,0 +1,236 @@
+#ifndef C8F1D5B9_6A3E_4D72_B0C4_7E9A2F5D1B86
+#define C8F1D5B9_6A3E_4D72_B0C4_7E9A2F5D1B86
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The ColumnReader class reads x, y and weight columns from CSV, TSV
+ * or whitespace-separated text, one point per line.
+ *
+ * The layout is taken from the first line that is neither blank nor a
+ * comment: the delimiter is a tab if the line has one, else a comma, else a
+ * semicolon, else runs of whitespace. If a non-empty field of that line is
+ * not a number it is a header, and columns may be selected by name. Without
+ * a selection the columns are "x", "y" and "w" or "weight" of the header, or
+ * else the first, second and (if present) third column. Fields may be padded
+ * with spaces and enclosed in double quotes.
+ *
+ * parse() keeps the layout between calls, so a file can be fed block by
+ * block as long as every block ends at a line boundary.
+ */
+class ColumnReader {
+public:
+  /**
+   * @brief Constructs a ColumnReader object.
+   * @param selection The x, y and optional weight columns as
+   * "X,Y[,W]", each a header name or a 1-based index; empty for the
+   * defaults.
+   */
+  explicit ColumnReader(std::string const &selection = "") {
+    std::size_t begin = 0;
+    while (begin <= selection.size() && !selection.empty()) {
+      auto end = std::min(selection.find(',', begin), selection.size());
+      requested.push_back(trim(selection.substr(begin, end - begin)));
+      begin = end + 1;
+    }
+    if (requested.size() == 1 || requested.size() > 3) {
+      failure = "expected 2 or 3 columns in \"" + selection + "\"";
+    }
+  }
+
+  /**
+   * @brief Retrieves the reason the columns cannot be read, empty if none.
+   */
+  std::string const &error() const { return failure; }
+
+  /**
+   * @brief Calls visit(x, y, w) for every point of a block that ends at a
+   * line boundary.
+   *
+   * A missing or empty weight field counts as a unit weight. Blank and
+   * comment lines are skipped, as is the header.
+   * @return The number of malformed lines, including those with a negative
+   * weight.
+   */
+  template <typename Visit>
+  std::size_t parse(char const *begin, char const *end, Visit &&visit) {
+    std::size_t malformed = 0;
+    std::vector<Field> fields;
+    for (auto const *p = begin; p < end && failure.empty();) {
+      auto const *line_end = std::find(p, end, '\n');
+      auto const *next = line_end == end ? end : line_end + 1;
+      if (line_end > p && line_end[-1] == '\r') {
+        --line_end;
+      }
+      auto const *first = p;
+      while (first < line_end && (*first == ' ' || *first == '\t')) {
+        ++first;
+      }
+      p = next;
+      if (first == line_end || *first == '#') {
+        continue;
+      }
+      if (!configured) {
+        configure(first, line_end);
+        if (header || !failure.empty()) {
+          continue;
+        }
+      }
+      split(first, line_end, fields);
+      double values[3] = {0.0, 0.0, 1.0};
+      auto valid = fields.size() > std::max(x_column, y_column);
+      for (int k = 0; k < 3 && valid; ++k) {
+        auto column = k == 0 ? x_column : k == 1 ? y_column : w_column;
+        if (column == NONE || (k == 2 && (column >= fields.size() ||
+                                          fields[column].empty()))) {
+          continue;
+        }
+        valid = to_number(fields[column], values[k]);
+      }
+      if (valid && values[2] >= 0.0) {
+        visit(values[0], values[1], values[2]);
+      } else {
+        ++malformed;
+      }
+    }
+    return malformed;
+  }
+
+private:
+  /**
+   * @brief One field of a line, without padding and quotes.
+   */
+  struct Field {
+    char const *begin;
+    char const *end;
+    bool empty() const { return begin == end; }
+  };
+
+  static constexpr std::size_t NONE = static_cast<std::size_t>(-1);
+
+  std::vector<std::string> requested; /**< The selected column names. */
+  std::string failure;                /**< Why the columns cannot be read. */
+  bool configured{false};  /**< Whether the layout is known. */
+  bool header{false};      /**< Whether the first line is a header. */
+  char delimiter{' '};     /**< The field delimiter, ' ' for whitespace. */
+  std::size_t x_column{0}; /**< The index of the x column. */
+  std::size_t y_column{1}; /**< The index of the y column. */
+  std::size_t w_column{2}; /**< The index of the weight column, or NONE. */
+
+  static std::string trim(std::string const &text) {
+    auto first = text.find_first_not_of(" \t");
+    auto last = text.find_last_not_of(" \t");
+    return first == std::string::npos ? ""
+                                      : text.substr(first, last - first + 1);
+  }
+
+  static bool to_number(Field const &field, double &value) {
+    auto const *begin = field.begin;
+    if (begin < field.end && *begin == '+') {
+      ++begin;
+    }
+    auto [next, ec] = std::from_chars(begin, field.end, value);
+    return ec == std::errc() && next == field.end && begin < field.end;
+  }
+
+  /**
+   * @brief Splits a line into fields at the delimiter.
+   */
+  void split(char const *begin, char const *end,
+             std::vector<Field> &fields) const {
+    fields.clear();
+    auto const *p = begin;
+    while (true) {
+      if (delimiter == ' ') {
+        while (p < end && (*p == ' ' || *p == '\t')) {
+          ++p;
+        }
+        if (p == end) {
+          return;
+        }
+      }
+      auto const *field_end =
+          delimiter == ' '
+              ? std::find_if(p, end,
+                             [](char c) { return c == ' ' || c == '\t'; })
+              : std::find(p, end, delimiter);
+      Field field{p, field_end};
+      while (field.begin < field.end &&
+             (*field.begin == ' ' || *field.begin == '\t')) {
+        ++field.begin;
+      }
+      while (field.end > field.begin &&
+             (field.end[-1] == ' ' || field.end[-1] == '\t')) {
+        --field.end;
+      }
+      if (field.end - field.begin >= 2 && *field.begin == '"' &&
+          field.end[-1] == '"') {
+        ++field.begin;
+        --field.end;
+      }
+      fields.push_back(field);
+      if (field_end == end) {
+        return;
+      }
+      p = field_end + 1;
+    }
+  }
+
+  /**
+   * @brief Detects the delimiter and header from the first line and
+   * resolves the selected columns.
+   */
+  void configure(char const *begin, char const *end) {
+    configured = true;
+    auto has = [begin, end](char c) { return std::find(begin, end, c) != end; };
+    delimiter = has('\t') ? '\t' : has(',') ? ',' : has(';') ? ';' : ' ';
+    std::vector<Field> fields;
+    split(begin, end, fields);
+    // Empty fields, as of a trailing delimiter or a missing weight, are data
+    double value;
+    header = std::any_of(fields.begin(), fields.end(), [&value](auto &f) {
+      return !f.empty() && !to_number(f, value);
+    });
+    std::vector<std::string> names;
+    for (auto const &field : fields) {
+      names.emplace_back(field.begin, field.end);
+    }
+    auto find = [this, &names](std::string const &name) {
+      auto digit = [](unsigned char c) { return std::isdigit(c) != 0; };
+      if (!name.empty() && std::all_of(name.begin(), name.end(), digit)) {
+        auto index = std::stoul(name);
+        return index == 0 ? NONE : index - 1;
+      }
+      auto it = header ? std::find(names.begin(), names.end(), name)
+                       : names.end();
+      return it == names.end() ? NONE
+                               : static_cast<std::size_t>(it - names.begin());
+    };
+
+    if (requested.empty()) {
+      if (header) {
+        auto x = find("x");
+        auto y = find("y");
+        x_column = x == NONE ? 0 : x;
+        y_column = y == NONE ? 1 : y;
+        w_column = find("w") == NONE ? find("weight") : find("w");
+      }
+      return;
+    }
+    std::size_t *columns[3] = {&x_column, &y_column, &w_column};
+    w_column = NONE;
+    for (std::size_t k = 0; k < requested.size(); ++k) {
+      *columns[k] = find(requested[k]);
+      if (*columns[k] == NONE) {
+        failure = "unknown column \"" + requested[k] + "\"";
+      }
+    }
+  }
+};
+
+#endif /* C8F1D5B9_6A3E_4D72_B0C4_7E9A2F5D1B86 */
@@ -0,0 +1,91 @@
+#ifndef B6C51E0A_7F1D_4E55_8C3E_0E4A8D2F7B19
+#define B6C51E0A_7F1D_4E55_8C3E_0E4A8D2F7B19
+
+#include "bootstrap.hpp"
+#include "fit_options.hpp"
+#include "fit_result.hpp"
+#include "result_writer.hpp"
+#include "sampled_fit.hpp"
+#include "segmented_fit.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The CommandLine class implements the non-interactive modes of the
+ * application.
+ *
+ * When the arguments select one of these modes the application runs it
+ * without creating the GUI and exits with its status code.
+ */
+class CommandLine {
+public:
+  /**
+   * @brief Constructs a CommandLine object from the program arguments.
+   */
+  CommandLine(int argc, char *argv[]);
+
+  /**
+   * @brief Checks whether the arguments select a command-line mode.
+   */
+  bool is_requested() const;
+
+  /**
+   * @brief Checks whether --benchmark-startup asks to start the GUI, print
+   * the startup milestones once the graph has loaded and exit.
+   */
+  bool is_startup_benchmark() const { return startup_benchmark; }
+
+  /**
+   * @brief Runs the selected mode.
+   * @return The process exit status.
+   */
+  int run();
+
+private:
+  std::vector<std::string> arguments; /**< The arguments without argv[0]. */
+  std::string mode;                   /**< The selected mode, if any. */
+  bool startup_benchmark{false};      /**< Whether to time the GUI start. */
+  FitOptions options;                 /**< Options for the fitting routines. */
+  std::string input{"-"};             /**< Input file, "-" for stdin. */
+  std::size_t window{0};              /**< Window size of --rolling. */
+  bool follow{false}; /**< Keep reading a growing input file at EOF. */
+  std::string cache_dir;            /**< Fit cache directory, if any. */
+  std::string socket_path;          /**< Unix socket of --serve. */
+  unsigned workers{0};              /**< Worker threads of --serve. */
+  std::size_t batch_size{16};       /**< Requests per worker wakeup. */
+  std::size_t queue_capacity{1024}; /**< Queued requests of --serve. */
+  BootstrapAnalysis::Settings resampling; /**< --bootstrap, --jackknife. */
+  SegmentedFitter::Settings segmentation; /**< --segments. */
+  SampledFitter::Budget sampling;         /**< --approximate. */
+  bool stream_input{false}; /**< Sample a row file in one streaming pass. */
+  std::string columns; /**< Row-layout point columns, "X,Y[,W]". */
+  std::string export_path;   /**< File the fitted points are written to. */
+  std::string export_format; /**< csv, jsonl or binary; empty: by name. */
+
+  bool parse(std::string &error);
+  bool read_points(std::vector<double> &x, std::vector<double> &y,
+                   std::vector<double> &w) const;
+  std::unique_ptr<ResultWriter> open_export() const;
+  bool finish_export(ResultWriter &writer,
+                     std::chrono::steady_clock::time_point start) const;
+  bool export_points(FitResult const &result, std::vector<double> const &x,
+                     std::vector<double> const &y,
+                     std::vector<double> const &w) const;
+  int run_fit();
+  int run_resampling();
+  int run_segments();
+  int run_approximate();
+  int run_serve();
+  int run_rolling();
+  int run_multi();
+  int run_multivariate();
+
+  static void print_usage(std::ostream &os);
+};
+
+#endif /* B6C51E0A_7F1D_4E55_8C3E_0E4A8D2F7B19 */
@@ -0,0 +1,226 @@
+#ifndef B4E2A8C6_9D1F_4C35_8E7A_2F6B0D9C4A13
+#define B4E2A8C6_9D1F_4C35_8E7A_2F6B0D9C4A13
+
+#include <zlib.h>
+#ifdef LAB3_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The CompressedInput class reads a file as a byte stream and
+ * decompresses it on the fly.
+ *
+ * The format is detected from the first bytes: gzip (and zlib) streams are
+ * inflated with zlib, zstd frames with libzstd when the build found it
+ * (LAB3_HAVE_ZSTD), anything else is passed through unchanged.
+ * Concatenated gzip members and zstd frames are read as one stream, as
+ * gzip -d and zstd -d do. Only one input buffer of compressed data is held,
+ * so files of any size can be decoded without touching the disk.
+ */
+class CompressedInput {
+public:
+  /**
+   * @brief The encoding of the file.
+   */
+  enum class Format {
+    Plain, /**< Uncompressed. */
+    Gzip,  /**< gzip or zlib (deflate). */
+    Zstd   /**< Zstandard. */
+  };
+
+  /**
+   * @brief Opens a file and detects its format.
+   * @param path The path of the file.
+   * @param buffer_size The size of the compressed read buffer.
+   */
+  explicit CompressedInput(std::string const &path,
+                           std::size_t buffer_size = std::size_t{1} << 20)
+      : file(path, std::ios::binary), buffer(buffer_size) {
+    if (!file.is_open()) {
+      failure = "cannot open " + path;
+      return;
+    }
+    fill();
+    auto const *bytes = reinterpret_cast<unsigned char const *>(buffer.data());
+    if (available >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+      encoding = Format::Gzip;
+    } else if (available >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 &&
+               bytes[2] == 0x2f && bytes[3] == 0xfd) {
+      encoding = Format::Zstd;
+    }
+    if (encoding == Format::Gzip) {
+      // 15 window bits + 32: accept both gzip and zlib headers
+      if (inflateInit2(&inflater, 15 + 32) != Z_OK) {
+        failure = "cannot initialize zlib";
+      }
+      inflating = failure.empty();
+    } else if (encoding == Format::Zstd) {
+#ifdef LAB3_HAVE_ZSTD
+      decompressor = ZSTD_createDStream();
+      if (decompressor == nullptr) {
+        failure = "cannot initialize zstd";
+      }
+#else
+      failure = path + " is zstd-compressed, but zstd support was not built";
+#endif
+    }
+  }
+
+  CompressedInput(CompressedInput const &) = delete;
+  CompressedInput &operator=(CompressedInput const &) = delete;
+
+  ~CompressedInput() {
+    if (inflating) {
+      inflateEnd(&inflater);
+    }
+#ifdef LAB3_HAVE_ZSTD
+    ZSTD_freeDStream(decompressor);
+#endif
+  }
+
+  /**
+   * @brief Checks whether the file was opened and its decoder is ready.
+   */
+  bool is_open() const { return failure.empty(); }
+
+  /**
+   * @brief Retrieves the detected format.
+   */
+  Format format() const { return encoding; }
+
+  /**
+   * @brief Retrieves the reason of the last failure, empty if none.
+   */
+  std::string const &error() const { return failure; }
+
+  /**
+   * @brief Reads decoded bytes.
+   * @param out The destination.
+   * @param size The capacity of out.
+   * @return The number of bytes stored; zero at the end of the data or
+   * after an error (see error()).
+   */
+  std::size_t read(char *out, std::size_t size) {
+    if (!failure.empty() || size == 0) {
+      return 0;
+    }
+    switch (encoding) {
+    case Format::Gzip:
+      return read_gzip(out, size);
+    case Format::Zstd:
+      return read_zstd(out, size);
+    default:
+      return read_plain(out, size);
+    }
+  }
+
+private:
+  std::ifstream file;         /**< The compressed file. */
+  std::vector<char> buffer;   /**< Compressed bytes read from file. */
+  std::size_t position{0};    /**< The first unconsumed byte of buffer. */
+  std::size_t available{0};   /**< The end of the valid bytes of buffer. */
+  Format encoding{Format::Plain}; /**< The detected format. */
+  std::string failure;            /**< The reason of a failure. */
+  z_stream inflater{};            /**< The gzip decoder. */
+  bool inflating{false};          /**< Whether inflater is initialized. */
+  bool member_open{false}; /**< Whether a gzip member is being decoded. */
+#ifdef LAB3_HAVE_ZSTD
+  ZSTD_DStream *decompressor{nullptr}; /**< The zstd decoder. */
+  bool frame_open{false}; /**< Whether a zstd frame is being decoded. */
+#endif
+
+  /**
+   * @brief Refills buffer once all of it was consumed.
+   * @return False at the end of the file.
+   */
+  bool fill() {
+    if (position < available) {
+      return true;
+    }
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    position = 0;
+    available = static_cast<std::size_t>(file.gcount());
+    return available > 0;
+  }
+
+  std::size_t read_plain(char *out, std::size_t size) {
+    std::size_t stored = 0;
+    while (stored < size && fill()) {
+      auto count = std::min(size - stored, available - position);
+      std::copy_n(buffer.data() + position, count, out + stored);
+      position += count;
+      stored += count;
+    }
+    return stored;
+  }
+
+  std::size_t read_gzip(char *out, std::size_t size) {
+    auto capacity = std::min<std::size_t>(size, std::size_t{1} << 30);
+    inflater.next_out = reinterpret_cast<Bytef *>(out);
+    inflater.avail_out = static_cast<uInt>(capacity);
+    while (inflater.avail_out > 0) {
+      if (!fill()) {
+        if (member_open) {
+          failure = "truncated gzip data";
+        }
+        break;
+      }
+      inflater.next_in = reinterpret_cast<Bytef *>(buffer.data() + position);
+      inflater.avail_in = static_cast<uInt>(available - position);
+      auto status = inflate(&inflater, Z_NO_FLUSH);
+      position = available - inflater.avail_in;
+      member_open = status != Z_STREAM_END;
+      if (status == Z_STREAM_END) {
+        // Another gzip member may follow
+        inflateReset(&inflater);
+      } else if (status != Z_OK && status != Z_BUF_ERROR) {
+        failure = std::string("corrupt gzip data: ") +
+                  (inflater.msg ? inflater.msg : "inflate failed");
+        break;
+      }
+    }
+    return capacity - inflater.avail_out;
+  }
+
+  std::size_t read_zstd(char *out, std::size_t size) {
+#ifdef LAB3_HAVE_ZSTD
+    ZSTD_outBuffer output{out, size, 0};
+    while (output.pos < output.size) {
+      // At the end of the file an open frame may still flush buffered
+      // output; once it stops making progress the frame is cut short
+      auto at_end = !fill();
+      if (at_end && !frame_open) {
+        break;
+      }
+      ZSTD_inBuffer input{buffer.data(), available, position};
+      auto before = output.pos;
+      auto status = ZSTD_decompressStream(decompressor, &output, &input);
+      position = input.pos;
+      if (ZSTD_isError(status)) {
+        failure = std::string("corrupt zstd data: ") +
+                  ZSTD_getErrorName(status);
+        break;
+      }
+      // Zero once a frame is complete; another frame may follow
+      frame_open = status != 0;
+      if (at_end && output.pos == before) {
+        failure = "truncated zstd data";
+        break;
+      }
+    }
+    return output.pos;
+#else
+    static_cast<void>(out);
+    static_cast<void>(size);
+    return 0;
+#endif
+  }
+};
+
+#endif /* B4E2A8C6_9D1F_4C35_8E7A_2F6B0D9C4A13 */
@@ -0,0 +1,57 @@
+#ifndef A9C5E1B3_7D4F_4E28_9B6A_3F0D8C2E5A71
+#define A9C5E1B3_7D4F_4E28_9B6A_3F0D8C2E5A71
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief The CounterRandom class is a counter-based random generator.
+ *
+ * The i-th number of a stream is a hash of (seed, stream, i), so a stream
+ * needs no state shared with other streams, can start on any thread and can
+ * be read at any index. The hash is the SplitMix64 finalizer.
+ */
+class CounterRandom {
+private:
+  constexpr static std::uint64_t GOLDEN = 0x9E3779B97F4A7C15ULL;
+
+  std::uint64_t key;        /**< The hash of the seed and stream. */
+  std::uint64_t counter{0}; /**< The index of the next number. */
+
+  static std::uint64_t mix(std::uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+public:
+  CounterRandom(std::uint64_t seed, std::uint64_t stream)
+      : key(mix(seed + GOLDEN * mix(stream + GOLDEN))) {}
+
+  /**
+   * @brief Retrieves the number at an index of the stream.
+   */
+  std::uint64_t at(std::uint64_t index) const {
+    return mix(key + GOLDEN * (index + 1));
+  }
+
+  /**
+   * @brief Retrieves the number at an index as a double in [0, 1).
+   */
+  double unit_at(std::uint64_t index) const {
+    return static_cast<double>(at(index) >> 11) * 0x1.0p-53;
+  }
+
+  std::uint64_t next() { return at(counter++); }
+
+  /**
+   * @brief Draws an index in [0, count).
+   */
+  std::size_t below(std::size_t count) {
+    auto scaled = unit_at(counter++) * static_cast<double>(count);
+    return std::min(count - 1, static_cast<std::size_t>(scaled));
+  }
+};
+
+#endif /* A9C5E1B3_7D4F_4E28_9B6A_3F0D8C2E5A71 */
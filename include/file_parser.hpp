@@ -1,12 +1,18 @@
 #ifndef C5E01910_F282_475A_9AD3_8B901FA6E19B
 #define C5E01910_F282_475A_9AD3_8B901FA6E19B
 
+#include "column_reader.hpp"
+#include "compressed_input.hpp"
+
 #include <QDebug>
 #include <QPair>
 #include <QString>
 #include <QStringList>
 #include <algorithm>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <string>
 #include <vector>
 
 /**
@@ -15,12 +21,50 @@
  *
  * It reads two lines from the file, splits them into individual elements, and
  * pairs corresponding elements from each line into QPair objects. The file must
- * contain space-separated numeric data on each line.
+ * contain space-separated numeric data on each line. An optional third line
+ * holds the non-negative weights of the points.
+ *
+ * parse_series() reads the multi-series layout instead: one x line followed by
+ * any number of y lines sampled at the same x values.
+ *
+ * stream_rows() reads the row layout used for multivariate data, one point
+ * per line as x1 ... xk y, without holding the file in memory.
+ * read_columns() reads points in the row layout: CSV, TSV or
+ * whitespace-separated x, y and weight columns, see ColumnReader.
+ *
+ * Row-layout files may be gzip- or zstd-compressed; they are decompressed
+ * while being read (see CompressedInput). parse() reads compressed files and
+ * files named *.csv or *.tsv in the row layout.
  */
 class FileParser {
 private:
   QString filename; /**< The name of the file to parse. */
   std::vector<QPair<QString, QString>> lines; /**< Pairs of parsed data. */
+  std::vector<QString> weights; /**< Point weights (empty if not given). */
+  std::vector<double> x_values; /**< Shared x-values of parse_series(). */
+  std::vector<std::vector<double>> series; /**< y lines of parse_series(). */
+  std::string error; /**< Why read_columns() or stream_rows() failed. */
+
+  /**
+   * @brief Splits a line of whitespace-separated numbers.
+   * @return False if any element is not a number.
+   */
+  static bool split_numbers(std::string const &line,
+                            std::vector<double> &values) {
+    values.clear();
+    auto simplified = QString::fromStdString(line).simplified();
+    if (simplified.isEmpty()) {
+      return true;
+    }
+    for (auto const &str : simplified.split(' ')) {
+      bool ok;
+      values.push_back(str.toDouble(&ok));
+      if (!ok) {
+        return false;
+      }
+    }
+    return true;
+  }
 
 public:
   /**
@@ -36,16 +80,148 @@ public:
    */
   std::vector<QPair<QString, QString>> const &getLines() const { return lines; }
 
+  /**
+   * @brief Retrieves the parsed point weights.
+   * @return A constant reference to the weights, one per data pair, or an
+   * empty vector if the file has no weight line.
+   */
+  std::vector<QString> const &getWeights() const { return weights; }
+
+  /**
+   * @brief Retrieves the shared x-values read by parse_series().
+   */
+  std::vector<double> const &getX() const { return x_values; }
+
+  /**
+   * @brief Retrieves the y series read by parse_series().
+   * @return One vector per y line, each as long as getX().
+   */
+  std::vector<std::vector<double>> const &getSeries() const { return series; }
+
+  /**
+   * @brief Retrieves why the last read_columns() or stream_rows() failed.
+   */
+  std::string const &getError() const { return error; }
+
+  /**
+   * @brief Checks whether the file holds one point per line rather than the
+   * line-per-coordinate layout of parse().
+   * @return True if the file is compressed or named *.csv or *.tsv,
+   * optionally followed by .gz, .gzip or .zst.
+   */
+  bool has_row_layout() const {
+    auto name = filename.toLower();
+    for (auto const *suffix : {".gz", ".gzip", ".zst"}) {
+      if (name.endsWith(suffix)) {
+        return true;
+      }
+    }
+    if (name.endsWith(".csv") || name.endsWith(".tsv")) {
+      return true;
+    }
+    CompressedInput input(filename.toStdString(), 64);
+    return input.format() != CompressedInput::Format::Plain;
+  }
+
+  /**
+   * @brief Reads the points of a row-layout file.
+   * @param selection The columns, as accepted by ColumnReader.
+   * @param x Receives the x-values.
+   * @param y Receives the y-values.
+   * @param w Receives the weights, one per point.
+   * @param malformed Receives the number of skipped malformed lines.
+   * @return False if the file cannot be read or decoded or the columns do
+   * not exist; getError() tells why.
+   */
+  bool read_columns(std::string const &selection, std::vector<double> &x,
+                    std::vector<double> &y, std::vector<double> &w,
+                    std::size_t &malformed) {
+    ColumnReader reader(selection);
+    malformed = 0;
+    auto visit = [&x, &y, &w](double x_value, double y_value, double weight) {
+      x.push_back(x_value);
+      y.push_back(y_value);
+      w.push_back(weight);
+    };
+    auto ok = stream_rows([&](char const *begin, char const *end) {
+      malformed += reader.parse(begin, end, visit);
+    });
+    if (ok && !reader.error().empty()) {
+      error = reader.error();
+      ok = false;
+    }
+    return ok;
+  }
+
+  /**
+   * @brief Parses a file with one x line followed by several y lines.
+   * @return True if parsing is successful, false otherwise.
+   *
+   * Blank lines are skipped. Returns false if the file cannot be opened, if
+   * there is no y line, if any line contains non-numeric data or if a y line
+   * differs in length from the x line.
+   */
+  bool parse_series() {
+    std::ifstream file(filename.toStdString());
+    if (!file.is_open()) {
+      return false;
+    }
+    std::string line;
+    if (!std::getline(file, line) || !split_numbers(line, x_values) ||
+        x_values.empty()) {
+      qDebug() << "x line is missing or not numeric";
+      return false;
+    }
+    std::vector<double> values;
+    while (std::getline(file, line)) {
+      if (!split_numbers(line, values)) {
+        qDebug() << "not all elements of y line" << series.size() + 1
+                 << "are numbers";
+        return false;
+      }
+      if (values.empty()) {
+        continue;
+      }
+      if (values.size() != x_values.size()) {
+        qDebug() << "y line" << series.size() + 1
+                 << "and x have different number of elements";
+        return false;
+      }
+      series.push_back(values);
+    }
+    return !series.empty();
+  }
+
   /**
    * @brief Parses the file and populates the lines vector with paired data.
    * @return True if parsing is successful, false otherwise.
    *
    * It reads two lines from the file, splits them into individual elements, and
    * pairs corresponding elements from each line into QPair objects. The file
-   * must contain space-separated numeric data on each line. Returns false if
-   * the file cannot be opened, or if any line contains non-numeric data.
+   * must contain space-separated numeric data on each line. If a third line
+   * is present it is read as the weights of the points. Returns false if the
+   * file cannot be opened, if any line contains non-numeric data, if a weight
+   * is negative or if the lines differ in length.
    */
   bool parse() {
+    if (has_row_layout()) {
+      std::vector<double> x;
+      std::vector<double> y;
+      std::vector<double> w;
+      std::size_t malformed = 0;
+      if (!read_columns("", x, y, w, malformed) || malformed > 0 ||
+          x.empty()) {
+        qDebug() << "cannot read points:" << error.c_str() << malformed
+                 << "malformed lines";
+        return false;
+      }
+      for (std::size_t i = 0; i < x.size(); ++i) {
+        lines.push_back(QPair<QString, QString>(
+            QString::number(x[i], 'g', 17), QString::number(y[i], 'g', 17)));
+        weights.push_back(QString::number(w[i], 'g', 17));
+      }
+      return true;
+    }
     if (std::ifstream file(filename.toStdString()); file.is_open()) {
       std::string x_line;
       std::string y_line;
@@ -72,6 +248,31 @@ public:
           qDebug() << "not all elements of y are numbers";
           return false;
         }
+        if (x_list.size() != y_list.size()) {
+          qDebug() << "x and y have different number of elements";
+          return false;
+        }
+
+        // Optional line of weights
+        if (std::string w_line;
+            std::getline(file, w_line) && !QString::fromStdString(w_line)
+                                               .trimmed()
+                                               .isEmpty()) {
+          QStringList w_list = QString::fromStdString(w_line).split(' ');
+          if (!std::all_of(w_list.begin(), w_list.end(),
+                           [](QString const &str) {
+                             bool ok;
+                             return str.toDouble(&ok) >= 0.0 && ok;
+                           })) {
+            qDebug() << "not all elements of weights are non-negative numbers";
+            return false;
+          }
+          if (w_list.size() != x_list.size()) {
+            qDebug() << "weights and x have different number of elements";
+            return false;
+          }
+          weights.assign(w_list.begin(), w_list.end());
+        }
 
         // Pair elements from x_list and y_list and add to lines vector
         for (int i = 0; i < x_list.size(); i++) {
@@ -82,6 +283,102 @@ public:
     }
     return false; // Unable to open file or read lines
   }
+
+  /**
+   * @brief Counts the values on the first data line of a row-layout file.
+   * @return The number of values (k + 1 for k predictors), or zero if the
+   * file cannot be read or has no data line.
+   */
+  std::size_t count_columns() const {
+    CompressedInput input(filename.toStdString());
+    std::vector<char> chunk(std::size_t{1} << 16);
+    std::string text;
+    std::vector<double> values;
+    auto header_skipped = false;
+    for (std::size_t start = 0;;) {
+      auto newline = text.find('\n', start);
+      if (newline == std::string::npos) {
+        if (auto count = input.read(chunk.data(), chunk.size()); count > 0) {
+          text.append(chunk.data(), count);
+          continue;
+        }
+        if (start >= text.size()) {
+          return 0;
+        }
+        newline = text.size();
+      }
+      auto simplified =
+          QString::fromStdString(text.substr(start, newline - start))
+              .simplified();
+      start = newline + 1;
+      if (simplified.isEmpty() || simplified.startsWith('#')) {
+        continue;
+      }
+      simplified.replace(',', ' ').replace(';', ' ');
+      if (!split_numbers(simplified.toStdString(), values)) {
+        // A CSV header may precede the first data line
+        if (header_skipped) {
+          return 0;
+        }
+        header_skipped = true;
+        continue;
+      }
+      return values.size();
+    }
+  }
+
+  /**
+   * @brief Streams a row-layout file in line-aligned blocks.
+   *
+   * The next block is read and decompressed on a background thread while
+   * consumer processes the current one, so I/O and decompression overlap
+   * with parsing and fitting.
+   * @param consumer Called as consumer(begin, end) for every block; each block
+   * ends at a line boundary.
+   * @param block_size The approximate number of bytes per block.
+   * @return False if the file cannot be opened or decoded; getError() tells
+   * why.
+   */
+  template <typename Consumer>
+  bool stream_rows(Consumer &&consumer,
+                   std::size_t block_size = std::size_t{64} << 20) {
+    CompressedInput input(filename.toStdString());
+    if (!input.is_open()) {
+      error = input.error();
+      return false;
+    }
+    // Reads the next block after the carried-over partial line
+    auto read_block = [&input, block_size](std::vector<char> &block,
+                                           std::vector<char> &carry) {
+      block.swap(carry);
+      carry.clear();
+      auto offset = block.size();
+      block.resize(offset + block_size);
+      auto count = input.read(block.data() + offset, block_size);
+      block.resize(offset + count);
+      if (count == block_size) {
+        auto last = std::find(block.rbegin(), block.rend(), '\n');
+        auto cut = static_cast<std::size_t>(block.rend() - last);
+        carry.assign(block.begin() + cut, block.end());
+        block.resize(cut);
+      }
+      return !block.empty() || !carry.empty();
+    };
+
+    std::vector<char> current;
+    std::vector<char> next;
+    std::vector<char> carry;
+    auto more = read_block(current, carry);
+    while (more) {
+      auto reader = std::async(std::launch::async, read_block,
+                               std::ref(next), std::ref(carry));
+      consumer(current.data(), current.data() + current.size());
+      more = reader.get();
+      current.swap(next);
+    }
+    error = input.error();
+    return error.empty();
+  }
 };
 
 #endif /* C5E01910_F282_475A_9AD3_8B901FA6E19B */
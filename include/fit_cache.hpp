@@ -0,0 +1,305 @@
+#ifndef C8E1B5F7_2D4A_4A9C_B6E3_0F7D1A9C5E42
+#define C8E1B5F7_2D4A_4A9C_B6E3_0F7D1A9C5E42
+
+#include "calculator.hpp"
+#include "fit_options.hpp"
+#include "fit_result.hpp"
+#include "math_function.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The FitCache class stores fit results keyed by a hash of the input
+ * data and the fit options.
+ *
+ * Results live in a bounded in-memory LRU list. If a directory is given they
+ * are also persisted there, one file per key, so that repeated batch runs on
+ * the same data skip the fit entirely. A file holds the function, its
+ * coefficients and the statistics; the fitted values and residuals are
+ * recomputed from the data on load, so its size does not grow with the data.
+ * The key is a 64-bit hash that includes ENGINE_VERSION; the data is not
+ * stored, so distinct inputs are assumed not to collide.
+ */
+class FitCache {
+public:
+  using Key = std::uint64_t;
+
+  /**
+   * @brief The version of the fitting code, part of every key. Bump it
+   * whenever ApproximationCalculator can return a different result for the
+   * same data and options, so that persisted results of the old code are
+   * no longer found.
+   */
+  constexpr static std::uint64_t ENGINE_VERSION = 2;
+
+private:
+  constexpr static char MAGIC[8] = {'L', 'A', 'B', '3', 'F', 'I', 'T', '3'};
+
+  std::size_t capacity;  /**< The maximum number of results in memory. */
+  std::string directory; /**< The on-disk cache directory (empty if none). */
+  std::list<std::pair<Key, FitResult>> entries; /**< Most recent first. */
+  std::unordered_map<Key, std::list<std::pair<Key, FitResult>>::iterator>
+      index;                /**< Entries by key. */
+  std::size_t hits{0};      /**< The number of successful lookups. */
+  std::size_t misses{0};    /**< The number of failed lookups. */
+
+  static std::uint64_t rotate(std::uint64_t v, int r) {
+    return (v << r) | (v >> (64 - r));
+  }
+
+  static std::uint64_t mix(std::uint64_t h, std::uint64_t v) {
+    h ^= v * 0x9E3779B97F4A7C15ULL;
+    return rotate(h, 27) * 0x3C79AC492BA7B653ULL + 0x1C69B3F74AC4AE35ULL;
+  }
+
+  static std::uint64_t finalize(std::uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+  }
+
+  /**
+   * @brief Hashes the bit patterns of a vector in four independent lanes so
+   * that the multiplications of consecutive values overlap.
+   */
+  static std::uint64_t hash_values(std::vector<double> const &values,
+                                   std::uint64_t seed) {
+    std::uint64_t lanes[4] = {seed, seed + 1, seed + 2, seed + 3};
+    auto n = values.size();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      for (int lane = 0; lane < 4; ++lane) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &values[i + lane], sizeof bits);
+        lanes[lane] = mix(lanes[lane], bits);
+      }
+    }
+    for (; i < n; ++i) {
+      std::uint64_t bits;
+      std::memcpy(&bits, &values[i], sizeof bits);
+      lanes[0] = mix(lanes[0], bits);
+    }
+    auto h = mix(seed, n);
+    for (auto lane : lanes) {
+      h = mix(h, finalize(lane));
+    }
+    return h;
+  }
+
+  std::string path_of(Key key) const {
+    char name[32];
+    std::snprintf(name, sizeof name, "%016llx.fit",
+                  static_cast<unsigned long long>(key));
+    return (std::filesystem::path(directory) / name).string();
+  }
+
+  template <typename T> static void write_value(std::ostream &os, T value) {
+    os.write(reinterpret_cast<char const *>(&value), sizeof value);
+  }
+
+  template <typename T> static bool read_value(std::istream &is, T &value) {
+    return static_cast<bool>(
+        is.read(reinterpret_cast<char *>(&value), sizeof value));
+  }
+
+  static void write_vector(std::ostream &os, std::vector<double> const &v) {
+    write_value<std::uint64_t>(os, v.size());
+    os.write(reinterpret_cast<char const *>(v.data()),
+             static_cast<std::streamsize>(v.size() * sizeof(double)));
+  }
+
+  static bool read_vector(std::istream &is, std::vector<double> &v) {
+    std::uint64_t size;
+    if (!read_value(is, size) || size > (std::uint64_t{1} << 40)) {
+      return false;
+    }
+    v.resize(size);
+    return static_cast<bool>(
+        is.read(reinterpret_cast<char *>(v.data()),
+                static_cast<std::streamsize>(size * sizeof(double))));
+  }
+
+  void store_file(Key key, FitResult const &result) const {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    auto path = path_of(key);
+    auto temporary = path + ".tmp";
+    {
+      std::ofstream os(temporary, std::ios::binary);
+      if (!os) {
+        return;
+      }
+      os.write(MAGIC, sizeof MAGIC);
+      write_value(os, key);
+      write_value<std::uint8_t>(os, result.function.get_type());
+      write_value<std::int32_t>(
+          os, result.function.get_type() == Function::Type::Polynomial
+                  ? result.function.get_m()
+                  : 0);
+      write_value(os, result.function.get_shift());
+      write_value(os, result.function.get_scale());
+      write_vector(os, result.coefficients);
+      write_value(os, result.pearson_correlation);
+      write_value(os, result.deviation);
+      write_value(os, result.max_abs_epsilon);
+      write_value<std::uint64_t>(os, result.error.size());
+      os.write(result.error.data(),
+               static_cast<std::streamsize>(result.error.size()));
+      if (!os) {
+        return;
+      }
+    }
+    // Readers never see a partially written file
+    std::filesystem::rename(temporary, path, ec);
+  }
+
+  std::optional<FitResult> load_file(Key key, std::vector<double> const &x,
+                                     std::vector<double> const &y) const {
+    std::ifstream is(path_of(key), std::ios::binary);
+    char magic[sizeof MAGIC];
+    Key stored_key;
+    std::uint8_t type;
+    std::int32_t m;
+    double shift;
+    double scale;
+    if (!is || !is.read(magic, sizeof magic) ||
+        std::memcmp(magic, MAGIC, sizeof MAGIC) != 0 ||
+        !read_value(is, stored_key) || stored_key != key ||
+        !read_value(is, type) || type > Function::Type::Power ||
+        !read_value(is, m) || m < 0 || !read_value(is, shift) ||
+        !read_value(is, scale) || !(scale > 0.0)) {
+      return std::nullopt;
+    }
+    FitResult result;
+    result.function =
+        Function(static_cast<Function::Type>(type), m).in_basis(shift, scale);
+    std::uint64_t error_size;
+    std::size_t parameters =
+        type == Function::Type::Polynomial ? static_cast<std::size_t>(m) + 1
+                                           : 2;
+    if (!read_vector(is, result.coefficients) ||
+        result.coefficients.size() != parameters ||
+        !read_value(is, result.pearson_correlation) ||
+        !read_value(is, result.deviation) ||
+        !read_value(is, result.max_abs_epsilon) ||
+        !read_value(is, error_size) || error_size > 4096) {
+      return std::nullopt;
+    }
+    result.error.resize(error_size);
+    if (!is.read(result.error.data(),
+                 static_cast<std::streamsize>(error_size))) {
+      return std::nullopt;
+    }
+    ApproximationCalculator::fill_residuals(result, x, y);
+    return result;
+  }
+
+  void remember(Key key, FitResult const &result) {
+    if (auto it = index.find(key); it != index.end()) {
+      entries.erase(it->second);
+      index.erase(it);
+    }
+    entries.emplace_front(key, result);
+    index[key] = entries.begin();
+    while (entries.size() > capacity) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+  }
+
+public:
+  /**
+   * @brief Constructs a FitCache object.
+   * @param capacity The maximum number of results kept in memory.
+   * @param directory The directory results are persisted to, or an empty
+   * string to keep them in memory only.
+   */
+  explicit FitCache(std::size_t capacity = 64, std::string directory = {})
+      : capacity(capacity), directory(std::move(directory)) {}
+
+  /**
+   * @brief Computes the cache key of a data set and fit options.
+   * @param x The x-values of the data points.
+   * @param y The y-values of the data points.
+   * @param w The weights of the data points (empty for unit weights).
+   * @param options The options the data is fitted with.
+   */
+  static Key make_key(std::vector<double> const &x,
+                      std::vector<double> const &y,
+                      std::vector<double> const &w,
+                      FitOptions const &options) {
+    auto h = mix(ENGINE_VERSION, hash_values(x, 0x6A09E667F3BCC908ULL));
+    h = mix(h, hash_values(y, 0xBB67AE8584CAA73BULL));
+    h = mix(h, hash_values(w, 0x3C6EF372FE94F82BULL));
+    std::uint64_t tuning;
+    std::memcpy(&tuning, &options.robust_tuning, sizeof tuning);
+    h = mix(h, options.nonlinear_refinement);
+    h = mix(h, static_cast<std::uint64_t>(options.max_refinement_iterations));
+    h = mix(h, static_cast<std::uint64_t>(options.robust_loss));
+    h = mix(h, tuning);
+    h = mix(h, static_cast<std::uint64_t>(options.max_robust_iterations));
+    h = mix(h, static_cast<std::uint64_t>(options.selection));
+    h = mix(h, static_cast<std::uint64_t>(options.cv_folds));
+    h = mix(h, static_cast<std::uint64_t>(options.precision));
+    h = mix(h, options.normalize_data);
+    return finalize(h);
+  }
+
+  /**
+   * @brief Looks up a result, first in memory and then on disk.
+   * @param key The key made from the data and options.
+   * @param x The x-values of the data, used to recompute the fitted values
+   * of a result loaded from disk.
+   * @param y The y-values of the data, used likewise for the residuals.
+   * @return The stored result, or nothing on a miss.
+   */
+  std::optional<FitResult> find(Key key, std::vector<double> const &x,
+                                std::vector<double> const &y) {
+    if (auto it = index.find(key); it != index.end()) {
+      entries.splice(entries.begin(), entries, it->second);
+      ++hits;
+      return it->second->second;
+    }
+    if (!directory.empty()) {
+      if (auto result = load_file(key, x, y)) {
+        remember(key, *result);
+        ++hits;
+        return result;
+      }
+    }
+    ++misses;
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Stores a result in memory and, if enabled, on disk.
+   */
+  void insert(Key key, FitResult const &result) {
+    remember(key, result);
+    if (!directory.empty()) {
+      store_file(key, result);
+    }
+  }
+
+  /**
+   * @brief Retrieves the number of cache hits.
+   */
+  std::size_t hit_count() const { return hits; }
+
+  /**
+   * @brief Retrieves the number of cache misses.
+   */
+  std::size_t miss_count() const { return misses; }
+};
+
+#endif /* C8E1B5F7_2D4A_4A9C_B6E3_0F7D1A9C5E42 */
@@ -0,0 +1,247 @@
+#ifndef D2A6F4C8_7E1B_4C39_B5D0_3F8E2A9C6B17
+#define D2A6F4C8_7E1B_4C39_B5D0_3F8E2A9C6B17
+
+#include "calculator.hpp"
+#include "fit_options.hpp"
+#include "math_function.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <vector>
+
+/**
+ * @brief The FitEngine class fits data held in caller-owned arrays, reusing
+ * its working memory from call to call; it backs the C API in lab3_fit.h.
+ *
+ * The fitting routines work on std::vector, so every call copies the points
+ * into per-worker buffers that keep their capacity, and no memory is
+ * allocated for them once the buffers have grown to the largest series.
+ * Results are plain values, so callers can store them in their own arrays.
+ * An engine is not thread-safe; fit_batch() parallelizes internally.
+ */
+class FitEngine {
+public:
+  constexpr static int MAX_COEFFICIENTS = 4; /**< Of a cubic polynomial. */
+
+  /**
+   * @brief A series of points in caller-owned arrays.
+   */
+  struct Series {
+    double const *x{nullptr}; /**< The x-values. */
+    double const *y{nullptr}; /**< The y-values. */
+    double const *w{nullptr}; /**< The weights, or null for unit weights. */
+    std::size_t n{0};         /**< The number of points. */
+  };
+
+  /**
+   * @brief The fit of a series without the per-point values.
+   */
+  struct Summary {
+    /** The best function. */
+    Function function{Function::Type::Polynomial, 1};
+    /** The coefficients, in the basis of the function; unused ones are 0. */
+    std::array<double, MAX_COEFFICIENTS> coefficients{};
+    int coefficient_count{0};        /**< The coefficients used. */
+    double pearson_correlation{0.0}; /**< Zero if not strongly linear. */
+    double deviation{0.0};           /**< The (weighted) RMS error. */
+    double max_abs_epsilon{0.0};     /**< The largest absolute residual. */
+  };
+
+  /**
+   * @brief Constructs a FitEngine object.
+   * @param options The options used for model selection and fitting.
+   * @param workers The number of threads of fit_batch(), zero for all.
+   */
+  explicit FitEngine(FitOptions const &options = FitOptions(),
+                     unsigned workers = 0)
+      : options(options), workers(workers) {}
+
+  /**
+   * @brief Retrieves the options, which may be changed between calls.
+   */
+  FitOptions &get_options() { return options; }
+
+  /**
+   * @brief Sets the number of threads of fit_batch(), zero for all.
+   */
+  void set_workers(unsigned count) { workers = count; }
+
+  /**
+   * @brief Checks that a series has points and non-negative finite weights.
+   */
+  static bool is_valid(Series const &series) {
+    if (series.n == 0 || !series.x || !series.y) {
+      return false;
+    }
+    if (series.w) {
+      for (std::size_t i = 0; i < series.n; ++i) {
+        if (!(series.w[i] >= 0.0) || !std::isfinite(series.w[i])) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Finds the best function for a series, as
+   * ApproximationCalculator::find_best_function does.
+   */
+  Function find_best_function(Series const &series) {
+    auto &slot = load(0, series);
+    return ApproximationCalculator::find_best_function(
+        static_cast<int>(series.n), slot.x, slot.y, slot.w, options);
+  }
+
+  /**
+   * @brief Fits a given function to a series.
+   * @param func The function to fit; its basis is chosen by the fit.
+   * @param series The points.
+   */
+  Summary fit_function(Function func, Series const &series) {
+    return summarize(0, func, series);
+  }
+
+  /**
+   * @brief Finds the best function for a series and fits it.
+   */
+  Summary fit(Series const &series) { return fit_with(0, series); }
+
+  /**
+   * @brief Fits many series in parallel.
+   *
+   * The series are split into contiguous slices, one per worker, so
+   * batches of similar series balance best. If fitting a series throws, the
+   * first exception is rethrown once every worker has finished.
+   * @param series The series, all of which must be valid.
+   * @param count The number of series.
+   * @param summaries Receives one summary per series.
+   */
+  void fit_batch(Series const *series, std::size_t count,
+                 Summary *summaries) {
+    auto threads = workers == 0 ? worker_count() : workers;
+    if (buffers.size() < threads) {
+      buffers.resize(threads);
+    }
+    std::vector<std::exception_ptr> failures(threads);
+    parallel_for(
+        count,
+        [&](std::size_t begin, std::size_t end, unsigned worker) {
+          try {
+            for (auto i = begin; i < end; ++i) {
+              summaries[i] = fit_with(worker, series[i]);
+            }
+          } catch (...) {
+            failures[worker] = std::current_exception();
+          }
+        },
+        threads);
+    for (auto const &failure : failures) {
+      if (failure) {
+        std::rethrow_exception(failure);
+      }
+    }
+  }
+
+  /**
+   * @brief Evaluates a fit at the points of a series.
+   * @param summary The fit.
+   * @param series The points; the weights are ignored.
+   * @param phi Receives the fitted values, unless null.
+   * @param epsilon Receives the residuals y - phi, unless null.
+   */
+  static void evaluate(Summary const &summary, Series const &series,
+                       double *phi, double *epsilon) {
+    std::vector<double> coefficients(
+        summary.coefficients.begin(),
+        summary.coefficients.begin() + summary.coefficient_count);
+    for (std::size_t i = 0; i < series.n; ++i) {
+      auto value = ApproximationCalculator::get_function_value(
+          summary.function, coefficients, series.x[i]);
+      if (phi) {
+        phi[i] = value;
+      }
+      if (epsilon) {
+        epsilon[i] = series.y[i] - value;
+      }
+    }
+  }
+
+private:
+  /**
+   * @brief The working memory of one worker.
+   */
+  struct Buffers {
+    std::vector<double> x;       /**< The x-values of the series. */
+    std::vector<double> y;       /**< The y-values of the series. */
+    std::vector<double> w;       /**< The weights, empty for unit weights. */
+    std::vector<double> epsilon; /**< The residuals of the fit. */
+  };
+
+  FitOptions options;              /**< Selection and fitting options. */
+  unsigned workers;                /**< Threads of fit_batch(), or zero. */
+  std::vector<Buffers> buffers = std::vector<Buffers>(1); /**< Per worker. */
+
+  Buffers &load(unsigned worker, Series const &series) {
+    auto &slot = buffers[worker];
+    slot.x.assign(series.x, series.x + series.n);
+    slot.y.assign(series.y, series.y + series.n);
+    if (series.w) {
+      slot.w.assign(series.w, series.w + series.n);
+    } else {
+      slot.w.clear();
+    }
+    return slot;
+  }
+
+  Summary fit_with(unsigned worker, Series const &series) {
+    auto &slot = load(worker, series);
+    return summarize(worker,
+                     ApproximationCalculator::find_best_function(
+                         static_cast<int>(series.n), slot.x, slot.y, slot.w,
+                         options),
+                     series, false);
+  }
+
+  /**
+   * @brief Fits func to a series and computes its summary.
+   * @param copy Whether to copy the series into the buffers of worker first,
+   * rather than reuse the copy made for model selection.
+   */
+  Summary summarize(unsigned worker, Function func, Series const &series,
+                    bool copy = true) {
+    auto &slot = copy ? load(worker, series) : buffers[worker];
+    auto n = static_cast<int>(series.n);
+    Summary summary;
+    summary.function = func;
+    auto coefficients = ApproximationCalculator::approximation_calculation(
+        summary.function, n, slot.x, slot.y, slot.w, options);
+    summary.coefficient_count =
+        std::min<int>(static_cast<int>(coefficients.size()),
+                      MAX_COEFFICIENTS);
+    std::copy_n(coefficients.begin(), summary.coefficient_count,
+                summary.coefficients.begin());
+
+    slot.epsilon.resize(series.n);
+    for (std::size_t i = 0; i < series.n; ++i) {
+      slot.epsilon[i] =
+          slot.y[i] - ApproximationCalculator::get_function_value(
+                          summary.function, coefficients, slot.x[i]);
+      summary.max_abs_epsilon =
+          std::max(summary.max_abs_epsilon, std::fabs(slot.epsilon[i]));
+    }
+    summary.deviation = ApproximationCalculator::standard_deviation_calculation(
+        slot.epsilon, n, slot.w, options.precision);
+    summary.pearson_correlation =
+        ApproximationCalculator::pearson_correlation(slot.x, slot.y, slot.w,
+                                                     options.precision)
+            .first;
+    return summary;
+  }
+};
+
+#endif /* D2A6F4C8_7E1B_4C39_B5D0_3F8E2A9C6B17 */
@@ -0,0 +1,94 @@
+#ifndef A72F8C5A_3A43_4A0C_9CAA_9E4779CB6FAB
+#define A72F8C5A_3A43_4A0C_9CAA_9E4779CB6FAB
+
+#include <atomic>
+
+/**
+ * @brief The FitOptions struct groups the tunable parameters of the
+ * approximation routines.
+ *
+ * Default-constructed options reproduce the classic behaviour: every model is
+ * fitted by linear least squares (in log space for exponential and power
+ * models).
+ */
+struct FitOptions {
+  /**
+   * @brief Loss functions available for iteratively reweighted least squares.
+   */
+  enum class RobustLoss {
+    None,  /**< Plain (weighted) least squares. */
+    Huber, /**< Linear penalty beyond the tuning constant. */
+    Tukey, /**< Bisquare loss; gross outliers get zero weight. */
+  };
+
+  /**
+   * @brief Scores used to rank the candidate functions.
+   */
+  enum class Selection {
+    InSample,    /**< Root-mean-square error of the fit itself. */
+    LeaveOneOut, /**< Leave-one-out cross-validation error. */
+    KFold,       /**< k-fold cross-validation error. */
+  };
+
+  /**
+   * @brief Floating-point modes of the accumulations.
+   */
+  enum class Precision {
+    Double,      /**< Plain double sums. */
+    Float,       /**< Bulk data stored as float, sums kept in double. */
+    Compensated, /**< Kahan-Babuska compensated double sums. */
+    Pairwise,    /**< Pairwise (cascade) double sums. */
+  };
+
+  /**
+   * Refine exponential and power fits with Levenberg-Marquardt so that they
+   * minimize the squared error in linear space instead of log space.
+   */
+  bool nonlinear_refinement = false;
+  /**
+   * Upper bound on the number of accepted Levenberg-Marquardt steps of a
+   * single fit; the rejected trials of a step are bounded by its damping.
+   */
+  int max_refinement_iterations = 50;
+  /** The loss used to downweight outliers. */
+  RobustLoss robust_loss = RobustLoss::None;
+  /**
+   * Tuning constant of the robust loss in units of the residual scale; zero
+   * selects the usual 95% efficiency constant (1.345 for Huber, 4.685 for
+   * Tukey).
+   */
+  double robust_tuning = 0.0;
+  /** Upper bound on the number of reweighting passes of a robust fit. */
+  int max_robust_iterations = 10;
+  /** The score used by model selection. */
+  Selection selection = Selection::InSample;
+  /** The number of folds for Selection::KFold. */
+  int cv_folds = 5;
+  /**
+   * The accumulation mode. The fitting routines keep their data in double,
+   * so Float is only meaningful for the streaming multivariate regression;
+   * the command line, the service and the C interface reject it elsewhere.
+   */
+  Precision precision = Precision::Double;
+  /**
+   * Map x (and y where the model allows it) onto [-1, 1] before fitting and
+   * map the coefficients back, which keeps the normal equations well
+   * conditioned for data far from the origin such as timestamps.
+   */
+  bool normalize_data = true;
+  /**
+   * Set from another thread to abandon a fit in progress: the fitting loops
+   * poll it and fit_best_function then reports the error "cancelled". It
+   * does not change any result, so it is not part of cache keys.
+   */
+  std::atomic<bool> const *cancel = nullptr;
+
+  /**
+   * @brief Checks whether the fit was cancelled through cancel.
+   */
+  bool is_cancelled() const {
+    return cancel && cancel->load(std::memory_order_relaxed);
+  }
+};
+
+#endif /* A72F8C5A_3A43_4A0C_9CAA_9E4779CB6FAB */
@@ -0,0 +1,475 @@
+#ifndef A6D3F0B8_5C2E_4F71_9B4D_E8A1C7F3D052
+#define A6D3F0B8_5C2E_4F71_9B4D_E8A1C7F3D052
+
+#include "fit_options.hpp"
+#include "fit_result.hpp"
+#include "math_function.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief The FitRequest struct holds one decoded request of the fitting
+ * service.
+ */
+struct FitRequest {
+  std::string id_key{"id"}; /**< The name of the id member. */
+  std::string id{"null"};   /**< The raw JSON of the id, echoed back. */
+  std::vector<double> x;    /**< The x-values of the data points. */
+  std::vector<double> y;    /**< The y-values of the data points. */
+  std::vector<double> w;    /**< The weights (empty for unit weights). */
+  FitOptions options;       /**< The options of the fit. */
+  bool metrics{false};      /**< Whether the latency metrics are requested. */
+};
+
+/**
+ * @brief The FitProtocol class decodes and encodes the newline-delimited JSON
+ * messages of the fitting service.
+ *
+ * A request is one JSON object per line, for example
+ * {"id": 7, "x": [1, 2, 3], "y": [2, 4, 6], "w": [1, 1, 2],
+ *  "refine": true, "robust": "huber", "selection": "loo", "folds": 5,
+ *  "precision": "compensated"}.
+ * The precision is double, compensated or pairwise. Only "x" and "y" are
+ * required; "request_id" is accepted in place of "id"
+ * and {"metrics": true} asks for the latency metrics instead of a fit.
+ * Unknown members are ignored. "folds" must be a whole number of at least
+ * 2, and x and y must be finite and weights finite and non-negative. The
+ * decoder handles exactly this shape, so it parses number arrays straight
+ * into vectors without building a document.
+ */
+class FitProtocol {
+private:
+  struct Cursor {
+    char const *p;
+    char const *end;
+
+    void skip_space() {
+      while (p < end &&
+             (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        ++p;
+      }
+    }
+
+    bool consume(char c) {
+      skip_space();
+      if (p < end && *p == c) {
+        ++p;
+        return true;
+      }
+      return false;
+    }
+
+    bool literal(std::string_view word) {
+      skip_space();
+      if (static_cast<std::size_t>(end - p) < word.size() ||
+          std::string_view(p, word.size()) != word) {
+        return false;
+      }
+      p += word.size();
+      return true;
+    }
+
+    bool string(std::string &out) {
+      if (!consume('"')) {
+        return false;
+      }
+      out.clear();
+      while (p < end && *p != '"') {
+        if (*p != '\\') {
+          out += *p++;
+          continue;
+        }
+        if (++p == end) {
+          return false;
+        }
+        switch (*p++) {
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'u': {
+          unsigned code = 0;
+          if (end - p < 4 ||
+              std::from_chars(p, p + 4, code, 16).ptr != p + 4) {
+            return false;
+          }
+          p += 4;
+          // Code points beyond the BMP are not needed by the protocol
+          if (code < 0x80) {
+            out += static_cast<char>(code);
+          } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+          } else {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+          }
+          break;
+        }
+        default:
+          out += p[-1];
+          break;
+        }
+      }
+      if (p == end) {
+        return false;
+      }
+      ++p;
+      return true;
+    }
+
+    bool number(double &out) {
+      skip_space();
+      auto [next, ec] = std::from_chars(p, end, out);
+      if (ec != std::errc()) {
+        return false;
+      }
+      p = next;
+      return true;
+    }
+
+    bool boolean(bool &out) {
+      if (literal("true")) {
+        out = true;
+        return true;
+      }
+      if (literal("false")) {
+        out = false;
+        return true;
+      }
+      return false;
+    }
+
+    bool numbers(std::vector<double> &out) {
+      out.clear();
+      if (!consume('[')) {
+        return false;
+      }
+      if (consume(']')) {
+        return true;
+      }
+      do {
+        double value;
+        if (!number(value)) {
+          return false;
+        }
+        out.push_back(value);
+      } while (consume(','));
+      return consume(']');
+    }
+
+    bool skip_value(int depth = 0) {
+      skip_space();
+      if (p == end || depth > 64) {
+        return false;
+      }
+      if (*p == '"') {
+        std::string ignored;
+        return string(ignored);
+      }
+      if (*p == '[' || *p == '{') {
+        auto close = *p == '[' ? ']' : '}';
+        ++p;
+        if (consume(close)) {
+          return true;
+        }
+        do {
+          std::string key;
+          if (close == '}' && (!string(key) || !consume(':'))) {
+            return false;
+          }
+          if (!skip_value(depth + 1)) {
+            return false;
+          }
+        } while (consume(','));
+        return consume(close);
+      }
+      if (literal("true") || literal("false") || literal("null")) {
+        return true;
+      }
+      double ignored;
+      return number(ignored);
+    }
+  };
+
+  static void append_number(std::string &out, double value) {
+    if (!std::isfinite(value)) {
+      out += "null";
+      return;
+    }
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof buffer, value);
+    out.append(buffer, end);
+  }
+
+  static void append_string(std::string &out, std::string_view text) {
+    out += '"';
+    for (auto c : text) {
+      switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escape[8];
+          std::snprintf(escape, sizeof escape, "\\u%04x", c);
+          out += escape;
+        } else {
+          out += c;
+        }
+      }
+    }
+    out += '"';
+  }
+
+  static void append_id(std::string &out, FitRequest const &request) {
+    out += '{';
+    append_string(out, request.id_key);
+    out += ':';
+    out += request.id;
+  }
+
+public:
+  /**
+   * @brief Sets options.precision from its name: double, float, compensated
+   * or pairwise.
+   * @return Whether the name is known.
+   */
+  static bool parse_precision(std::string const &name, FitOptions &options) {
+    if (name == "double") {
+      options.precision = FitOptions::Precision::Double;
+    } else if (name == "float") {
+      options.precision = FitOptions::Precision::Float;
+    } else if (name == "compensated") {
+      options.precision = FitOptions::Precision::Compensated;
+    } else if (name == "pairwise") {
+      options.precision = FitOptions::Precision::Pairwise;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Decodes a request line.
+   * @param line The JSON object without the trailing newline.
+   * @param request The decoded request.
+   * @param error The reason the line was rejected.
+   * @return Whether the line is a valid request.
+   */
+  static bool parse(std::string_view line, FitRequest &request,
+                    std::string &error) {
+    Cursor in{line.data(), line.data() + line.size()};
+    auto has_x = false;
+    auto has_y = false;
+    std::string key;
+    std::string text;
+    if (!in.consume('{')) {
+      error = "expected a JSON object";
+      return false;
+    }
+    if (!in.consume('}')) {
+      do {
+        if (!in.string(key) || !in.consume(':')) {
+          error = "expected a member name";
+          return false;
+        }
+        auto ok = true;
+        if (key == "id" || key == "request_id") {
+          in.skip_space();
+          auto const *begin = in.p;
+          ok = in.skip_value();
+          request.id_key = key;
+          request.id.assign(begin, in.p);
+        } else if (key == "x") {
+          ok = has_x = in.numbers(request.x);
+        } else if (key == "y") {
+          ok = has_y = in.numbers(request.y);
+        } else if (key == "w") {
+          ok = in.numbers(request.w);
+        } else if (key == "metrics") {
+          ok = in.boolean(request.metrics);
+        } else if (key == "refine") {
+          ok = in.boolean(request.options.nonlinear_refinement);
+        } else if (key == "robust") {
+          ok = in.string(text);
+          if (text == "none") {
+            request.options.robust_loss = FitOptions::RobustLoss::None;
+          } else if (text == "huber") {
+            request.options.robust_loss = FitOptions::RobustLoss::Huber;
+          } else if (text == "tukey") {
+            request.options.robust_loss = FitOptions::RobustLoss::Tukey;
+          } else {
+            ok = false;
+          }
+        } else if (key == "selection") {
+          ok = in.string(text);
+          if (text == "insample") {
+            request.options.selection = FitOptions::Selection::InSample;
+          } else if (text == "loo") {
+            request.options.selection = FitOptions::Selection::LeaveOneOut;
+          } else if (text == "kfold") {
+            request.options.selection = FitOptions::Selection::KFold;
+          } else {
+            ok = false;
+          }
+        } else if (key == "precision") {
+          // The service fits single series, which have no float mode
+          ok = in.string(text) && parse_precision(text, request.options) &&
+               request.options.precision != FitOptions::Precision::Float;
+        } else if (key == "folds") {
+          double folds;
+          ok = in.number(folds) && folds >= 2 && folds <= INT_MAX &&
+               folds == std::floor(folds);
+          if (ok) {
+            request.options.cv_folds = static_cast<int>(folds);
+          }
+        } else {
+          ok = in.skip_value();
+        }
+        if (!ok) {
+          error = "invalid value of \"" + key + "\"";
+          return false;
+        }
+      } while (in.consume(','));
+      if (!in.consume('}')) {
+        error = "expected '}'";
+        return false;
+      }
+    }
+    if (request.metrics) {
+      return true;
+    }
+    if (!has_x || !has_y || request.x.size() != request.y.size()) {
+      error = "\"x\" and \"y\" must be arrays of the same length";
+      return false;
+    }
+    if (request.x.empty()) {
+      error = "no data points";
+      return false;
+    }
+    if (!request.w.empty() && request.w.size() != request.x.size()) {
+      error = "\"w\" must have one weight per point";
+      return false;
+    }
+    auto finite = [](double value) { return std::isfinite(value); };
+    if (!std::all_of(request.x.begin(), request.x.end(), finite) ||
+        !std::all_of(request.y.begin(), request.y.end(), finite)) {
+      error = "\"x\" and \"y\" must be finite";
+      return false;
+    }
+    if (!std::all_of(request.w.begin(), request.w.end(), [](double value) {
+          return value >= 0.0 && std::isfinite(value);
+        })) {
+      error = "weights must be finite and non-negative";
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Encodes the result of a fit as one response line. The
+   * coefficients are of u = (t - shift) / scale with "basis" [shift, scale];
+   * see Function::in_basis.
+   * @param request The request that was answered.
+   * @param result The fit result.
+   * @param cached Whether the result came from the cache.
+   */
+  static std::string format(FitRequest const &request,
+                            FitResult const &result, bool cached) {
+    if (!result.error.empty()) {
+      return format_error(request, result.error);
+    }
+    std::string out;
+    out.reserve(128 + 24 * result.coefficients.size());
+    append_id(out, request);
+    out += ",\"function\":";
+    append_string(out, result.function.to_string());
+    out += ",\"expression\":";
+    append_string(out,
+                  result.function.get_string_function(result.coefficients));
+    out += ",\"coefficients\":[";
+    for (std::size_t i = 0; i < result.coefficients.size(); ++i) {
+      if (i > 0) {
+        out += ',';
+      }
+      append_number(out, result.coefficients[i]);
+    }
+    out += "],\"basis\":[";
+    append_number(out, result.function.get_shift());
+    out += ',';
+    append_number(out, result.function.get_scale());
+    out += "],\"pearson\":";
+    append_number(out, result.pearson_correlation);
+    out += ",\"rms\":";
+    append_number(out, result.deviation);
+    out += ",\"max_abs_epsilon\":";
+    append_number(out, result.max_abs_epsilon);
+    out += cached ? ",\"cached\":true}\n" : ",\"cached\":false}\n";
+    return out;
+  }
+
+  /**
+   * @brief Encodes an error as one response line.
+   */
+  static std::string format_error(FitRequest const &request,
+                                  std::string const &message) {
+    std::string out;
+    append_id(out, request);
+    out += ",\"error\":";
+    append_string(out, message);
+    out += "}\n";
+    return out;
+  }
+
+  /**
+   * @brief Encodes latency metrics as one response line.
+   * @param request The metrics request.
+   * @param requests The number of requests answered so far.
+   * @param p50 The median latency in microseconds.
+   * @param p99 The 99th percentile latency in microseconds.
+   * @param queued The number of requests waiting for a worker.
+   */
+  static std::string format_metrics(FitRequest const &request,
+                                    std::size_t requests, double p50,
+                                    double p99, std::size_t queued) {
+    std::string out;
+    append_id(out, request);
+    out += ",\"requests\":" + std::to_string(requests) + ",\"p50_us\":";
+    append_number(out, p50);
+    out += ",\"p99_us\":";
+    append_number(out, p99);
+    out += ",\"queued\":" + std::to_string(queued) + "}\n";
+    return out;
+  }
+};
+
+#endif /* A6D3F0B8_5C2E_4F71_9B4D_E8A1C7F3D052 */
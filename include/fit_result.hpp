@@ -0,0 +1,28 @@
+#ifndef B2D6F8A4_9C1E_4B3F_8E7A_1D5C9F0B2A66
+#define B2D6F8A4_9C1E_4B3F_8E7A_1D5C9F0B2A66
+
+#include "math_function.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief The FitResult struct holds everything reported about the best fit
+ * of a data set.
+ */
+struct FitResult {
+  Function function{Function::Type::Polynomial, 1}; /**< The best function. */
+  /**
+   * The coefficients of the function, of u = (t - shift) / scale in its
+   * basis when function.has_basis(), otherwise of x or ln x.
+   */
+  std::vector<double> coefficients;
+  std::vector<double> phi_values;   /**< The fitted values at each x. */
+  std::vector<double> epsilon_values; /**< The residuals y - phi. */
+  double pearson_correlation{0.0};    /**< The Pearson correlation. */
+  std::string error; /**< The Pearson correlation error message, if any. */
+  double deviation{0.0};       /**< The (weighted) root-mean-square error. */
+  double max_abs_epsilon{0.0}; /**< The largest absolute residual. */
+};
+
+#endif /* B2D6F8A4_9C1E_4B3F_8E7A_1D5C9F0B2A66 */
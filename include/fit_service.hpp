@@ -0,0 +1,134 @@
+#ifndef E2B9D4A7_6F3C_4D18_A5E0_7C1B3F9D8E64
+#define E2B9D4A7_6F3C_4D18_A5E0_7C1B3F9D8E64
+
+#include "fit_cache.hpp"
+#include "fit_options.hpp"
+#include "latency_recorder.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The FitService class answers fit requests from other processes over
+ * a Unix domain socket.
+ *
+ * Clients send newline-delimited JSON requests (see FitProtocol) and receive
+ * one response line per request, tagged with the request id and in
+ * completion order. A single thread runs a poll() event loop that accepts
+ * connections, splits input into lines and writes responses. Lines are
+ * queued for a pool of workers that take them in batches, fit them and hand
+ * the responses back through a self-pipe that wakes the event loop.
+ *
+ * The queue is bounded: once it is full, and for connections that already
+ * have too many requests in flight, the event loop stops reading, so clients
+ * are slowed down by the socket buffers instead of growing server memory.
+ */
+class FitService {
+public:
+  /**
+   * @brief The Settings struct configures the service.
+   */
+  struct Settings {
+    std::string socket_path;          /**< The Unix socket to listen on. */
+    unsigned workers{0};              /**< Fitting threads, zero for all. */
+    std::size_t batch_size{16};       /**< Requests taken per worker wakeup. */
+    std::size_t queue_capacity{1024}; /**< Queued requests before throttling. */
+    std::size_t max_in_flight{256};   /**< Requests in flight per connection. */
+    std::size_t max_line{64 << 20};   /**< Longest accepted request line. */
+    std::string cache_dir;            /**< Persistent fit cache, if any. */
+  };
+
+  /**
+   * @brief Constructs a FitService object.
+   * @param settings The service settings.
+   * @param options The default fit options of requests.
+   */
+  FitService(Settings settings, FitOptions const &options);
+  ~FitService();
+
+  FitService(FitService const &) = delete;
+  FitService &operator=(FitService const &) = delete;
+
+  /**
+   * @brief Listens on the socket and serves requests until stop is set.
+   * @param stop The flag that ends the service, e.g. set by a signal.
+   * @return The process exit status.
+   */
+  int run(volatile std::sig_atomic_t const &stop);
+
+  /**
+   * @brief Formats the request count and latency distribution on one line.
+   */
+  std::string summary();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /** One request line waiting for a worker. */
+  struct Job {
+    std::uint64_t connection;
+    std::string line;
+    Clock::time_point received;
+  };
+
+  /** One response waiting for the event loop. */
+  struct Completion {
+    std::uint64_t connection;
+    std::string response;
+  };
+
+  /** The state of one client connection, owned by the event loop. */
+  struct Connection {
+    int fd{-1};               /**< The socket of the connection. */
+    std::string input;        /**< Received bytes not yet split into lines. */
+    std::string output;       /**< Responses not yet written. */
+    std::size_t in_flight{0}; /**< Requests queued or being fitted. */
+    bool closed{false};       /**< The client has shut down its side. */
+  };
+
+  Settings settings;
+  FitOptions options;
+  int listener{-1};
+  int wake_pipe[2]{-1, -1};
+  std::uint64_t next_connection{0};
+  std::unordered_map<std::uint64_t, Connection> connections;
+
+  std::mutex queue_mutex;
+  std::condition_variable queue_ready;
+  std::deque<Job> queue;
+  bool stopping{false};
+
+  std::mutex completion_mutex;
+  std::vector<Completion> completions;
+
+  std::mutex cache_mutex;
+  FitCache cache;
+
+  std::mutex metrics_mutex;
+  LatencyRecorder latencies{1 << 16};
+  std::size_t answered{0};
+
+  std::vector<std::thread> workers;
+
+  bool listen(std::string &error);
+  void accept_connections();
+  bool read_connection(Connection &connection);
+  bool write_connection(Connection &connection);
+  void dispatch_lines(std::uint64_t id, Connection &connection);
+  void collect_completions();
+  std::size_t queued();
+
+  void work();
+  std::string answer(Job const &job);
+};
+
+#endif /* E2B9D4A7_6F3C_4D18_A5E0_7C1B3F9D8E64 */
@@ -0,0 +1,178 @@
+#ifndef F3B8D1E6_4A2C_4E97_8C5B_1D7A9E3F6C20
+#define F3B8D1E6_4A2C_4E97_8C5B_1D7A9E3F6C20
+
+/**
+ * @file lab3_fit.h
+ * @brief The C interface of the approximation engine (liblab3_fit).
+ *
+ * A fit handle keeps the options and the working memory of the engine, so
+ * services create one per thread and reuse it for every call. The points are
+ * read from caller-owned arrays and the results are written to
+ * caller-provided structures and buffers; the library keeps no pointer to
+ * either after a call returns. Every function returns a lab3_status, and the
+ * message of the last failure is kept in the handle.
+ *
+ * The ABI is stable within LAB3_FIT_ABI_VERSION: new functions and options
+ * may be added, but existing structures and enumerators are not changed.
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(LAB3_FIT_BUILDING)
+#define LAB3_FIT_API __declspec(dllexport)
+#else
+#define LAB3_FIT_API __declspec(dllimport)
+#endif
+#else
+#define LAB3_FIT_API __attribute__((visibility("default")))
+#endif
+
+#define LAB3_FIT_ABI_VERSION 2
+#define LAB3_FIT_MAX_COEFFICIENTS 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief A fit handle; not thread-safe, use one per thread. */
+typedef struct lab3_fit lab3_fit;
+
+/** @brief The results of the functions. */
+typedef enum lab3_status {
+  LAB3_OK = 0,               /**< Success. */
+  LAB3_INVALID_ARGUMENT = 1, /**< A null pointer, no points or bad value. */
+  LAB3_OUT_OF_MEMORY = 2,    /**< The working memory could not grow. */
+  LAB3_INTERNAL_ERROR = 3    /**< The engine failed; see lab3_fit_error. */
+} lab3_status;
+
+/**
+ * @brief The function types, as in Function::Type, of u = (t - shift) /
+ * scale where t is ln x for logarithmic and power functions and x
+ * otherwise; see lab3_fit_result.
+ */
+typedef enum lab3_function_type {
+  LAB3_POLYNOMIAL = 0,  /**< c0 + c1 u + ... + cm u^m. */
+  LAB3_EXPONENTIAL = 1, /**< c0 exp(c1 u). */
+  LAB3_LOGARITHMIC = 2, /**< c0 + c1 u. */
+  LAB3_POWER = 3        /**< c0 exp(c1 u), which is c0 x^c1 for u = ln x. */
+} lab3_function_type;
+
+/**
+ * @brief The options of a handle, as in FitOptions; enumerated values use
+ * the order of the FitOptions enumerations. All but the 0-or-1 options and
+ * LAB3_OPTION_ROBUST_TUNING take whole numbers up to INT_MAX.
+ */
+typedef enum lab3_option {
+  LAB3_OPTION_NONLINEAR_REFINEMENT = 0,      /**< 0 or 1, default 0. */
+  LAB3_OPTION_MAX_REFINEMENT_ITERATIONS = 1, /**< Accepted steps, default 50. */
+  LAB3_OPTION_ROBUST_LOSS = 2,         /**< None, Huber, Tukey; default 0. */
+  LAB3_OPTION_ROBUST_TUNING = 3,       /**< 0 for the usual constant. */
+  LAB3_OPTION_MAX_ROBUST_ITERATIONS = 4, /**< Default 10. */
+  LAB3_OPTION_SELECTION = 5, /**< InSample, LeaveOneOut, KFold; default 0. */
+  LAB3_OPTION_CV_FOLDS = 6,  /**< Default 5. */
+  LAB3_OPTION_PRECISION = 7, /**< Double, Compensated, Pairwise; not Float. */
+  LAB3_OPTION_NORMALIZE_DATA = 8, /**< 0 or 1, default 1. */
+  LAB3_OPTION_WORKERS = 9 /**< Threads of lab3_fit_batch, 0 for all. */
+} lab3_option;
+
+/** @brief A series of points in caller-owned arrays. */
+typedef struct lab3_series {
+  const double *x; /**< The x-values. */
+  const double *y; /**< The y-values. */
+  const double *w; /**< Non-negative weights, or NULL for unit weights. */
+  size_t n;        /**< The number of points. */
+} lab3_series;
+
+/**
+ * @brief The fit of a series.
+ *
+ * The coefficients are of u = (t - shift) / scale. Fits whose coefficients
+ * of t itself are well conditioned have shift 0 and scale 1; data far from
+ * the origin, such as timestamps, keep the basis, since their coefficients
+ * of t would cancel catastrophically. lab3_fit_evaluate applies it.
+ */
+typedef struct lab3_fit_result {
+  int type;              /**< A lab3_function_type. */
+  int degree;            /**< The degree of a polynomial, else 0. */
+  int coefficient_count; /**< The coefficients used. */
+  double coefficients[LAB3_FIT_MAX_COEFFICIENTS]; /**< Unused ones are 0. */
+  double shift;               /**< The value of t mapped to u = 0. */
+  double scale;               /**< The positive width of t mapped to 1. */
+  double pearson_correlation; /**< 0 if not strongly linear. */
+  double deviation;           /**< The (weighted) RMS error. */
+  double max_abs_epsilon;     /**< The largest absolute residual. */
+} lab3_fit_result;
+
+/** @brief Retrieves the version of the library, e.g. "0.1". */
+LAB3_FIT_API const char *lab3_fit_version(void);
+
+/** @brief Retrieves a description of a status. */
+LAB3_FIT_API const char *lab3_status_string(lab3_status status);
+
+/**
+ * @brief Creates a handle with the default options.
+ * @return The handle, or NULL if out of memory.
+ */
+LAB3_FIT_API lab3_fit *lab3_fit_create(void);
+
+/** @brief Destroys a handle; NULL is ignored. */
+LAB3_FIT_API void lab3_fit_destroy(lab3_fit *fit);
+
+/** @brief Sets an option for the following calls. */
+LAB3_FIT_API lab3_status lab3_fit_set_option(lab3_fit *fit,
+                                             lab3_option option, double value);
+
+/**
+ * @brief Retrieves the message of the last failure of a handle, or "".
+ */
+LAB3_FIT_API const char *lab3_fit_error(const lab3_fit *fit);
+
+/**
+ * @brief Finds the function with the lowest selection error.
+ * @param type Receives a lab3_function_type.
+ * @param degree Receives the degree of a polynomial, else 0.
+ */
+LAB3_FIT_API lab3_status lab3_find_best_function(lab3_fit *fit,
+                                                 const lab3_series *series,
+                                                 int *type, int *degree);
+
+/**
+ * @brief Fits a given function.
+ * @param result Receives the fit with its basis and statistics.
+ */
+LAB3_FIT_API lab3_status lab3_calculate_coefficients(
+    lab3_fit *fit, const lab3_series *series, int type, int degree,
+    lab3_fit_result *result);
+
+/** @brief Finds the best function for a series and fits it. */
+LAB3_FIT_API lab3_status lab3_fit_best(lab3_fit *fit,
+                                       const lab3_series *series,
+                                       lab3_fit_result *result);
+
+/**
+ * @brief Fits many series on the worker threads of the handle.
+ *
+ * Every series is validated first; if one is invalid, nothing is fitted and
+ * its index is reported in the error message.
+ * @param results Receives one result per series.
+ */
+LAB3_FIT_API lab3_status lab3_fit_batch(lab3_fit *fit,
+                                        const lab3_series *series,
+                                        size_t count,
+                                        lab3_fit_result *results);
+
+/**
+ * @brief Evaluates a fit at the points of a series.
+ * @param phi Receives series->n fitted values, unless NULL.
+ * @param epsilon Receives series->n residuals y - phi, unless NULL.
+ */
+LAB3_FIT_API lab3_status lab3_fit_evaluate(const lab3_fit_result *result,
+                                           const lab3_series *series,
+                                           double *phi, double *epsilon);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* F3B8D1E6_4A2C_4E97_8C5B_1D7A9E3F6C20 */
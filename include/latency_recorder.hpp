@@ -0,0 +1,112 @@
+#ifndef F0B7C1F5_2E36_4E0B_A1D4_6C0A5C93F1D2
+#define F0B7C1F5_2E36_4E0B_A1D4_6C0A5C93F1D2
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The LatencyRecorder class collects latency samples and reports their
+ * distribution.
+ *
+ * Samples are stored in microseconds. With a capacity only the most recent
+ * samples are kept, so long-running processes use bounded memory. The class
+ * is not thread-safe; callers that record from several threads must
+ * serialize access.
+ */
+class LatencyRecorder {
+private:
+  std::vector<double> samples; /**< The recorded latencies in microseconds. */
+  std::size_t capacity;        /**< The sample limit, zero for unbounded. */
+  std::size_t next{0};         /**< The slot overwritten when full. */
+
+public:
+  /**
+   * @brief Constructs a LatencyRecorder object.
+   * @param capacity The number of most recent samples to keep, zero to keep
+   * all of them.
+   */
+  explicit LatencyRecorder(std::size_t capacity = 0) : capacity(capacity) {}
+
+  /**
+   * @brief Records a latency sample.
+   * @param microseconds The latency in microseconds.
+   */
+  void record(double microseconds) {
+    if (capacity == 0 || samples.size() < capacity) {
+      samples.push_back(microseconds);
+      return;
+    }
+    samples[next] = microseconds;
+    next = (next + 1) % capacity;
+  }
+
+  /**
+   * @brief Removes all samples.
+   */
+  void clear() {
+    samples.clear();
+    next = 0;
+  }
+
+  /**
+   * @brief Retrieves the number of samples.
+   */
+  std::size_t count() const { return samples.size(); }
+
+  /**
+   * @brief Calculates the mean latency.
+   * @return The mean in microseconds, or zero without samples.
+   */
+  double mean() const {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    return std::accumulate(samples.begin(), samples.end(), 0.0) /
+           static_cast<double>(samples.size());
+  }
+
+  /**
+   * @brief Calculates a latency percentile (nearest rank).
+   * @param q The quantile in [0, 1], e.g. 0.99 for p99.
+   * @return The percentile in microseconds, or zero without samples.
+   */
+  double percentile(double q) const {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    auto sorted = samples;
+    auto rank = static_cast<std::size_t>(
+        q * static_cast<double>(sorted.size() - 1) + 0.5);
+    rank = std::min(rank, sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+  }
+
+  /**
+   * @brief Retrieves the largest latency.
+   * @return The maximum in microseconds, or zero without samples.
+   */
+  double max() const {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    return *std::max_element(samples.begin(), samples.end());
+  }
+
+  /**
+   * @brief Formats the count, mean, p50, p99 and maximum on one line.
+   */
+  std::string summary() const {
+    std::stringstream ss;
+    ss << "samples=" << count() << " mean=" << mean()
+       << "us p50=" << percentile(0.5) << "us p99=" << percentile(0.99)
+       << "us max=" << max() << "us";
+    return ss.str();
+  }
+};
+
+#endif /* F0B7C1F5_2E36_4E0B_A1D4_6C0A5C93F1D2 */
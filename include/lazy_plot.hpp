@@ -0,0 +1,110 @@
+#ifndef A3F7B1D9_8C2E_4A56_9D0B_6E4C2A8F1D75
+#define A3F7B1D9_8C2E_4A56_9D0B_6E4C2A8F1D75
+
+#include <QLayout>
+#include <QString>
+#include <QStringList>
+#include <QWidget>
+#include <QtWebEngineWidgets/QWebEngineView>
+#include <functional>
+#include <utility>
+
+/**
+ * @brief The LazyPlot class creates the web view of the graph on first use.
+ *
+ * Starting QtWebEngine and loading the graphing page dominates the startup
+ * time of the window, so the view is only created by preload(), which the
+ * window schedules once it is interactive, or by the first run(). Scripts
+ * run before the page has loaded are queued and run in order once it has.
+ */
+class LazyPlot {
+public:
+  /**
+   * @brief Constructs a LazyPlot object without creating the view.
+   * @param host The widget the view is added to; it needs a layout.
+   * @param placeholder The widget shown until the view exists.
+   * @param html The page loaded into the view.
+   */
+  LazyPlot(QWidget *host, QWidget *placeholder, QString html)
+      : host(host), placeholder(placeholder), html(std::move(html)) {}
+
+  LazyPlot(LazyPlot const &) = delete;
+  LazyPlot &operator=(LazyPlot const &) = delete;
+
+  ~LazyPlot() {
+    if (view) {
+      view->disconnect();
+    }
+  }
+
+  /**
+   * @brief Sets a callable invoked after the view is created.
+   */
+  void on_created(std::function<void()> callback) {
+    created_callback = std::move(callback);
+  }
+
+  /**
+   * @brief Sets a callable invoked once the page has loaded.
+   */
+  void on_ready(std::function<void()> callback) {
+    ready_callback = std::move(callback);
+  }
+
+  /**
+   * @brief Checks whether the page has loaded.
+   */
+  bool is_ready() const { return ready; }
+
+  /**
+   * @brief Creates the view and starts loading the page, unless done.
+   */
+  void preload() {
+    if (view) {
+      return;
+    }
+    view = new QWebEngineView(host);
+    view->setMinimumSize(host->minimumSize());
+    QObject::connect(view, &QWebEngineView::loadFinished, view, [this](bool) {
+      ready = true;
+      for (auto const &script : pending) {
+        view->page()->runJavaScript(script);
+      }
+      pending.clear();
+      if (ready_callback) {
+        ready_callback();
+      }
+    });
+    view->setHtml(html);
+    placeholder->hide();
+    host->layout()->addWidget(view);
+    if (created_callback) {
+      created_callback();
+    }
+  }
+
+  /**
+   * @brief Runs a script in the page, creating the view if needed.
+   * @param script The JavaScript code.
+   */
+  void run(QString const &script) {
+    preload();
+    if (ready) {
+      view->page()->runJavaScript(script);
+    } else {
+      pending.append(script);
+    }
+  }
+
+private:
+  QWidget *host;                        /**< The parent of the view. */
+  QWidget *placeholder;                 /**< Shown until the view exists. */
+  QString html;                         /**< The page of the view. */
+  QWebEngineView *view{nullptr};        /**< The view, once created. */
+  bool ready{false};                    /**< Whether the page has loaded. */
+  QStringList pending;                  /**< Scripts waiting for the page. */
+  std::function<void()> created_callback; /**< Called after creation. */
+  std::function<void()> ready_callback;   /**< Called after loading. */
+};
+
+#endif /* A3F7B1D9_8C2E_4A56_9D0B_6E4C2A8F1D75 */
@@ -0,0 +1,140 @@
+#ifndef B7E3F9A5_2D6C_4B81_8F0E_5A1C7D3B9E42
+#define B7E3F9A5_2D6C_4B81_8F0E_5A1C7D3B9E42
+
+#include "calculator.hpp"
+#include "fit_options.hpp"
+#include "fit_result.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The LiveFitWorker class fits the latest snapshot of the points on
+ * a background thread.
+ *
+ * Only the newest request matters: a request submitted while another one
+ * is waiting replaces it, and a request submitted while a fit runs cancels
+ * that fit through FitOptions::cancel, so an out-of-date fit only delays
+ * the newest one until the fitting loops next poll the flag. Fits that end
+ * after a newer request arrived are discarded instead of delivered.
+ */
+class LiveFitWorker {
+public:
+  /**
+   * The latency from a snapshot to its refreshed graph that live editing
+   * aims for; tools/live_fit_benchmark checks the fitting part of it.
+   */
+  constexpr static double BUDGET_MS = 16.0;
+
+  /**
+   * @brief A snapshot of the points to fit.
+   */
+  struct Request {
+    std::uint64_t generation{0}; /**< Increases with every snapshot. */
+    std::vector<double> x;       /**< The x-values of the points. */
+    std::vector<double> y;       /**< The y-values of the points. */
+    std::vector<double> w;       /**< The weights of the points. */
+  };
+
+  /**
+   * @brief Called on the worker thread with a request, its fit and the
+   * fitting time in milliseconds.
+   */
+  using Callback = std::function<void(Request &&, FitResult &&, double)>;
+
+  /**
+   * @brief Starts the worker thread.
+   * @param options The options used for model selection and fitting.
+   * @param done Receives every fit that is still current.
+   */
+  LiveFitWorker(FitOptions const &options, Callback done)
+      : options(options), done(std::move(done)) {
+    this->options.cancel = &cancelled;
+    thread = std::thread([this] { loop(); });
+  }
+
+  LiveFitWorker(LiveFitWorker const &) = delete;
+  LiveFitWorker &operator=(LiveFitWorker const &) = delete;
+
+  ~LiveFitWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      cancelled = true;
+    }
+    wake.notify_one();
+    thread.join();
+  }
+
+  /**
+   * @brief Queues a snapshot, replacing any snapshot still waiting and
+   * cancelling the running fit.
+   */
+  void submit(Request request) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (pending) {
+        ++discarded;
+      }
+      pending = std::move(request);
+      cancelled = true;
+    }
+    wake.notify_one();
+  }
+
+  /**
+   * @brief Retrieves the number of snapshots replaced or fitted in vain.
+   */
+  std::uint64_t discarded_requests() const { return discarded; }
+
+private:
+  FitOptions options;                      /**< Fitting options. */
+  Callback done;                           /**< Receives current fits. */
+  std::mutex mutex;                        /**< Guards pending and stopping. */
+  std::condition_variable wake;            /**< Signals a change of either. */
+  std::optional<Request> pending;          /**< The newest snapshot. */
+  bool stopping{false};                    /**< Whether to exit. */
+  std::atomic<bool> cancelled{false};      /**< Stops the running fit. */
+  std::atomic<std::uint64_t> discarded{0}; /**< Out-of-date snapshots. */
+  std::thread thread;                      /**< Runs loop(). */
+
+  void loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [this] { return stopping || pending.has_value(); });
+      if (stopping) {
+        return;
+      }
+      auto request = std::move(*pending);
+      pending.reset();
+      cancelled = false;
+      lock.unlock();
+
+      auto start = std::chrono::steady_clock::now();
+      auto result = ApproximationCalculator::fit_best_function(
+          request.x, request.y, request.w, options);
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+
+      lock.lock();
+      if (pending) {
+        // A newer snapshot arrived while fitting and cancelled it
+        ++discarded;
+        continue;
+      }
+      lock.unlock();
+      done(std::move(request), std::move(result), elapsed.count());
+      lock.lock();
+    }
+  }
+};
+
+#endif /* B7E3F9A5_2D6C_4B81_8F0E_5A1C7D3B9E42 */
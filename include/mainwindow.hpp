@@ -1,16 +1,29 @@
 #ifndef F0C149B2_1688_4B08_AA51_D271DD3E55A3
 #define F0C149B2_1688_4B08_AA51_D271DD3E55A3
 
+#include "fit_cache.hpp"
+#include "fit_options.hpp"
+#include "fit_result.hpp"
+#include "latency_recorder.hpp"
+#include "lazy_plot.hpp"
+#include "live_fit.hpp"
+#include "sampled_fit.hpp"
+#include "startup_profile.hpp"
 #include "table_event_handler.hpp"
 #include "ui_mainwindow.hpp"
 #include <QDateTime>
 #include <QDebug>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QTimer>
 #include <QToolTip>
 #include <QtCharts/QChart>
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -22,12 +35,87 @@ class MainWindow final : public QMainWindow {
   Q_OBJECT
 
 public:
-  explicit MainWindow(QWidget *parent = nullptr);
+  /**
+   * @brief Constructs the window; the graph is created once it is shown.
+   * @param parent The parent widget.
+   * @param profile Receives the startup milestones, if not null.
+   */
+  explicit MainWindow(QWidget *parent = nullptr,
+                      StartupProfile *profile = nullptr);
   ~MainWindow() override = default;
 
+signals:
+  /**
+   * @brief Emitted once the graph page has loaded.
+   */
+  void plot_ready();
+
+protected:
+  bool event(QEvent *event) override;
+
 private:
   std::unique_ptr<Ui::MainWindow> ui = std::make_unique<Ui::MainWindow>();
   std::unique_ptr<TableEventHandler> table_event_handler;
+  std::unique_ptr<LazyPlot> plot; /**< The graph, created after startup. */
+  StartupProfile *profile;        /**< Startup milestones, if recorded. */
+  bool painted{false};            /**< Whether the window was painted. */
+  FitOptions fit_options; /**< Options shared by model selection and fitting. */
+  FitCache fit_cache;     /**< Results of previous calculations. */
+  std::optional<FitResult> last_result; /**< The fit shown last. */
+  std::vector<double> last_x;           /**< The x-values it was fitted to. */
+  std::vector<double> last_y;           /**< The y-values it was fitted to. */
+  std::vector<double> last_w;           /**< The weights it was fitted to. */
+
+  static constexpr int LIVE_DEBOUNCE_MS = 30; /**< Quiet time before a fit. */
+  static constexpr double LIVE_BUDGET_MS =
+      LiveFitWorker::BUDGET_MS; /**< Latency of a refresh. */
+  std::unique_ptr<LiveFitWorker> live_worker; /**< Fits while editing. */
+  QTimer live_timer;             /**< Coalesces bursts of edits. */
+  std::vector<double> live_x;    /**< The x-values in the table. */
+  std::vector<double> live_y;    /**< The y-values in the table. */
+  std::vector<double> live_w;    /**< The weights in the table. */
+  std::vector<int> live_edited;  /**< Rows edited since the last snapshot. */
+  std::vector<int> live_stale;   /**< Rows snapshotted but not plotted. */
+  bool live_rescan{true};        /**< Whether rows were added or removed. */
+  bool live_replot{true};        /**< Whether to plot every point. */
+  int plotted_points{0};         /**< Point expressions in the graph. */
+  std::uint64_t live_generation{0}; /**< The newest snapshot. */
+  std::chrono::steady_clock::time_point live_start; /**< When it was taken. */
+  LatencyRecorder live_latency{1024}; /**< Recent refresh latencies, us. */
+  std::uint64_t live_refreshes{0}; /**< Fits shown while editing. */
+  std::uint64_t live_misses{0};    /**< Refreshes over LIVE_BUDGET_MS. */
+
+  /**
+   * @brief Keeps a fit and its points for export_results().
+   */
+  void remember_result(FitResult const &result, std::vector<double> &&x,
+                       std::vector<double> &&y, std::vector<double> &&w);
+
+  /**
+   * @brief Fits a sample of the points within the budget set in the window
+   * and prints the result with its error estimates.
+   */
+  void calculate_sampled(std::vector<double> &&x, std::vector<double> &&y,
+                         std::vector<double> &&w);
+
+  /**
+   * @brief Reads a row of the table; missing or invalid weights count as
+   * unit weights.
+   */
+  void read_point(int row, double &x, double &y, double &w) const;
+
+  /**
+   * @brief Snapshots the points once edits have settled and fits them in
+   * the background, or reuses an identical earlier fit.
+   */
+  void start_live_fit();
+
+  /**
+   * @brief Shows a live fit unless a newer snapshot was taken, plotting
+   * only the points that changed, and records the refresh latency.
+   */
+  void apply_live_fit(LiveFitWorker::Request const &request,
+                      FitResult const &result, double fit_ms);
 
 private slots:
   void show_file_dialog();
@@ -35,6 +123,9 @@ private slots:
   void add_point();
   void clear_points();
   void calculate();
+  void export_results();
+  void set_live(bool enabled);
+  void point_edited(QTableWidgetItem *item);
 };
 
 #endif /* F0C149B2_1688_4B08_AA51_D271DD3E55A3 */
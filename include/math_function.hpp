@@ -1,9 +1,13 @@
 #ifndef E861E497_907A_4B3B_B012_A26997C6C307
 #define E861E497_907A_4B3B_B012_A26997C6C307
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 /**
@@ -12,6 +16,9 @@
  */
 class Function {
 public:
+  constexpr static int EXPANDED_DIGITS =
+      7; /**< The significant digits printed for coefficients of t. */
+
   enum Type : uint8_t {
     Polynomial,
     Exponential,
@@ -44,8 +51,188 @@ public:
    */
   Type get_type() const { return type; }
 
+  /**
+   * @brief Retrieves the same function of u = (t - shift) / scale instead of
+   * t, where t is ln x for logarithmic and power functions and x otherwise.
+   *
+   * Fits far from the origin, such as of timestamps, keep their coefficients
+   * in such a basis: expanded in powers of x they would cancel
+   * catastrophically. Exponential and power functions of u are
+   * c0 * exp(c1 * u).
+   * @param shift The value of t mapped to zero.
+   * @param scale The width of t mapped to one.
+   */
+  Function in_basis(double shift, double scale) const {
+    auto func = *this;
+    func.shift = shift;
+    func.scale = scale;
+    func.origin = std::exp(shift);
+    return func;
+  }
+
+  /**
+   * @brief Retrieves the value of t mapped to zero by the basis.
+   */
+  double get_shift() const { return shift; }
+
+  /**
+   * @brief Retrieves the width of t mapped to one by the basis.
+   */
+  double get_scale() const { return scale; }
+
+  /**
+   * @brief Checks whether the coefficients are not simply of t.
+   */
+  bool has_basis() const { return shift != 0.0 || scale != 1.0; }
+
+  /**
+   * @brief Checks whether the function is of ln x rather than of x.
+   */
+  bool is_of_log_x() const { return type == Logarithmic || type == Power; }
+
+  /**
+   * @brief Computes u at x. For functions of ln x the logarithm is taken of
+   * x / exp(shift), so that narrow ranges far from 1 keep their digits.
+   */
+  double basis_value(double x) const {
+    if (!is_of_log_x()) {
+      return (x - shift) / scale;
+    }
+    return (shift == 0.0 ? std::log(x) : std::log(x / origin)) / scale;
+  }
+
+  /**
+   * @brief Converts coefficients of this function to the basis
+   * v = (t - shift) / scale; the curve is unchanged up to rounding.
+   *
+   * Polynomials are composed with u = alpha * v + beta by Horner's scheme on
+   * polynomials: the running polynomial is multiplied by u and the next
+   * coefficient is added.
+   */
+  std::vector<double> rebase(std::vector<double> const &coefficients,
+                             double to_shift, double to_scale) const {
+    if (to_shift == shift && to_scale == scale) {
+      return coefficients;
+    }
+    auto alpha = to_scale / scale;
+    auto beta = (to_shift - shift) / scale;
+    if (type == Exponential || type == Power) {
+      // c0 * exp(c1 * u) = c0 * exp(c1 * beta) * exp(c1 * alpha * v)
+      return {coefficients[0] * std::exp(coefficients[1] * beta),
+              coefficients[1] * alpha};
+    }
+    auto m = static_cast<int>(coefficients.size()) - 1;
+    std::vector<double> result(coefficients.size(), 0.0);
+    for (int k = m; k >= 0; --k) {
+      for (int j = m; j >= 1; --j) {
+        result[j] = result[j] * beta + result[j - 1] * alpha;
+      }
+      result[0] = result[0] * beta + coefficients[k];
+    }
+    return result;
+  }
+
+  /**
+   * @brief Formats a coefficient with at least four decimals and digits
+   * significant digits, switching to mantissa * 10^exponent (in escaped
+   * LaTeX) for very small or large values so that coefficients mapped back
+   * from a shifted range do not print as 0.
+   */
+  static std::string format_coefficient(double value, int digits = 5) {
+    std::stringstream ss;
+    ss << std::fixed;
+    auto magnitude = std::fabs(value);
+    if (value == 0.0 || !std::isfinite(value)) {
+      ss << std::setprecision(4) << value;
+      return ss.str();
+    }
+    auto exponent = static_cast<int>(std::floor(std::log10(magnitude)));
+    if (magnitude >= 1e-2 && magnitude < 1e7) {
+      ss << std::setprecision(std::max(4, digits - 1 - exponent)) << value;
+      return ss.str();
+    }
+    auto mantissa = value / std::pow(10.0, exponent);
+    if (std::fabs(mantissa) >= 10.0 - 5.0 * std::pow(10.0, -digits)) {
+      // Rounding the mantissa would print 10.0000
+      mantissa /= 10.0;
+      ++exponent;
+    }
+    ss << std::setprecision(std::max(4, digits - 1)) << mantissa
+       << R"(\\cdot10^{)" << exponent << "}";
+    return ss.str();
+  }
+
+  /**
+   * @brief Formats a value in plain decimals with the fewest significant
+   * digits that read back as the same double, so that the shift of a basis
+   * such as 1700000071 prints in full.
+   */
+  static std::string format_exact(double value) {
+    std::stringstream ss;
+    if (value == 0.0 || !std::isfinite(value)) {
+      ss << value;
+      return ss.str();
+    }
+    auto exponent = static_cast<int>(std::floor(std::log10(std::fabs(value))));
+    std::string text;
+    for (int digits = 1; digits <= 17; ++digits) {
+      ss.str("");
+      ss << std::fixed << std::setprecision(std::max(0, digits - 1 - exponent))
+         << value;
+      text = ss.str();
+      if (std::stod(text) == value) {
+        break;
+      }
+    }
+    if (text.find('.') != std::string::npos) {
+      text.erase(text.find_last_not_of('0') + 1);
+      if (text.back() == '.') {
+        text.pop_back();
+      }
+    }
+    return text;
+  }
+
+  /**
+   * @brief Describes the basis in plain text, e.g. "u = (x - 71) / 12".
+   */
+  std::string get_basis_string() const {
+    std::string t = is_of_log_x() ? "ln(x)" : "x";
+    if (!has_basis()) {
+      return "u = " + t;
+    }
+    return "u = (" + t + (shift < 0.0 ? " + " : " - ") +
+           format_exact(std::fabs(shift)) + ") / " + format_exact(scale);
+  }
+
   // Methods for getting string representations of different function types...
 
+  /**
+   * @brief Formats a coefficient of this function. In a basis |u| <= 1 over
+   * the data, so five significant digits reproduce the curve; coefficients
+   * of t get EXPANDED_DIGITS, which covers the growth of up to 100 that the
+   * calculator allows when it expands them.
+   */
+  std::string coefficient_string(double value) const {
+    return format_coefficient(value, has_basis() ? 5 : EXPANDED_DIGITS);
+  }
+
+  /**
+   * @brief Retrieves the variable of the coefficients in escaped LaTeX: x,
+   * \\ln(x) or the basis as a fraction.
+   */
+  std::string get_variable_string() const {
+    std::string t = is_of_log_x() ? R"(\\ln(x))" : "x";
+    if (!has_basis()) {
+      return t;
+    }
+    if (shift != 0.0) {
+      t += (shift < 0.0 ? "+" : "-") + format_exact(std::fabs(shift));
+    }
+    return R"(\\left(\\frac{)" + t + "}{" + format_exact(scale) +
+           R"(}\\right))";
+  }
+
   std::string
   get_polynomial_string(const std::vector<double> &coefficients) const {
     std::stringstream ss;
@@ -55,10 +242,12 @@ public:
       if (coef != 0.0 || (i == 0 && coefficients.size() == 1)) {
         if (!first) {
           ss << (coef >= 0.0 ? "+" : "-");
+        } else if (coef < 0.0) {
+          ss << "-";
         }
-        ss << std::fixed << std::setprecision(4) << std::abs(coef);
+        ss << coefficient_string(std::abs(coef));
         if (i > 0) {
-          ss << "x";
+          ss << get_variable_string();
           if (i > 1) {
             ss << "^" << i;
           }
@@ -75,8 +264,8 @@ public:
   std::string
   get_exponential_string(const std::vector<double> &coefficients) const {
     std::stringstream ss;
-    ss << std::fixed << std::setprecision(4) << coefficients[0] << R"(*\\exp()"
-       << coefficients[1] << "x"
+    ss << coefficient_string(coefficients[0]) << R"(*\\exp()"
+       << coefficient_string(coefficients[1]) << get_variable_string()
        << ")";
     return ss.str();
   }
@@ -84,15 +273,18 @@ public:
   std::string
   get_logarithmic_string(const std::vector<double> &coefficients) const {
     std::stringstream ss;
-    ss << std::fixed << std::setprecision(4) << coefficients[0] << " + "
-       << coefficients[1] << R"(*\\ln(x))";
+    ss << coefficient_string(coefficients[0]) << " + "
+       << coefficient_string(coefficients[1]) << "*" << get_variable_string();
     return ss.str();
   }
 
   std::string get_power_string(const std::vector<double> &coefficients) const {
+    if (has_basis()) {
+      return get_exponential_string(coefficients);
+    }
     std::stringstream ss;
-    ss << std::fixed << std::setprecision(4) << coefficients[0] << "x^"
-       << coefficients[1];
+    ss << coefficient_string(coefficients[0]) << "x^{"
+       << coefficient_string(coefficients[1]) << "}";
     return ss.str();
   }
 
@@ -132,8 +324,11 @@ public:
   }
 
 private:
-  int m;     /**< The parameter m for polynomial functions. */
-  Type type; /**< The type of the function. */
+  int m;              /**< The parameter m for polynomial functions. */
+  Type type;          /**< The type of the function. */
+  double shift{0.0};  /**< The value of t mapped to u = 0. */
+  double scale{1.0};  /**< The width of t mapped to u = 1. */
+  double origin{1.0}; /**< exp(shift), the x mapped to u = 0 for ln x. */
 };
 
 #endif /* E861E497_907A_4B3B_B012_A26997C6C307 */
@@ -0,0 +1,309 @@
+#ifndef C4F2A9D3_1B6E_4D7A_9E55_7A0B3C8D2E14
+#define C4F2A9D3_1B6E_4D7A_9E55_7A0B3C8D2E14
+
+#include "calculator.hpp"
+#include "cholesky.hpp"
+#include "fit_options.hpp"
+#include "math_function.hpp"
+#include "polynomial_moments.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief The MultiSeriesFitter class fits many y series sampled at the same x
+ * values and selects the best function for each series.
+ *
+ * Every candidate is a least-squares problem in x or ln(x), mapped onto
+ * [-1, 1] as in ApproximationCalculator, whose normal matrix depends on x
+ * only. Each matrix is therefore accumulated and factored once, the
+ * right-hand sides of all series are accumulated together in blocks of
+ * points and all series are solved at once with a matrix right-hand side. Leave-one-out leverages depend on x only as well and are
+ * shared too.
+ *
+ * Series that need per-series work anyway (exponential or power fits of
+ * series with non-positive values, nonlinear refinement, robust fitting and
+ * k-fold selection) go through ApproximationCalculator for those candidates.
+ */
+class MultiSeriesFitter {
+public:
+  /**
+   * @brief The best fit of one series.
+   */
+  struct Result {
+    Function function;                /**< The best matching function. */
+    std::vector<double> coefficients; /**< The coefficients of the function. */
+    double deviation;                 /**< The selection score. */
+  };
+
+private:
+  constexpr static int BLOCK = 256; /**< Points per accumulation block. */
+
+  std::vector<double> x;                   /**< The shared x-values. */
+  std::vector<std::vector<double>> series; /**< The y-values of each series. */
+  FitOptions options;                      /**< The fitting options. */
+
+  /**
+   * @brief One candidate function together with the least-squares problem
+   * that fits it.
+   */
+  struct Candidate {
+    Function function; /**< The candidate function. */
+    bool log_basis;    /**< Whether the variable is ln(x) instead of x. */
+    bool log_target;   /**< Whether the target is ln(y) instead of y. */
+  };
+
+  /**
+   * @brief Accumulates rhs[k * S + s] = sum(u^k * target_s) for k <= degree.
+   *
+   * The powers of u are computed once per block of points and reused by all
+   * series; empty targets are skipped.
+   */
+  static void accumulate_right_hand_sides(
+      std::vector<double> const &u,
+      std::vector<std::vector<double>> const &targets, int degree,
+      std::vector<double> &rhs) {
+    auto n = static_cast<int>(u.size());
+    auto columns = static_cast<int>(targets.size());
+    rhs.assign(static_cast<std::size_t>(degree + 1) * columns, 0.0);
+    std::vector<double> powers(static_cast<std::size_t>(degree + 1) * BLOCK);
+    for (int start = 0; start < n; start += BLOCK) {
+      auto length = std::min(BLOCK, n - start);
+      for (int j = 0; j < length; ++j) {
+        auto power = 1.0;
+        for (int k = 0; k <= degree; ++k) {
+          powers[k * BLOCK + j] = power;
+          power *= u[start + j];
+        }
+      }
+      for (int s = 0; s < columns; ++s) {
+        if (targets[s].empty()) {
+          continue;
+        }
+        auto const *target = targets[s].data() + start;
+        for (int k = 0; k <= degree; ++k) {
+          auto const *power = &powers[k * BLOCK];
+          auto sum = 0.0;
+          for (int j = 0; j < length; ++j) {
+            sum += power[j] * target[j];
+          }
+          rhs[static_cast<std::size_t>(k) * columns + s] += sum;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Computes the leverages h_i = phi_i^T * G^-1 * phi_i of a basis.
+   */
+  static std::vector<double> leverages(std::vector<double> const &u, int p,
+                                       CholeskyDecomposition const &cholesky) {
+    std::vector<double> h(u.size());
+    std::vector<double> z(p);
+    for (std::size_t i = 0; i < u.size(); ++i) {
+      auto power = 1.0;
+      for (int k = 0; k < p; ++k) {
+        z[k] = power;
+        power *= u[i];
+      }
+      cholesky.forward_substitution(z.data());
+      auto sum = 0.0;
+      for (auto &&zi : z) {
+        sum += zi * zi;
+      }
+      h[i] = sum;
+    }
+    return h;
+  }
+
+  /**
+   * @brief Fits and scores one candidate for one series through the general
+   * single-series path.
+   */
+  Result fit_single(Function func, std::vector<double> const &y) const {
+    auto n = static_cast<int>(x.size());
+    auto coefficients = ApproximationCalculator::approximation_calculation(
+        func, n, x, y, {}, options);
+    auto deviation = ApproximationCalculator::selection_deviation(
+        func, n, x, y, {}, coefficients, options);
+    return {func, coefficients, deviation};
+  }
+
+public:
+  /**
+   * @brief Constructs a MultiSeriesFitter object.
+   * @param x The x-values shared by all series.
+   * @param series The y-values of each series, each as long as x.
+   * @param options The options used when fitting the functions.
+   */
+  MultiSeriesFitter(std::vector<double> const &x,
+                    std::vector<std::vector<double>> const &series,
+                    FitOptions const &options = FitOptions())
+      : x(x), series(series), options(options) {}
+
+  /**
+   * @brief Finds the best function of every series.
+   * @return One result per series, in input order. A series no candidate can
+   * fit gets the linear polynomial with an infinite deviation.
+   */
+  std::vector<Result> fit() const {
+    auto n = static_cast<int>(x.size());
+    auto columns = static_cast<int>(series.size());
+    std::vector<Result> best(
+        columns, Result{Function(Function::Type::Polynomial, 1), {}, INFINITY});
+    auto consider = [&](int s, Result result) {
+      if (std::isfinite(result.deviation) &&
+          result.deviation < best[s].deviation) {
+        best[s] = std::move(result);
+      }
+    };
+
+    auto positive_x = std::all_of(x.begin(), x.end(),
+                                  [](double xi) { return xi > 0.0; });
+    std::vector<Candidate> candidates;
+    for (int m = 1; m <= 3; ++m) {
+      candidates.push_back(
+          {Function(Function::Type::Polynomial, m), false, false});
+    }
+    candidates.push_back({Function(Function::Type::Exponential), false, true});
+    if (positive_x) {
+      candidates.push_back(
+          {Function(Function::Type::Logarithmic), true, false});
+      candidates.push_back({Function(Function::Type::Power), true, true});
+    }
+
+    // Robust fits and k-fold selection have no shared x-side work
+    if (options.robust_loss != FitOptions::RobustLoss::None ||
+        options.selection == FitOptions::Selection::KFold) {
+      for (int s = 0; s < columns; ++s) {
+        for (auto const &candidate : candidates) {
+          consider(s, fit_single(candidate.function, series[s]));
+        }
+      }
+      return best;
+    }
+
+    // ln(y) of the series that admit exponential and power fits
+    std::vector<std::vector<double>> log_series(columns);
+    for (int s = 0; s < columns; ++s) {
+      if (std::all_of(series[s].begin(), series[s].end(),
+                      [](double yi) { return yi > 0.0; })) {
+        log_series[s].resize(n);
+        for (int i = 0; i < n; ++i) {
+          log_series[s][i] = std::log(series[s][i]);
+        }
+      }
+    }
+    // The variables u of x and of ln(x), in the bases of the single-series
+    // fits, so that data far from the origin keep their digits
+    auto const x_basis = ApproximationCalculator::fitting_basis(
+        Function(Function::Type::Polynomial, 1), n, x, options);
+    auto const log_basis = ApproximationCalculator::fitting_basis(
+        Function(Function::Type::Logarithmic), n, x, options);
+    std::vector<double> x_u(n);
+    std::vector<double> log_u;
+    for (int i = 0; i < n; ++i) {
+      x_u[i] = x_basis.basis_value(x[i]);
+    }
+    if (positive_x) {
+      log_u.resize(n);
+      for (int i = 0; i < n; ++i) {
+        log_u[i] = log_basis.basis_value(x[i]);
+      }
+    }
+
+    // x-side moments and the right-hand sides of every series
+    PolynomialMoments x_moments(3);
+    PolynomialMoments log_moments(1);
+    for (int i = 0; i < n; ++i) {
+      x_moments.add(x_u[i], 0.0);
+      if (positive_x) {
+        log_moments.add(log_u[i], 0.0);
+      }
+    }
+    std::vector<double> rhs_x_y;
+    std::vector<double> rhs_x_lny;
+    std::vector<double> rhs_lnx_y;
+    std::vector<double> rhs_lnx_lny;
+    accumulate_right_hand_sides(x_u, series, 3, rhs_x_y);
+    accumulate_right_hand_sides(x_u, log_series, 1, rhs_x_lny);
+    if (positive_x) {
+      accumulate_right_hand_sides(log_u, series, 1, rhs_lnx_y);
+      accumulate_right_hand_sides(log_u, log_series, 1, rhs_lnx_lny);
+    }
+
+    auto const loo =
+        options.selection == FitOptions::Selection::LeaveOneOut;
+    for (auto const &candidate : candidates) {
+      auto func = candidate.function;
+      auto p = func.get_type() == Function::Type::Polynomial ? func.get_m() + 1
+                                                             : 2;
+      auto const &u = candidate.log_basis ? log_u : x_u;
+      auto const &basis = candidate.log_basis ? log_basis : x_basis;
+      auto const &moments = candidate.log_basis ? log_moments : x_moments;
+      auto const &rhs = candidate.log_target
+                            ? (candidate.log_basis ? rhs_lnx_lny : rhs_x_lny)
+                            : (candidate.log_basis ? rhs_lnx_y : rhs_x_y);
+
+      // Factor the x-side matrix once and solve all series together
+      CholeskyDecomposition cholesky(moments.normal_matrix(p - 1));
+      if (!cholesky.is_positive_definite()) {
+        continue;
+      }
+      std::vector<double> solutions(rhs.begin(),
+                                    rhs.begin() +
+                                        static_cast<std::size_t>(p) * columns);
+      cholesky.solve_matrix_in_place(solutions.data(), columns);
+      std::vector<double> h;
+      if (loo) {
+        h = leverages(u, p, cholesky);
+        if (std::any_of(h.begin(), h.end(),
+                        [](double hi) { return hi >= 1.0 - 1e-12; })) {
+          continue;
+        }
+      }
+
+      for (int s = 0; s < columns; ++s) {
+        auto const &y = series[s];
+        if (candidate.log_target &&
+            (log_series[s].empty() || options.nonlinear_refinement)) {
+          consider(s, fit_single(func, y));
+          continue;
+        }
+
+        std::vector<double> coefficients(p);
+        for (int k = 0; k < p; ++k) {
+          coefficients[k] =
+              solutions[static_cast<std::size_t>(k) * columns + s];
+        }
+        // Fitted values and residuals in the space of the fit
+        auto const &target = candidate.log_target ? log_series[s] : y;
+        auto sum = 0.0;
+        for (int i = 0; i < n; ++i) {
+          auto eta = 0.0;
+          for (int k = p - 1; k >= 0; --k) {
+            eta = eta * u[i] + coefficients[k];
+          }
+          if (loo) {
+            auto r = target[i] - eta;
+            eta -= h[i] * r / (1.0 - h[i]);
+          }
+          auto e = y[i] - (candidate.log_target ? std::exp(eta) : eta);
+          sum += e * e;
+        }
+        if (candidate.log_target) {
+          coefficients[0] = std::exp(coefficients[0]);
+        }
+        auto fitted = func.in_basis(basis.get_shift(), basis.get_scale());
+        ApproximationCalculator::expand_if_well_conditioned(fitted,
+                                                            coefficients);
+        consider(s, {fitted, coefficients, std::sqrt(sum / n)});
+      }
+    }
+    return best;
+  }
+};
+
+#endif /* C4F2A9D3_1B6E_4D7A_9E55_7A0B3C8D2E14 */
@@ -0,0 +1,326 @@
+#ifndef E5A7C2D1_3F9B_4C86_A0E4_8B6D2F1C7A93
+#define E5A7C2D1_3F9B_4C86_A0E4_8B6D2F1C7A93
+
+#include "cholesky.hpp"
+#include "parallel.hpp"
+#include "summation.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief The BasicMultivariateRegression class fits y = b0 + b1 * x1 + ... +
+ * bk * xk by least squares in a single streaming pass.
+ *
+ * Rows are consumed in chunks and only the augmented Gram matrix [X | y]^T
+ * [X | y] is kept, so memory does not depend on the number of rows. Each
+ * chunk is split across all hardware threads; every thread transposes tiles
+ * of TILE rows into column-major order and accumulates all column dot
+ * products of a tile while it is resident in L1 cache, with the inner loops
+ * vectorized. The per-thread sums are merged after each chunk and the normal
+ * equations are solved by Cholesky decomposition.
+ *
+ * Every value is taken about the first accumulated row before it enters a
+ * tile, so columns far from zero, such as timestamps, neither lose their
+ * digits in the cast to Scalar nor cancel in the sums; solve() and
+ * residual_sum_of_squares() convert between the shifted and the original
+ * coefficients. Tiles are stored as Scalar and the dot products of a tile
+ * are formed in Scalar; the tile sums are then accumulated across tiles in
+ * Accumulator. With float tiles a SIMD register holds twice as many values,
+ * at float accuracy within each tile of TILE rows; KahanSum or PairwiseSum
+ * keep the double sums of very long inputs accurate.
+ */
+template <typename Scalar = double, typename Accumulator = PlainSum>
+class BasicMultivariateRegression {
+private:
+  constexpr static int TILE = 64; /**< Rows per cache-resident tile. */
+
+  int predictors;                /**< The number of predictors k. */
+  int columns;                   /**< k + 2: intercept, predictors and y. */
+  std::vector<Accumulator> gram; /**< Lower triangle of [1 X y]^T [1 X y]. */
+  std::size_t malformed{0};      /**< Text rows rejected by accumulate_text. */
+  std::vector<double> origin;    /**< The first row, x1 ... xk y. */
+  bool has_origin{false};        /**< Whether origin holds a row yet. */
+
+  /**
+   * @brief Per-thread accumulation state.
+   */
+  struct Workspace {
+    std::vector<Scalar> tile;      /**< Column-major TILE * columns rows. */
+    std::vector<Accumulator> gram; /**< Partial Gram matrix of the thread. */
+    int rows{0};                   /**< Rows currently in the tile. */
+    std::size_t malformed{0};      /**< Rejected text rows. */
+  };
+
+  Workspace make_workspace() const {
+    Workspace workspace;
+    workspace.tile.assign(static_cast<std::size_t>(TILE) * columns, Scalar());
+    workspace.gram.resize(static_cast<std::size_t>(columns) * columns);
+    return workspace;
+  }
+
+  /**
+   * @brief Adds the dot products of all column pairs of the tile to the
+   * workspace Gram matrix and empties the tile.
+   */
+  void flush(Workspace &workspace) const {
+    auto rows = workspace.rows;
+    for (int i = 0; i < columns; ++i) {
+      auto const *a = &workspace.tile[static_cast<std::size_t>(i) * TILE];
+      for (int j = 0; j <= i; ++j) {
+        auto const *b = &workspace.tile[static_cast<std::size_t>(j) * TILE];
+        Scalar sum = 0;
+#pragma omp simd reduction(+ : sum)
+        for (int r = 0; r < rows; ++r) {
+          sum += a[r] * b[r];
+        }
+        workspace.gram[static_cast<std::size_t>(i) * columns + j].add(sum);
+      }
+    }
+    workspace.rows = 0;
+  }
+
+  /**
+   * @brief Appends one row (predictors followed by y), taken about the
+   * origin, to the tile.
+   */
+  void push(Workspace &workspace, double const *row) const {
+    auto r = workspace.rows;
+    workspace.tile[r] = 1;
+    for (int c = 1; c < columns; ++c) {
+      workspace.tile[static_cast<std::size_t>(c) * TILE + r] =
+          static_cast<Scalar>(row[c - 1] - origin[c - 1]);
+    }
+    if (++workspace.rows == TILE) {
+      flush(workspace);
+    }
+  }
+
+  void merge(std::vector<Workspace> &workspaces) {
+    for (auto &workspace : workspaces) {
+      if (workspace.rows > 0) {
+        flush(workspace);
+      }
+      for (std::size_t e = 0; e < gram.size(); ++e) {
+        gram[e] += workspace.gram[e];
+      }
+      malformed += workspace.malformed;
+    }
+  }
+
+  /**
+   * @brief Makes a row the origin of all rows if there is none yet.
+   */
+  void set_origin(double const *row) {
+    if (!has_origin) {
+      origin.assign(row, row + predictors + 1);
+      has_origin = true;
+    }
+  }
+
+  /**
+   * @brief Parses one line of text into row.
+   * @return The number of values, or -1 if the line has too many values or
+   * one that is not a number.
+   */
+  static int parse_line(char const *p, char const *line_end,
+                        std::vector<double> &row) {
+    std::size_t values = 0;
+    while (true) {
+      while (p < line_end &&
+             (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r')) {
+        ++p;
+      }
+      if (p >= line_end || *p == '#') {
+        return static_cast<int>(values);
+      }
+      double value;
+      auto [next, ec] = std::from_chars(p, line_end, value);
+      if (ec != std::errc() || values >= row.size()) {
+        return -1;
+      }
+      row[values++] = value;
+      p = next;
+    }
+  }
+
+  /**
+   * @brief Converts between coefficients of the original rows and of the
+   * rows taken about the origin; only the intercept differs.
+   * @param sign 1 to convert to the shifted rows, -1 back to the original.
+   */
+  std::vector<double> shift_intercept(std::vector<double> coefficients,
+                                      double sign) const {
+    if (!has_origin) {
+      return coefficients;
+    }
+    auto shift = -origin[predictors];
+    for (int j = 0; j < predictors; ++j) {
+      shift += coefficients[j + 1] * origin[j];
+    }
+    coefficients[0] += sign * shift;
+    return coefficients;
+  }
+
+  double at(int i, int j) const {
+    return i >= j ? gram[static_cast<std::size_t>(i) * columns + j].value()
+                  : gram[static_cast<std::size_t>(j) * columns + i].value();
+  }
+
+public:
+  /**
+   * @brief Constructs an empty regression.
+   * @param predictors The number of predictor columns k.
+   */
+  explicit BasicMultivariateRegression(int predictors)
+      : predictors(predictors), columns(predictors + 2),
+        gram(static_cast<std::size_t>(columns) * columns) {}
+
+  /**
+   * @brief Retrieves the number of predictors.
+   */
+  int get_predictors() const { return predictors; }
+
+  /**
+   * @brief Retrieves the number of accumulated rows.
+   */
+  std::size_t size() const {
+    return static_cast<std::size_t>(gram[0].value());
+  }
+
+  /**
+   * @brief Retrieves the number of text rows that were rejected.
+   */
+  std::size_t malformed_rows() const { return malformed; }
+
+  /**
+   * @brief Accumulates rows stored row-major as x1 ... xk y.
+   * @param rows The row data, count * (k + 1) values.
+   * @param count The number of rows.
+   */
+  void accumulate(double const *rows, std::size_t count) {
+    if (count > 0) {
+      set_origin(rows);
+    }
+    std::vector<Workspace> workspaces(worker_count(), make_workspace());
+    auto stride = static_cast<std::size_t>(predictors) + 1;
+    parallel_for(count, [&](std::size_t begin, std::size_t end,
+                            unsigned worker) {
+      auto &workspace = workspaces[worker];
+      for (auto r = begin; r < end; ++r) {
+        push(workspace, rows + r * stride);
+      }
+    });
+    merge(workspaces);
+  }
+
+  /**
+   * @brief Parses and accumulates a block of text rows.
+   *
+   * Each line holds k predictor values followed by y, separated by
+   * whitespace or commas; empty lines and lines starting with '#' are
+   * skipped and lines with a different number of values are counted as
+   * malformed. The block must end at a line boundary. It is cut into one
+   * line-aligned slice per thread and every thread parses its slice and
+   * accumulates it directly, so parsing scales with the cores too.
+   */
+  void accumulate_text(char const *begin, char const *end) {
+    // The first complete row becomes the origin
+    std::vector<double> row(static_cast<std::size_t>(predictors) + 1);
+    for (auto const *p = begin; !has_origin && p < end;) {
+      auto const *line_end = std::find(p, end, '\n');
+      if (parse_line(p, line_end, row) == static_cast<int>(row.size())) {
+        set_origin(row.data());
+      }
+      p = line_end == end ? end : line_end + 1;
+    }
+
+    std::vector<Workspace> workspaces(worker_count(), make_workspace());
+    auto length = static_cast<std::size_t>(end - begin);
+    parallel_for(length, [&](std::size_t first, std::size_t last,
+                             unsigned worker) {
+      auto &workspace = workspaces[worker];
+      // A slice owns the lines that start inside it
+      auto const *p = begin + first;
+      if (first > 0 && begin[first - 1] != '\n') {
+        p = std::find(p, end, '\n');
+        p = p == end ? end : p + 1;
+      }
+      std::vector<double> values_of_line(row.size());
+      while (p < begin + last && p < end) {
+        auto const *line_end = std::find(p, end, '\n');
+        auto values = parse_line(p, line_end, values_of_line);
+        if (values == static_cast<int>(values_of_line.size())) {
+          push(workspace, values_of_line.data());
+        } else if (values != 0) {
+          ++workspace.malformed;
+        }
+        p = line_end == end ? end : line_end + 1;
+      }
+    });
+    merge(workspaces);
+  }
+
+  /**
+   * @brief Solves the normal equations.
+   * @return The coefficients b0, b1, ..., bk, or an empty vector if the
+   * predictors are linearly dependent or there are too few rows.
+   */
+  std::vector<double> solve() const {
+    auto p = predictors + 1;
+    std::vector<double> matrix(static_cast<std::size_t>(p) * p);
+    std::vector<double> b(p);
+    for (int i = 0; i < p; ++i) {
+      for (int j = 0; j < p; ++j) {
+        matrix[static_cast<std::size_t>(i) * p + j] = at(i, j);
+      }
+      b[i] = at(columns - 1, i);
+    }
+    CholeskyDecomposition cholesky(p, matrix.data());
+    if (!cholesky.is_positive_definite()) {
+      return {};
+    }
+    return shift_intercept(cholesky.solve(b), -1.0);
+  }
+
+  /**
+   * @brief Computes the residual sum of squares of coefficients from the
+   * accumulated sums.
+   */
+  double residual_sum_of_squares(std::vector<double> const &coefficients)
+      const {
+    auto p = predictors + 1;
+    auto y = columns - 1;
+    auto shifted = shift_intercept(coefficients, 1.0);
+    auto sum = at(y, y);
+    for (int i = 0; i < p; ++i) {
+      sum -= 2.0 * shifted[i] * at(y, i);
+      for (int j = 0; j < p; ++j) {
+        sum += shifted[i] * shifted[j] * at(i, j);
+      }
+    }
+    return std::max(sum, 0.0);
+  }
+
+  /**
+   * @brief Computes the coefficient of determination of coefficients.
+   * @return R^2, or NAN if y is constant, where it is undefined.
+   */
+  double r_squared(std::vector<double> const &coefficients) const {
+    auto y = columns - 1;
+    auto n = at(0, 0);
+    auto total = at(y, y) - at(y, 0) * at(y, 0) / n;
+    if (!(total > 0.0)) {
+      return NAN;
+    }
+    return 1.0 - residual_sum_of_squares(coefficients) / total;
+  }
+};
+
+/** The regression with double tiles and plain double sums. */
+using MultivariateRegression = BasicMultivariateRegression<>;
+
+#endif /* E5A7C2D1_3F9B_4C86_A0E4_8B6D2F1C7A93 */
@@ -0,0 +1,54 @@
+#ifndef D9E04C6B_8A3F_4F1E_B2C7_5E1A7F3D9C28
+#define D9E04C6B_8A3F_4F1E_B2C7_5E1A7F3D9C28
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Retrieves the number of worker threads used by parallel_for.
+ * @return The number of hardware threads, at least one.
+ */
+inline unsigned worker_count() {
+  return std::max(1U, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief Splits [0, count) into one contiguous slice per worker and runs
+ * body(begin, end, worker) on each slice in parallel.
+ *
+ * The calling thread processes the first slice itself and returns once all
+ * slices are done. Worker indices are dense, so callers can keep per-worker
+ * state in a vector of worker_count() elements.
+ * @param count The number of items.
+ * @param body The callable invoked as body(begin, end, worker).
+ * @param workers The number of workers, zero for worker_count().
+ */
+template <typename Body>
+void parallel_for(std::size_t count, Body &&body, unsigned workers = 0) {
+  if (count == 0) {
+    return;
+  }
+  if (workers == 0) {
+    workers = worker_count();
+  }
+  auto slices = std::min<std::size_t>(workers, count);
+  auto chunk = (count + slices - 1) / slices;
+
+  std::vector<std::thread> threads;
+  threads.reserve(slices - 1);
+  for (std::size_t worker = 1; worker < slices; ++worker) {
+    auto begin = std::min(count, worker * chunk);
+    auto end = std::min(count, begin + chunk);
+    threads.emplace_back([&body, begin, end, worker] {
+      body(begin, end, static_cast<unsigned>(worker));
+    });
+  }
+  body(std::size_t{0}, std::min(count, chunk), 0U);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+#endif /* D9E04C6B_8A3F_4F1E_B2C7_5E1A7F3D9C28 */
@@ -0,0 +1,186 @@
+#ifndef E8DD8E8A_F74A_48A4_BBF8_C953FB6EC0AC
+#define E8DD8E8A_F74A_48A4_BBF8_C953FB6EC0AC
+
+#include "cholesky.hpp"
+#include "summation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief The BasicPolynomialMoments class holds the sufficient statistics of a
+ * weighted polynomial least-squares fit in a basis variable u.
+ *
+ * For polynomials of degree up to m it keeps sum(w * u^k) for k <= 2m,
+ * sum(w * u^k * y) for k <= m and sum(w * y^2). Points can be added and
+ * removed in O(m), moments of disjoint sets can be added or subtracted, and
+ * the fit and its residual sum of squares follow from the sums alone.
+ *
+ * The sums are kept in Accumulator (see summation.hpp); compensated or
+ * pairwise accumulators keep the power sums of long series accurate. The
+ * power sums up to u^2m and the residual sum of squares cancel badly when u
+ * or y lie far from zero, so u and y should be taken about a point of the
+ * data; the normal equations can then be solved for u / scale.
+ */
+template <typename Accumulator = PlainSum> class BasicPolynomialMoments {
+private:
+  int degree;                           /**< The maximum polynomial degree. */
+  std::vector<Accumulator> power_sums;  /**< sum(w * u^k), k = 0..2m. */
+  std::vector<Accumulator> moment_sums; /**< sum(w * u^k * y), k = 0..m. */
+  Accumulator y_squared_sum;            /**< sum(w * y^2). */
+
+public:
+  /**
+   * @brief Constructs empty moments.
+   * @param degree The maximum polynomial degree the moments can fit.
+   */
+  explicit BasicPolynomialMoments(int degree)
+      : degree(degree), power_sums(2 * degree + 1),
+        moment_sums(degree + 1) {}
+
+  /**
+   * @brief Retrieves the maximum polynomial degree.
+   */
+  int get_degree() const { return degree; }
+
+  /**
+   * @brief Retrieves the total weight of the points.
+   */
+  double weight_sum() const { return power_sums[0].value(); }
+
+  /**
+   * @brief Retrieves sqrt(sum(w * u^2) / sum(w)), the typical size of u,
+   * which makes a scale for solve(); NAN without points.
+   */
+  double spread() const {
+    return std::sqrt(power_sums[2].value() / power_sums[0].value());
+  }
+
+  /**
+   * @brief Adds a point to the moments.
+   * @param u The basis value of the point (x, or ln(x) for logarithms).
+   * @param y The y-value of the point.
+   * @param w The weight of the point.
+   */
+  void add(double u, double y, double w = 1.0) {
+    auto power = w;
+    for (int k = 0; k <= 2 * degree; ++k) {
+      power_sums[k].add(power);
+      if (k <= degree) {
+        moment_sums[k].add(power * y);
+      }
+      power *= u;
+    }
+    y_squared_sum.add(w * y * y);
+  }
+
+  /**
+   * @brief Removes a point previously added with the same arguments.
+   */
+  void remove(double u, double y, double w = 1.0) { add(u, y, -w); }
+
+  /**
+   * @brief Resets the moments to the empty set.
+   */
+  void clear() {
+    std::fill(power_sums.begin(), power_sums.end(), Accumulator());
+    std::fill(moment_sums.begin(), moment_sums.end(), Accumulator());
+    y_squared_sum = Accumulator();
+  }
+
+  BasicPolynomialMoments &operator+=(BasicPolynomialMoments const &other) {
+    for (int k = 0; k <= 2 * degree; ++k) {
+      power_sums[k] += other.power_sums[k];
+    }
+    for (int k = 0; k <= degree; ++k) {
+      moment_sums[k] += other.moment_sums[k];
+    }
+    y_squared_sum += other.y_squared_sum;
+    return *this;
+  }
+
+  BasicPolynomialMoments &operator-=(BasicPolynomialMoments const &other) {
+    for (int k = 0; k <= 2 * degree; ++k) {
+      power_sums[k] -= other.power_sums[k];
+    }
+    for (int k = 0; k <= degree; ++k) {
+      moment_sums[k] -= other.moment_sums[k];
+    }
+    y_squared_sum -= other.y_squared_sum;
+    return *this;
+  }
+
+  /**
+   * @brief Builds the normal matrix of a degree m fit in u / scale.
+   */
+  std::vector<std::vector<double>> normal_matrix(int m,
+                                                 double scale = 1.0) const {
+    std::vector<std::vector<double>> matrix(m + 1,
+                                            std::vector<double>(m + 1, 0.0));
+    for (int i = 0; i <= m; ++i) {
+      for (int j = 0; j <= m; ++j) {
+        matrix[i][j] = power_sums[i + j].value() / std::pow(scale, i + j);
+      }
+    }
+    return matrix;
+  }
+
+  /**
+   * @brief Builds the right-hand side of the normal equations of a degree m
+   * fit in u / scale.
+   */
+  std::vector<double> right_hand_side(int m, double scale = 1.0) const {
+    std::vector<double> b(m + 1);
+    for (int k = 0; k <= m; ++k) {
+      b[k] = moment_sums[k].value() / std::pow(scale, k);
+    }
+    return b;
+  }
+
+  /**
+   * @brief Solves the normal equations of a degree m fit by Cholesky
+   * decomposition in O(m^3).
+   * @param scale Fits in u / scale, which keeps the matrix well conditioned
+   * when u spans far more or less than [-1, 1].
+   * @return The coefficients in ascending powers of u / scale, or an empty
+   * vector if the normal matrix is singular.
+   */
+  std::vector<double> solve(int m, double scale = 1.0) const {
+    CholeskyDecomposition cholesky(normal_matrix(m, scale));
+    if (!cholesky.is_positive_definite()) {
+      return {};
+    }
+    return cholesky.solve(right_hand_side(m, scale));
+  }
+
+  /**
+   * @brief Computes the weighted residual sum of squares of a polynomial.
+   *
+   * Uses sum(w * (y - c^T u)^2) = sum(w * y^2) - 2 * c^T b + c^T G c, so the
+   * cost does not depend on the number of points. The terms cancel down to
+   * the residuals, so the result carries a rounding error of about
+   * DBL_EPSILON * sum(w * y^2); negative results of that size become zero.
+   * @param coefficients The coefficients in ascending powers of u / scale.
+   * @param scale The scale the coefficients were solved with.
+   */
+  double sum_of_squares(std::vector<double> const &coefficients,
+                        double scale = 1.0) const {
+    auto m = static_cast<int>(coefficients.size()) - 1;
+    auto sum = y_squared_sum.value();
+    for (int i = 0; i <= m; ++i) {
+      auto ci = coefficients[i] / std::pow(scale, i);
+      sum -= 2.0 * ci * moment_sums[i].value();
+      for (int j = 0; j <= m; ++j) {
+        auto cj = coefficients[j] / std::pow(scale, j);
+        sum += ci * cj * power_sums[i + j].value();
+      }
+    }
+    return std::max(sum, 0.0);
+  }
+};
+
+/** The moments with plain double sums. */
+using PolynomialMoments = BasicPolynomialMoments<>;
+
+#endif /* E8DD8E8A_F74A_48A4_BBF8_C953FB6EC0AC */
@@ -0,0 +1,421 @@
+#ifndef E5A9C3F1_4B7D_4E26_9C8A_0D3F6B2E7A94
+#define E5A9C3F1_4B7D_4E26_9C8A_0D3F6B2E7A94
+
+#include "calculator.hpp"
+#include "fit_result.hpp"
+#include "math_function.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief The ResultWriter class exports a fit and its per-point values to a
+ * CSV, JSON Lines or binary columnar file.
+ *
+ * Every format starts with the model: the function, its expression and
+ * coefficients with their basis (the shift and scale of u = (t - shift) /
+ * scale, see Function::in_basis), the Pearson correlation, the RMS error and
+ * the largest absolute residual. The rows x, y, w, phi, epsilon follow. phi
+ * and epsilon are evaluated CHUNK points at a time into fixed buffers, and
+ * the rows are formatted with std::to_chars straight into per-chunk text
+ * buffers, one chunk per worker, which are copied in order into one output
+ * buffer that is written to the file whenever it fills up. Nothing is
+ * allocated per row.
+ *
+ * - CSV: the model as "# name,value..." comment lines, then a
+ *   "x,y,w,phi,epsilon" header and one row per point. The file can be read
+ *   back as a point file.
+ * - JSON Lines: one object with the model, then one object per point.
+ *   Non-finite numbers are written as null.
+ * - Binary: the magic "LAB3COLS", a uint32 version (2), the uint8 function
+ *   type and int32 degree, the shift and scale as doubles, a uint64
+ *   coefficient count and the coefficients, the three statistics as
+ *   doubles, then row groups. A row group is a uint64 row count followed by
+ *   the x, y, w, phi and epsilon columns of that many doubles each; a count
+ *   of zero ends the file. Numbers use the
+ *   byte order of the writing machine, as in the fit cache.
+ */
+class ResultWriter {
+public:
+  /**
+   * @brief The output format.
+   */
+  enum class Format {
+    Csv,       /**< Comma-separated text. */
+    JsonLines, /**< One JSON object per line. */
+    Binary     /**< Row groups of raw double columns. */
+  };
+
+  /**
+   * @brief Sets format from its name: csv, jsonl or binary.
+   * @return Whether the name is known.
+   */
+  static bool parse_format(std::string const &name, Format &format) {
+    if (name == "csv") {
+      format = Format::Csv;
+    } else if (name == "jsonl" || name == "json") {
+      format = Format::JsonLines;
+    } else if (name == "binary" || name == "bin") {
+      format = Format::Binary;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Picks the format from a file extension: .jsonl and .ndjson for
+   * JSON Lines, .bin for binary and CSV otherwise.
+   */
+  static Format format_of(std::string const &path) {
+    auto ends_with = [&path](std::string_view suffix) {
+      return path.size() >= suffix.size() &&
+             path.compare(path.size() - suffix.size(), suffix.size(),
+                          suffix) == 0;
+    };
+    if (ends_with(".jsonl") || ends_with(".ndjson")) {
+      return Format::JsonLines;
+    }
+    return ends_with(".bin") ? Format::Binary : Format::Csv;
+  }
+
+  /**
+   * @brief Creates the output file.
+   * @param path The path of the file.
+   * @param format The output format.
+   * @param workers The threads formatting text rows, zero for all.
+   * @param buffer_size The number of bytes collected per write.
+   */
+  ResultWriter(std::string const &path, Format format, unsigned workers = 0,
+               std::size_t buffer_size = std::size_t{1} << 20)
+      : format(format), buffer(buffer_size),
+        slots(workers == 0 ? worker_count() : workers), ones(CHUNK, 1.0) {
+    for (auto &slot : slots) {
+      slot.phi.resize(CHUNK);
+      slot.epsilon.resize(CHUNK);
+      slot.text.resize(CHUNK * MAX_ROW);
+    }
+    // The file needs no buffer of its own, buffer is written in one piece
+    file.rdbuf()->pubsetbuf(nullptr, 0);
+    file.open(path, std::ios::binary);
+    if (!file) {
+      failure = "cannot create " + path;
+    }
+  }
+
+  ResultWriter(ResultWriter const &) = delete;
+  ResultWriter &operator=(ResultWriter const &) = delete;
+
+  ~ResultWriter() { finish(); }
+
+  /**
+   * @brief Retrieves the reason of the first failure, empty if none.
+   */
+  std::string const &error() const { return failure; }
+
+  /**
+   * @brief Retrieves the number of bytes written to the file so far.
+   */
+  std::uint64_t bytes_written() const { return written; }
+
+  /**
+   * @brief Writes the model; call once, before write_rows().
+   * @param result The fit; its phi and epsilon values are not used.
+   */
+  void write_header(FitResult const &result) {
+    function = result.function;
+    coefficients = result.coefficients;
+    auto name = result.function.to_string();
+    auto expression = result.function.get_string_function(coefficients);
+    std::string text;
+    switch (format) {
+    case Format::Csv:
+      text += "# function,";
+      append_csv_string(text, name);
+      text += "\n# expression,";
+      append_csv_string(text, expression);
+      text += "\n# coefficients";
+      for (auto coefficient : coefficients) {
+        text += ',';
+        append_number(text, coefficient);
+      }
+      text += "\n# basis,";
+      append_number(text, function.get_shift());
+      text += ',';
+      append_number(text, function.get_scale());
+      text += "\n# pearson_correlation,";
+      append_number(text, result.pearson_correlation);
+      text += "\n# rms,";
+      append_number(text, result.deviation);
+      text += "\n# max_abs_epsilon,";
+      append_number(text, result.max_abs_epsilon);
+      text += "\nx,y,w,phi,epsilon\n";
+      break;
+    case Format::JsonLines:
+      text += "{\"function\":";
+      append_json_string(text, name);
+      text += ",\"expression\":";
+      append_json_string(text, expression);
+      text += ",\"coefficients\":[";
+      for (std::size_t k = 0; k < coefficients.size(); ++k) {
+        text += k == 0 ? "" : ",";
+        append_number(text, coefficients[k]);
+      }
+      text += "],\"basis\":[";
+      append_number(text, function.get_shift());
+      text += ',';
+      append_number(text, function.get_scale());
+      text += "],\"pearson_correlation\":";
+      append_number(text, result.pearson_correlation);
+      text += ",\"rms\":";
+      append_number(text, result.deviation);
+      text += ",\"max_abs_epsilon\":";
+      append_number(text, result.max_abs_epsilon);
+      text += "}\n";
+      break;
+    case Format::Binary:
+      text.append(MAGIC, sizeof MAGIC);
+      append_value<std::uint32_t>(text, 2);
+      append_value<std::uint8_t>(text, function.get_type());
+      append_value<std::int32_t>(
+          text, function.get_type() == Function::Type::Polynomial
+                    ? function.get_m()
+                    : 0);
+      append_value(text, function.get_shift());
+      append_value(text, function.get_scale());
+      append_value<std::uint64_t>(text, coefficients.size());
+      for (auto coefficient : coefficients) {
+        append_value(text, coefficient);
+      }
+      append_value(text, result.pearson_correlation);
+      append_value(text, result.deviation);
+      append_value(text, result.max_abs_epsilon);
+      break;
+    }
+    append(text.data(), text.size());
+  }
+
+  /**
+   * @brief Evaluates the model at count points and writes their rows.
+   * @param x The x-values.
+   * @param y The y-values.
+   * @param w The weights, or nullptr for unit weights.
+   * @param count The number of points.
+   */
+  void write_rows(double const *x, double const *y, double const *w,
+                  std::size_t count) {
+    // Text rows are formatted one chunk per worker, then written in order
+    auto batch = format == Format::Binary ? CHUNK : slots.size() * CHUNK;
+    for (std::size_t begin = 0; begin < count && failure.empty();
+         begin += batch) {
+      auto size = std::min(batch, count - begin);
+      auto chunks = (size + CHUNK - 1) / CHUNK;
+      parallel_for(
+          chunks,
+          [&](std::size_t first, std::size_t last, unsigned) {
+            for (auto c = first; c < last; ++c) {
+              auto offset = begin + c * CHUNK;
+              fill_slot(slots[c], x + offset, y + offset,
+                        w ? w + offset : nullptr,
+                        std::min(CHUNK, count - offset));
+            }
+          },
+          static_cast<unsigned>(chunks));
+      for (std::size_t c = 0; c < chunks; ++c) {
+        append(slots[c].text.data(), slots[c].used);
+      }
+    }
+  }
+
+  /**
+   * @brief Writes a whole fit: the model and every point.
+   * @param result The fit.
+   * @param x The x-values of the data points.
+   * @param y The y-values of the data points.
+   * @param w The weights of the data points (empty for unit weights).
+   * @return False if the file could not be written; error() tells why.
+   */
+  bool write(FitResult const &result, std::vector<double> const &x,
+             std::vector<double> const &y, std::vector<double> const &w) {
+    write_header(result);
+    write_rows(x.data(), y.data(), w.empty() ? nullptr : w.data(), x.size());
+    return finish();
+  }
+
+  /**
+   * @brief Ends the file and writes out the buffer.
+   * @return False if the file could not be written; error() tells why.
+   */
+  bool finish() {
+    if (finished) {
+      return failure.empty();
+    }
+    finished = true;
+    if (format == Format::Binary && failure.empty()) {
+      std::uint64_t end = 0;
+      append(reinterpret_cast<char const *>(&end), sizeof end);
+    }
+    flush();
+    return failure.empty();
+  }
+
+private:
+  /**
+   * @brief The evaluation and output buffers of one chunk of rows.
+   */
+  struct Slot {
+    std::vector<double> phi;     /**< Fitted values of the chunk. */
+    std::vector<double> epsilon; /**< Residuals of the chunk. */
+    std::vector<char> text;      /**< The formatted chunk. */
+    std::size_t used{0};         /**< The filled part of text. */
+  };
+
+  static constexpr char MAGIC[8] = {'L', 'A', 'B', '3', 'C', 'O', 'L', 'S'};
+  static constexpr std::size_t CHUNK = 4096; /**< Rows per slot. */
+  static constexpr std::size_t MAX_ROW = 256; /**< Bytes of a text row. */
+
+  std::ofstream file;       /**< The output file. */
+  Format format;            /**< The output format. */
+  std::vector<char> buffer; /**< Bytes not yet written to file. */
+  std::size_t used{0};      /**< The filled part of buffer. */
+  std::uint64_t written{0}; /**< Bytes written to file. */
+  std::string failure;      /**< The reason of the first failure. */
+  bool finished{false};     /**< Whether finish() was called. */
+  Function function{Function::Type::Polynomial, 1}; /**< The model. */
+  std::vector<double> coefficients; /**< The model coefficients. */
+  std::vector<Slot> slots;          /**< One per worker. */
+  std::vector<double> ones;         /**< Unit weights of one chunk. */
+
+  void flush() {
+    if (used > 0 && failure.empty()) {
+      file.write(buffer.data(), static_cast<std::streamsize>(used));
+      if (!file) {
+        failure = "cannot write the export file";
+      }
+      written += used;
+    }
+    used = 0;
+  }
+
+  void append(char const *data, std::size_t size) {
+    if (used + size > buffer.size()) {
+      flush();
+    }
+    if (size > buffer.size()) {
+      if (failure.empty() &&
+          !file.write(data, static_cast<std::streamsize>(size))) {
+        failure = "cannot write the export file";
+      }
+      written += size;
+      return;
+    }
+    std::memcpy(buffer.data() + used, data, size);
+    used += size;
+  }
+
+  /**
+   * @brief Evaluates the model at the points of one chunk and formats
+   * their rows into slot.text.
+   */
+  void fill_slot(Slot &slot, double const *x, double const *y,
+                 double const *w, std::size_t size) const {
+    for (std::size_t k = 0; k < size; ++k) {
+      slot.phi[k] = ApproximationCalculator::get_function_value(
+          function, coefficients, x[k]);
+      slot.epsilon[k] = y[k] - slot.phi[k];
+    }
+    if (!w) {
+      w = ones.data();
+    }
+    auto *out = slot.text.data();
+    if (format == Format::Binary) {
+      std::uint64_t rows = size;
+      std::memcpy(out, &rows, sizeof rows);
+      out += sizeof rows;
+      double const *columns[] = {x, y, w, slot.phi.data(),
+                                 slot.epsilon.data()};
+      for (auto const *column : columns) {
+        std::memcpy(out, column, size * sizeof(double));
+        out += size * sizeof(double);
+      }
+    } else {
+      auto json = format == Format::JsonLines;
+      for (std::size_t k = 0; k < size; ++k) {
+        out = put_text(out, json ? "{\"x\":" : "");
+        out = put_number(out, x[k]);
+        out = put_text(out, json ? ",\"y\":" : ",");
+        out = put_number(out, y[k]);
+        out = put_text(out, json ? ",\"w\":" : ",");
+        out = put_number(out, w[k]);
+        out = put_text(out, json ? ",\"phi\":" : ",");
+        out = put_number(out, slot.phi[k]);
+        out = put_text(out, json ? ",\"epsilon\":" : ",");
+        out = put_number(out, slot.epsilon[k]);
+        out = put_text(out, json ? "}\n" : "\n");
+      }
+    }
+    slot.used = static_cast<std::size_t>(out - slot.text.data());
+  }
+
+  static char *put_text(char *out, std::string_view text) {
+    std::memcpy(out, text.data(), text.size());
+    return out + text.size();
+  }
+
+  char *put_number(char *out, double value) const {
+    if (!std::isfinite(value) && format == Format::JsonLines) {
+      return put_text(out, "null");
+    }
+    return std::to_chars(out, out + 32, value).ptr;
+  }
+
+  template <typename T> static void append_value(std::string &out, T value) {
+    out.append(reinterpret_cast<char const *>(&value), sizeof value);
+  }
+
+  void append_number(std::string &out, double value) const {
+    if (!std::isfinite(value) && format == Format::JsonLines) {
+      out += "null";
+      return;
+    }
+    char text[32];
+    auto [end, ec] = std::to_chars(text, text + sizeof text, value);
+    out.append(text, end);
+  }
+
+  static void append_csv_string(std::string &out, std::string_view text) {
+    out += '"';
+    for (auto c : text) {
+      out += c;
+      if (c == '"') {
+        out += '"';
+      }
+    }
+    out += '"';
+  }
+
+  static void append_json_string(std::string &out, std::string_view text) {
+    out += '"';
+    for (auto c : text) {
+      if (c == '"' || c == '\\') {
+        out += '\\';
+      }
+      if (static_cast<unsigned char>(c) < 0x20) {
+        out += ' ';
+      } else {
+        out += c;
+      }
+    }
+    out += '"';
+  }
+};
+
+#endif /* E5A9C3F1_4B7D_4E26_9C8A_0D3F6B2E7A94 */
@@ -0,0 +1,200 @@
+#ifndef A3B8E0E6_55F2_4B7B_9D08_2F4C2E6D8E61
+#define A3B8E0E6_55F2_4B7B_9D08_2F4C2E6D8E61
+
+#include "calculator.hpp"
+#include "fit_options.hpp"
+#include "math_function.hpp"
+#include "polynomial_moments.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief The RollingWindowFitter class maintains the best fit over the last W
+ * points of a stream.
+ *
+ * Adding a point updates the sufficient statistics of every candidate in
+ * O(m^2) and evicts the oldest point the same way, and fit() solves each
+ * candidate's normal equations in O(m^3), so the cost per sample does not
+ * depend on W. The candidates are the polynomials of degree 1 to 3 and the
+ * logarithmic function, whose linear-space error follows from the moments;
+ * exponential and power models would need a pass over the window and are not
+ * considered. FitOptions::selection other than InSample ranks the candidates
+ * by generalized cross-validation, RMS / (1 - p / n), the closed-form stand-in
+ * for leave-one-out that only needs the statistics. Robust and nonlinear
+ * options do not apply.
+ *
+ * The moments are taken about the first point of the run they cover, so a
+ * stream far from the origin, such as timestamps, does not cancel in the
+ * power sums; the fit keeps that point as the basis of its coefficients
+ * unless they expand to x well conditioned. A second set of moments starts
+ * at the oldest point of every full window and replaces the first once it
+ * covers exactly the window, which discards the rounding error of the
+ * evictions without an O(W) rebuild.
+ */
+class RollingWindowFitter {
+public:
+  /**
+   * @brief The best fit over the current window.
+   */
+  struct Result {
+    Function function;                /**< The best matching function. */
+    std::vector<double> coefficients; /**< The coefficients of the function. */
+    double deviation;                 /**< The score of the function. */
+  };
+
+private:
+  constexpr static int MAX_DEGREE = 3; /**< The highest polynomial degree. */
+
+  /**
+   * @brief The moments of a run of consecutive points about its first
+   * point, which is also the y-value subtracted from every point.
+   */
+  struct Moments {
+    PolynomialMoments x_moments{MAX_DEGREE}; /**< Moments in x - x_origin. */
+    PolynomialMoments log_moments{1}; /**< Moments in ln x - log_origin. */
+    double x_origin{0.0};   /**< The x-value of the first point. */
+    double log_origin{NAN}; /**< ln x of the first point with x > 0. */
+    double y_origin{0.0};   /**< The y-value of the first point. */
+    std::size_t count{0};   /**< The number of points added. */
+    std::size_t non_positive_x{0}; /**< Points for which ln x is undefined. */
+
+    void add(double x, double y, double w) {
+      if (count++ == 0) {
+        x_origin = x;
+        y_origin = y;
+      }
+      x_moments.add(x - x_origin, y - y_origin, w);
+      if (x > 0.0) {
+        if (std::isnan(log_origin)) {
+          log_origin = std::log(x);
+        }
+        log_moments.add(std::log(x) - log_origin, y - y_origin, w);
+      } else {
+        ++non_positive_x;
+      }
+    }
+
+    void remove(double x, double y, double w) {
+      x_moments.remove(x - x_origin, y - y_origin, w);
+      if (x > 0.0) {
+        log_moments.remove(std::log(x) - log_origin, y - y_origin, w);
+      } else {
+        --non_positive_x;
+      }
+    }
+  };
+
+  std::size_t window;   /**< The maximum number of points in the window. */
+  FitOptions options;   /**< The options used for model selection. */
+  std::deque<std::array<double, 3>> points; /**< The window as (x, y, w). */
+  Moments current; /**< The moments of the window. */
+  Moments next;    /**< The moments of the points since a window was full. */
+
+  double score(double sum_of_squares, int p) const {
+    auto n = static_cast<double>(points.size());
+    auto rms = std::sqrt(sum_of_squares / current.x_moments.weight_sum());
+    if (options.selection == FitOptions::Selection::InSample) {
+      return rms;
+    }
+    return rms / (1.0 - p / n);
+  }
+
+  /**
+   * @brief Retrieves the spread of moments as the scale to solve them in,
+   * or 1 if it is zero or undefined.
+   */
+  static double scale_of(PolynomialMoments const &moments) {
+    auto spread = moments.spread();
+    return spread > 0.0 && std::isfinite(spread) ? spread : 1.0;
+  }
+
+public:
+  /**
+   * @brief Constructs a RollingWindowFitter object.
+   * @param window The number of most recent points to fit.
+   * @param options The options used for model selection.
+   */
+  explicit RollingWindowFitter(std::size_t window,
+                               FitOptions const &options = FitOptions())
+      : window(window), options(options) {}
+
+  /**
+   * @brief Retrieves the number of points in the window.
+   */
+  std::size_t size() const { return points.size(); }
+
+  /**
+   * @brief Adds a point, evicting the oldest one once the window is full.
+   * @param x The x-value of the point.
+   * @param y The y-value of the point.
+   * @param w The weight of the point.
+   */
+  void add(double x, double y, double w = 1.0) {
+    points.push_back({x, y, w});
+    current.add(x, y, w);
+    next.add(x, y, w);
+
+    if (points.size() > window) {
+      auto [old_x, old_y, old_w] = points.front();
+      points.pop_front();
+      current.remove(old_x, old_y, old_w);
+    }
+    if (next.count == window) {
+      current = next;
+      next = Moments();
+    }
+  }
+
+  /**
+   * @brief Finds the best function over the current window.
+   * @return The best fit, or nothing if the window holds too few points to
+   * determine any candidate.
+   */
+  std::optional<Result> fit() const {
+    std::optional<Result> best;
+    auto n = static_cast<int>(points.size());
+    auto consider = [&](Function func, std::vector<double> coefficients,
+                        double deviation) {
+      if (std::isfinite(deviation) && (!best || deviation < best->deviation)) {
+        coefficients[0] += current.y_origin;
+        ApproximationCalculator::expand_if_well_conditioned(func,
+                                                            coefficients);
+        best = Result{func, std::move(coefficients), deviation};
+      }
+    };
+
+    auto const &x_moments = current.x_moments;
+    auto const x_scale = scale_of(x_moments);
+    for (int m = 1; m <= MAX_DEGREE && m + 1 < n; ++m) {
+      auto coefficients = x_moments.solve(m, x_scale);
+      if (!coefficients.empty()) {
+        auto deviation =
+            score(x_moments.sum_of_squares(coefficients, x_scale), m + 1);
+        consider(Function(Function::Type::Polynomial, m)
+                     .in_basis(current.x_origin, x_scale),
+                 std::move(coefficients), deviation);
+      }
+    }
+    if (current.non_positive_x == 0 && n > 2) {
+      auto const &log_moments = current.log_moments;
+      auto const log_scale = scale_of(log_moments);
+      auto coefficients = log_moments.solve(1, log_scale);
+      if (!coefficients.empty()) {
+        auto deviation =
+            score(log_moments.sum_of_squares(coefficients, log_scale), 2);
+        consider(Function(Function::Type::Logarithmic)
+                     .in_basis(current.log_origin, log_scale),
+                 std::move(coefficients), deviation);
+      }
+    }
+    return best;
+  }
+};
+
+#endif /* A3B8E0E6_55F2_4B7B_9D08_2F4C2E6D8E61 */
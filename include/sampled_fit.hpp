@@ -0,0 +1,460 @@
+#ifndef F2D8B4A6_3E1C_4F97_A5B2_8C6E0D4F1B37
+#define F2D8B4A6_3E1C_4F97_A5B2_8C6E0D4F1B37
+
+#include "calculator.hpp"
+#include "counter_random.hpp"
+#include "fit_options.hpp"
+#include "fit_result.hpp"
+#include "math_function.hpp"
+#include "parallel.hpp"
+#include "summation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief The SampledFitter class fits a sample of the data instead of all of
+ * it and estimates how far the result is from the exact fit.
+ *
+ * In-memory data is sampled stratified by x: the x range is cut into STRATA
+ * equal bins and every point is kept with the same probability, decided by
+ * a counter-based hash of its index so that larger samples contain the
+ * smaller ones. Each non-empty bin has a quota of one point: the point of
+ * the bin with the smallest hash is kept even when the draw would keep
+ * none, and it is the first one any larger sample keeps. Each kept point is
+ * weighted by the size of its bin over the number kept from it, so the
+ * weighted least-squares problem of the sample estimates the one of all
+ * points and no bin drops out of it. Streams are sampled by a Reservoir of
+ * fixed size instead.
+ *
+ * The sample is fitted with the usual model selection and fitting paths.
+ * The function selected on the whole sample is refitted on GROUPS disjoint
+ * subsamples; their spread gives standard errors of the coefficients and of
+ * the fitted curve. In-memory samples are doubled until the curve error is
+ * within Budget::tolerance of the RMS error or the time budget is spent.
+ * Optionally one exact pass evaluates the sampled fit on all points.
+ */
+class SampledFitter {
+public:
+  /**
+   * @brief The Budget struct bounds the work of a sampled fit.
+   */
+  struct Budget {
+    std::size_t initial_sample{4096}; /**< Points of the first round. */
+    std::size_t max_sample{1 << 20};  /**< Largest sample. */
+    double tolerance{0.05}; /**< Target curve error relative to the RMS. */
+    double seconds{0.0};    /**< Time for the rounds, zero for no limit. */
+    bool confirm{false};    /**< Evaluate the fit on all points. */
+    std::uint64_t seed{1};  /**< The seed of the sampling. */
+    unsigned workers{0};    /**< Worker threads, zero for all. */
+  };
+
+  /**
+   * @brief The Result struct holds a sampled fit and its error estimates.
+   */
+  struct Result {
+    Function function{Function::Type::Polynomial, 1}; /**< Sample winner. */
+    std::vector<double> coefficients;       /**< Fitted on the sample. */
+    std::vector<double> coefficient_errors; /**< Their standard errors. */
+    std::size_t sample_size{0};             /**< Points in the sample. */
+    std::size_t population{0};              /**< Points sampled from. */
+    int rounds{0};                          /**< Samples fitted. */
+    double deviation{NAN};       /**< The estimated RMS error. */
+    double deviation_error{NAN}; /**< The standard error of deviation. */
+    double curve_error{NAN}; /**< RMS standard error of the fitted values. */
+    bool converged{false};   /**< Whether the tolerance was reached. */
+    bool confirmed{false};   /**< Whether the exact pass was run. */
+    double exact_deviation{NAN};       /**< The RMS error on all points. */
+    double exact_max_abs_epsilon{NAN}; /**< The largest error on all points. */
+
+    /**
+     * @brief Converts the fit into a FitResult without per-point values;
+     * the errors on all points are used when the exact pass ran.
+     */
+    FitResult to_fit_result() const {
+      FitResult result;
+      result.function = function;
+      result.coefficients = coefficients;
+      result.pearson_correlation = NAN;
+      result.deviation = confirmed ? exact_deviation : deviation;
+      result.max_abs_epsilon = exact_max_abs_epsilon;
+      return result;
+    }
+  };
+
+  /**
+   * @brief The Reservoir class keeps a uniform sample of fixed size of a
+   * stream of points (Algorithm R).
+   */
+  class Reservoir {
+  public:
+    /**
+     * @brief Constructs an empty Reservoir object.
+     * @param capacity The sample size.
+     * @param seed The seed of the sampling.
+     */
+    Reservoir(std::size_t capacity, std::uint64_t seed)
+        : capacity(std::max<std::size_t>(1, capacity)), random(seed, 0) {}
+
+    /**
+     * @brief Offers the next point of the stream to the sample.
+     */
+    void add(double x, double y, double w) {
+      if (x_values.size() < capacity) {
+        x_values.push_back(x);
+        y_values.push_back(y);
+        weights.push_back(w);
+      } else if (auto slot = random.below(seen + 1); slot < capacity) {
+        x_values[slot] = x;
+        y_values[slot] = y;
+        weights[slot] = w;
+      }
+      ++seen;
+    }
+
+    /**
+     * @brief Retrieves the number of points offered so far.
+     */
+    std::size_t count() const { return seen; }
+
+  private:
+    friend class SampledFitter;
+
+    std::size_t capacity;         /**< The sample size. */
+    std::size_t seen{0};          /**< Points offered so far. */
+    CounterRandom random;         /**< The replacement draws. */
+    std::vector<double> x_values; /**< The sampled x-values. */
+    std::vector<double> y_values; /**< The sampled y-values. */
+    std::vector<double> weights;  /**< The sampled weights. */
+  };
+
+  /**
+   * @brief The ExactPass class evaluates a sampled fit on every point.
+   */
+  class ExactPass {
+  public:
+    explicit ExactPass(Result const &result)
+        : function(result.function), coefficients(result.coefficients) {}
+
+    void add(double x, double y, double w) {
+      auto epsilon = y - ApproximationCalculator::get_function_value(
+                             function, coefficients, x);
+      squares.add(w * epsilon * epsilon);
+      weights.add(w);
+      max_abs_epsilon = std::max(max_abs_epsilon, std::fabs(epsilon));
+    }
+
+    ExactPass &operator+=(ExactPass const &other) {
+      squares += other.squares;
+      weights += other.weights;
+      max_abs_epsilon = std::max(max_abs_epsilon, other.max_abs_epsilon);
+      return *this;
+    }
+
+    /**
+     * @brief Stores the exact errors in result.
+     */
+    void finish(Result &result) const {
+      result.confirmed = true;
+      result.exact_deviation = std::sqrt(squares.value() / weights.value());
+      result.exact_max_abs_epsilon = max_abs_epsilon;
+    }
+
+  private:
+    Function function;                /**< The sampled fit. */
+    std::vector<double> coefficients; /**< Its coefficients. */
+    KahanSum squares;                 /**< Weighted squared errors. */
+    KahanSum weights;                 /**< The total weight. */
+    double max_abs_epsilon{0.0};      /**< The largest absolute error. */
+  };
+
+  /**
+   * @brief Fits a growing stratified sample of in-memory data.
+   * @param x The x-values of the data points.
+   * @param y The y-values of the data points.
+   * @param w The weights of the data points (empty for unit weights).
+   * @param options The options used for model selection and fitting.
+   * @param budget The bounds of the work.
+   * @return The fit of the last sample with its error estimates.
+   */
+  static Result fit(std::vector<double> const &x, std::vector<double> const &y,
+                    std::vector<double> const &w, FitOptions const &options,
+                    Budget const &budget) {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    Result result;
+    auto n = x.size();
+    result.population = n;
+    if (n == 0) {
+      return result;
+    }
+    auto workers = budget.workers == 0 ? worker_count() : budget.workers;
+
+    auto [low, high] = std::minmax_element(x.begin(), x.end());
+    auto x_low = *low;
+    auto width = (*high - *low) / STRATA;
+    auto stratum_of = [x_low, width](double xi) {
+      auto s = width > 0.0 ? static_cast<int>((xi - x_low) / width) : 0;
+      return std::clamp(s, 0, STRATA - 1);
+    };
+    CounterRandom random(budget.seed, 0);
+    // The size of every bin and the point it keeps first
+    std::vector<std::array<std::size_t, STRATA>> counts(workers);
+    std::vector<std::array<std::size_t, STRATA>> firsts(workers);
+    parallel_for(
+        n,
+        [&](std::size_t begin, std::size_t end, unsigned worker) {
+          auto &first = firsts[worker];
+          for (auto i = begin; i < end; ++i) {
+            auto s = stratum_of(x[i]);
+            if (counts[worker][s]++ == 0 ||
+                random.unit_at(i) < random.unit_at(first[s])) {
+              first[s] = i;
+            }
+          }
+        },
+        workers);
+    std::array<std::size_t, STRATA> population{};
+    std::array<std::size_t, STRATA> first{};
+    for (unsigned k = 0; k < workers; ++k) {
+      for (int s = 0; s < STRATA; ++s) {
+        if (counts[k][s] > 0 &&
+            (population[s] == 0 ||
+             random.unit_at(firsts[k][s]) < random.unit_at(first[s]))) {
+          first[s] = firsts[k][s];
+        }
+        population[s] += counts[k][s];
+      }
+    }
+
+    auto target = std::clamp<std::size_t>(
+        budget.initial_sample, 1, std::max<std::size_t>(1, budget.max_sample));
+    std::vector<std::vector<std::size_t>> picked(workers);
+    std::vector<double> sx;
+    std::vector<double> sy;
+    std::vector<double> sw;
+    while (true) {
+      auto round_start = Clock::now();
+      auto rate = static_cast<double>(target) / static_cast<double>(n);
+      parallel_for(
+          n,
+          [&](std::size_t begin, std::size_t end, unsigned worker) {
+            picked[worker].clear();
+            for (auto i = begin; i < end; ++i) {
+              if (rate >= 1.0 || random.unit_at(i) < rate) {
+                picked[worker].push_back(i);
+              }
+            }
+          },
+          workers);
+
+      std::array<std::size_t, STRATA> sampled{};
+      for (auto const &indices : picked) {
+        for (auto i : indices) {
+          ++sampled[stratum_of(x[i])];
+        }
+      }
+      for (int s = 0; s < STRATA; ++s) {
+        if (sampled[s] == 0 && population[s] > 0) {
+          picked[0].push_back(first[s]);
+          sampled[s] = 1;
+        }
+      }
+      sx.clear();
+      sy.clear();
+      sw.clear();
+      for (auto const &indices : picked) {
+        for (auto i : indices) {
+          auto s = stratum_of(x[i]);
+          sx.push_back(x[i]);
+          sy.push_back(y[i]);
+          sw.push_back(ApproximationCalculator::weight_at(
+                           w, static_cast<int>(i)) *
+                       static_cast<double>(population[s]) /
+                       static_cast<double>(sampled[s]));
+        }
+      }
+
+      fit_sample(sx, sy, sw, options, budget.tolerance, result);
+      result.sample_size = sx.size();
+      ++result.rounds;
+      // A sample of all points has no sampling error
+      result.converged = result.converged || rate >= 1.0;
+
+      std::chrono::duration<double> round = Clock::now() - round_start;
+      std::chrono::duration<double> elapsed = Clock::now() - start;
+      if (result.converged || rate >= 1.0 || target >= budget.max_sample) {
+        break;
+      }
+      // The next round fits twice the points
+      if (budget.seconds > 0.0 &&
+          elapsed.count() + 2.5 * round.count() > budget.seconds) {
+        break;
+      }
+      target = std::min(2 * target, budget.max_sample);
+    }
+
+    if (budget.confirm) {
+      std::vector<ExactPass> passes(workers, ExactPass(result));
+      parallel_for(
+          n,
+          [&](std::size_t begin, std::size_t end, unsigned worker) {
+            for (auto i = begin; i < end; ++i) {
+              passes[worker].add(x[i], y[i],
+                                 ApproximationCalculator::weight_at(
+                                     w, static_cast<int>(i)));
+            }
+          },
+          workers);
+      for (std::size_t k = 1; k < passes.size(); ++k) {
+        passes[0] += passes[k];
+      }
+      passes[0].finish(result);
+    }
+    return result;
+  }
+
+  /**
+   * @brief Fits the sample held by a reservoir.
+   * @param reservoir The sample of a stream.
+   * @param options The options used for model selection and fitting.
+   * @param budget The tolerance that decides Result::converged.
+   * @return The fit of the sample with its error estimates.
+   */
+  static Result fit(Reservoir const &reservoir, FitOptions const &options,
+                    Budget const &budget) {
+    Result result;
+    result.population = reservoir.seen;
+    result.sample_size = reservoir.x_values.size();
+    if (result.sample_size == 0) {
+      return result;
+    }
+    auto scale = static_cast<double>(reservoir.seen) /
+                 static_cast<double>(result.sample_size);
+    auto weights = reservoir.weights;
+    for (auto &weight : weights) {
+      weight *= scale;
+    }
+    fit_sample(reservoir.x_values, reservoir.y_values, weights, options,
+               budget.tolerance, result);
+    result.rounds = 1;
+    return result;
+  }
+
+private:
+  constexpr static int STRATA = 64; /**< Equal-width x bins of a sample. */
+  constexpr static int GROUPS = 4;  /**< Subsamples of the error estimate. */
+
+  /**
+   * @brief Fits a weighted sample, estimates the errors of the fit and
+   * checks them against the tolerance.
+   *
+   * The standard error of the RMS error follows from the spread of the
+   * squared residuals (delta method). Point i belongs to subsample
+   * i % GROUPS; each subsample estimates the coefficients with GROUPS times
+   * the variance of the whole sample.
+   */
+  static void fit_sample(std::vector<double> const &sx,
+                         std::vector<double> const &sy,
+                         std::vector<double> const &sw,
+                         FitOptions const &options, double tolerance,
+                         Result &result) {
+    auto n = static_cast<int>(sx.size());
+    result.function =
+        ApproximationCalculator::find_best_function(n, sx, sy, sw, options);
+    result.coefficients = ApproximationCalculator::approximation_calculation(
+        result.function, n, sx, sy, sw, options);
+
+    auto residuals = ApproximationCalculator::differences_calculation(
+        result.function, n, result.coefficients, sx, sy);
+    KahanSum weight_sum;
+    KahanSum squares;
+    for (int i = 0; i < n; ++i) {
+      weight_sum.add(sw[i]);
+      squares.add(sw[i] * residuals[i] * residuals[i]);
+    }
+    auto mean_square = squares.value() / weight_sum.value();
+    KahanSum spread;
+    for (int i = 0; i < n; ++i) {
+      auto centered = residuals[i] * residuals[i] - mean_square;
+      spread.add(sw[i] * sw[i] * centered * centered);
+    }
+    result.deviation = std::sqrt(mean_square);
+    auto mean_square_error = std::sqrt(spread.value()) / weight_sum.value();
+    result.deviation_error = result.deviation > 0.0
+                                 ? mean_square_error / (2 * result.deviation)
+                                 : 0.0;
+
+    std::vector<std::vector<double>> estimates(GROUPS);
+    parallel_for(
+        GROUPS,
+        [&](std::size_t begin, std::size_t end, unsigned) {
+          for (auto g = begin; g < end; ++g) {
+            std::vector<double> gx;
+            std::vector<double> gy;
+            std::vector<double> gw;
+            for (auto i = static_cast<int>(g); i < n; i += GROUPS) {
+              gx.push_back(sx[i]);
+              gy.push_back(sy[i]);
+              gw.push_back(sw[i]);
+            }
+            auto coefficients =
+                ApproximationCalculator::approximation_in_basis(
+                    result.function, static_cast<int>(gx.size()), gx, gy, gw,
+                    options);
+            if (std::all_of(coefficients.begin(), coefficients.end(),
+                            [](double c) { return std::isfinite(c); })) {
+              estimates[g] = coefficients;
+            }
+          }
+        },
+        GROUPS);
+    estimates.erase(std::remove_if(estimates.begin(), estimates.end(),
+                                   [](auto const &c) { return c.empty(); }),
+                    estimates.end());
+
+    auto p = result.coefficients.size();
+    auto groups = static_cast<double>(estimates.size());
+    result.coefficient_errors.assign(p, NAN);
+    result.curve_error = NAN;
+    result.converged = false;
+    if (estimates.size() < 2) {
+      return;
+    }
+    for (std::size_t k = 0; k < p; ++k) {
+      auto mean = 0.0;
+      for (auto const &c : estimates) {
+        mean += c[k] / groups;
+      }
+      auto variance = 0.0;
+      for (auto const &c : estimates) {
+        variance += (c[k] - mean) * (c[k] - mean) / (groups - 1);
+      }
+      result.coefficient_errors[k] = std::sqrt(variance / groups);
+    }
+    KahanSum curve_variance;
+    for (int i = 0; i < n; ++i) {
+      auto mean = 0.0;
+      auto squares_sum = 0.0;
+      for (auto const &c : estimates) {
+        auto value = ApproximationCalculator::get_function_value(
+            result.function, c, sx[i]);
+        mean += value;
+        squares_sum += value * value;
+      }
+      mean /= groups;
+      auto variance = (squares_sum - groups * mean * mean) / (groups - 1);
+      curve_variance.add(sw[i] * std::max(0.0, variance));
+    }
+    result.curve_error =
+        std::sqrt(curve_variance.value() / weight_sum.value() / groups);
+    result.converged = result.curve_error <= tolerance * result.deviation;
+  }
+};
+
+#endif /* F2D8B4A6_3E1C_4F97_A5B2_8C6E0D4F1B37 */
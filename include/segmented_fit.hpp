@@ -0,0 +1,440 @@
+#ifndef E7B3D9A1_5C2F_4A84_B6E0_1F8D4C7A3E59
+#define E7B3D9A1_5C2F_4A84_B6E0_1F8D4C7A3E59
+
+#include "calculator.hpp"
+#include "cholesky.hpp"
+#include "fit_options.hpp"
+#include "math_function.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+/**
+ * @brief The SegmentedFitter class splits a series into regimes at
+ * automatically chosen breakpoints and selects the best function for each
+ * regime.
+ *
+ * Breakpoints are searched with a polynomial of fixed degree as the model of
+ * every segment. The points are cut into up to Settings::candidates blocks
+ * whose power sums are accumulated in parallel. The sums of a segment
+ * between two block boundaries are running sums of its blocks, so its
+ * least-squares error costs O(1) independently of its length. The errors of
+ * all candidate segments are computed in parallel and optimal partitioning,
+ * a dynamic program over the boundaries, minimizes the total error plus a
+ * penalty per segment (a BIC-like multiple of the noise variance, estimated
+ * from the differences of successive values).
+ *
+ * Every breakpoint is then moved to the best position within one block of
+ * its boundary, alternately for the even and the odd breakpoints so that
+ * the moved ones are independent and can be refined in parallel. Finally
+ * each segment is fitted by ApproximationCalculator with all functions and
+ * the configured options, again in parallel.
+ */
+class SegmentedFitter {
+public:
+  /**
+   * @brief The Settings struct configures the breakpoint search.
+   */
+  struct Settings {
+    int degree{3};                /**< Polynomial degree of the search. */
+    std::size_t candidates{1000}; /**< Blocks the boundaries are taken from. */
+    std::size_t min_points{0}; /**< Shortest segment, zero for automatic. */
+    double penalty{1.0};       /**< Scale of the per-segment penalty. */
+    unsigned workers{0};       /**< Worker threads, zero for all. */
+  };
+
+  /**
+   * @brief One fitted segment of the series.
+   */
+  struct Segment {
+    std::size_t begin;                /**< First point (in x order). */
+    std::size_t end;                  /**< One past the last point. */
+    double x_begin;                   /**< The x-value of the first point. */
+    double x_end;                     /**< The x-value of the last point. */
+    Function function;                /**< The best matching function. */
+    std::vector<double> coefficients; /**< The coefficients of the function. */
+    double deviation;                 /**< The RMS error on the segment. */
+  };
+
+private:
+  constexpr static int MAX_DEGREE = 3; /**< Highest degree of the search. */
+
+  std::vector<double> x; /**< The x-values in ascending order. */
+  std::vector<double> y; /**< The y-values in the order of x. */
+  std::vector<double> w; /**< The weights in the order of x, if any. */
+  FitOptions options;    /**< The options of the per-segment fits. */
+  Settings settings;     /**< The breakpoint search settings. */
+
+  /**
+   * @brief The weighted power sums of a range of normalized points about an
+   * origin.
+   *
+   * Sums about a far origin make the errors of short segments cancel away,
+   * so every range is summed about a point of its own: blocks about their
+   * first point, candidate segments about their first point by shifting the
+   * sums of their blocks.
+   */
+  struct Moments {
+    std::array<long double, 2 * MAX_DEGREE + 1> powers{}; /**< w * u^k. */
+    std::array<long double, MAX_DEGREE + 1> cross{};      /**< w * u^k * v. */
+    long double squares{0.0L};                            /**< w * v^2. */
+
+    /**
+     * @brief Adds a point at distance u from the origin.
+     */
+    void add(double u, double v, double weight) {
+      long double power = weight;
+      for (int k = 0; k <= 2 * MAX_DEGREE; ++k) {
+        powers[k] += power;
+        if (k <= MAX_DEGREE) {
+          cross[k] += power * v;
+        }
+        power *= u;
+      }
+      squares += weight * static_cast<long double>(v) * v;
+    }
+
+    /**
+     * @brief Adds the sums of other, taken about an origin offset before
+     * this one, by the binomial expansion of (u + offset)^k.
+     */
+    void add_shifted(Moments const &other, long double offset) {
+      std::array<long double, 2 * MAX_DEGREE + 1> binomial{};
+      std::array<long double, 2 * MAX_DEGREE + 1> offsets{};
+      offsets[0] = 1.0L;
+      for (int k = 1; k <= 2 * MAX_DEGREE; ++k) {
+        offsets[k] = offsets[k - 1] * offset;
+      }
+      for (int k = 0; k <= 2 * MAX_DEGREE; ++k) {
+        // Row k of Pascal's triangle, updated in place from row k - 1
+        binomial[k] = 1.0L;
+        for (int m = k - 1; m > 0; --m) {
+          binomial[m] += binomial[m - 1];
+        }
+        for (int m = 0; m <= k; ++m) {
+          auto factor = binomial[m] * offsets[k - m];
+          powers[k] += factor * other.powers[m];
+          if (k <= MAX_DEGREE) {
+            cross[k] += factor * other.cross[m];
+          }
+        }
+      }
+      squares += other.squares;
+    }
+  };
+
+  /**
+   * @brief Computes the least-squares error of the best polynomial of the
+   * given degree from the power sums of a segment.
+   *
+   * The powers are scaled by the RMS distance of the points from the origin
+   * so that the normal matrix is well balanced. The error is evaluated as
+   * sum(w * v^2) - 2 * b^T * c + c^T * A * c for the normal equations
+   * A * c = b rather than as sum(w * v^2) - b^T * c, so the error of the
+   * solution c enters only to second order. If A is singular (too few
+   * distinct x-values) the degree is lowered.
+   */
+  static double segment_error(Moments const &moments, int degree) {
+    if (!(moments.powers[0] > 0.0L)) {
+      return 0.0;
+    }
+    auto spread = std::sqrt(moments.powers[2] / moments.powers[0]);
+    auto scale = spread > 0.0L ? 1.0L / spread : 1.0L;
+    std::array<long double, 2 * MAX_DEGREE + 1> powers;
+    std::array<long double, MAX_DEGREE + 1> cross;
+    long double factor = 1.0L;
+    for (int k = 0; k <= 2 * MAX_DEGREE; ++k) {
+      powers[k] = moments.powers[k] * factor;
+      if (k <= MAX_DEGREE) {
+        cross[k] = moments.cross[k] * factor;
+      }
+      factor *= scale;
+    }
+
+    std::array<double, (MAX_DEGREE + 1) * (MAX_DEGREE + 1)> matrix;
+    std::array<double, MAX_DEGREE + 1> c;
+    for (auto p = degree + 1; p > 0; --p) {
+      for (int i = 0; i < p; ++i) {
+        for (int j = 0; j < p; ++j) {
+          matrix[i * p + j] = static_cast<double>(powers[i + j]);
+        }
+        c[i] = static_cast<double>(cross[i]);
+      }
+      CholeskyDecomposition cholesky(p, matrix.data());
+      if (!cholesky.is_positive_definite()) {
+        continue;
+      }
+      cholesky.solve_in_place(c.data());
+      auto error = moments.squares;
+      for (int i = 0; i < p; ++i) {
+        long double row = -2.0L * cross[i];
+        for (int j = 0; j < p; ++j) {
+          row += powers[i + j] * c[j];
+        }
+        error += c[i] * row;
+      }
+      return std::max(0.0, static_cast<double>(error));
+    }
+    return 0.0;
+  }
+
+  double weight(std::size_t i) const { return w.empty() ? 1.0 : w[i]; }
+
+  int degree() const { return std::clamp(settings.degree, 0, MAX_DEGREE); }
+
+  /**
+   * @brief Estimates the noise variance of the normalized y-values from the
+   * median absolute difference of successive values.
+   */
+  static double noise_variance(std::vector<double> const &v) {
+    if (v.size() < 2) {
+      return 0.0;
+    }
+    std::vector<double> differences(v.size() - 1);
+    for (std::size_t i = 0; i + 1 < v.size(); ++i) {
+      differences[i] = std::fabs(v[i + 1] - v[i]);
+    }
+    auto middle = differences.begin() + differences.size() / 2;
+    std::nth_element(differences.begin(), middle, differences.end());
+    // For Gaussian noise MAD * 1.4826 estimates sigma; a difference has
+    // twice the variance of a value
+    auto sigma = 1.4826 * *middle / std::sqrt(2.0);
+    return sigma * sigma;
+  }
+
+  /**
+   * @brief Moves breakpoint k of cuts to the position within reach of its
+   * current one that minimizes the error of its two segments.
+   *
+   * The errors of the left segments are collected by a forward scan summing
+   * about its first point, those of the right segments by a backward scan
+   * summing about its last point.
+   */
+  void refine_breakpoint(std::vector<std::size_t> &cuts, std::size_t k,
+                         std::vector<double> const &u,
+                         std::vector<double> const &v, std::size_t reach,
+                         std::size_t min_points) const {
+    auto a = cuts[k - 1];
+    auto c = cuts[k + 1];
+    auto low = std::max(a + min_points, cuts[k] > reach ? cuts[k] - reach : 0);
+    auto high = std::min(c - min_points, cuts[k] + reach);
+    if (low > high) {
+      return;
+    }
+    std::vector<double> errors(high - low + 1, 0.0);
+    Moments left;
+    for (auto i = a; i <= high; ++i) {
+      if (i >= low) {
+        errors[i - low] += segment_error(left, degree());
+      }
+      left.add(u[i] - u[a], v[i], weight(i));
+    }
+    Moments right;
+    for (auto i = c; i-- > low;) {
+      right.add(u[i] - u[c - 1], v[i], weight(i));
+      if (i <= high) {
+        errors[i - low] += segment_error(right, degree());
+      }
+    }
+    auto best = std::min_element(errors.begin(), errors.end());
+    cuts[k] = low + static_cast<std::size_t>(best - errors.begin());
+  }
+
+  /**
+   * @brief Finds the segment boundaries as point indices, including 0 and n.
+   */
+  std::vector<std::size_t> find_breakpoints() const {
+    auto n = x.size();
+    auto degree = this->degree();
+    auto min_points = settings.min_points > 0
+                          ? settings.min_points
+                          : static_cast<std::size_t>(4 * (degree + 1));
+    auto blocks = std::clamp<std::size_t>(settings.candidates, 1, n);
+    auto workers = settings.workers == 0 ? worker_count() : settings.workers;
+
+    // Normalized coordinates keep the power sums well scaled
+    auto x_map = ApproximationCalculator::AffineMap::onto_unit_interval(
+        x, static_cast<int>(n));
+    auto y_map = ApproximationCalculator::AffineMap::onto_unit_interval(
+        y, static_cast<int>(n));
+    std::vector<double> u(n);
+    std::vector<double> v(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      u[i] = x_map(x[i]);
+      v[i] = y_map(y[i]);
+    }
+
+    std::vector<std::size_t> boundary(blocks + 1);
+    for (std::size_t b = 0; b <= blocks; ++b) {
+      boundary[b] = b * n / blocks;
+    }
+    std::vector<Moments> block_moments(blocks);
+    parallel_for(
+        blocks,
+        [&](std::size_t begin, std::size_t end, unsigned) {
+          for (auto b = begin; b < end; ++b) {
+            auto origin = u[boundary[b]];
+            for (auto i = boundary[b]; i < boundary[b + 1]; ++i) {
+              block_moments[b].add(u[i] - origin, v[i], weight(i));
+            }
+          }
+        },
+        workers);
+
+    // The errors of all candidate segments. Row i extends the sums of
+    // segment [i, j) by one block per step, so each segment costs O(1);
+    // rows are interleaved over the workers because row i holds blocks - i
+    // segments.
+    auto stride = blocks + 1;
+    std::vector<double> errors(stride * stride, 0.0);
+    auto rows = std::min<std::size_t>(workers, blocks);
+    parallel_for(
+        rows,
+        [&](std::size_t begin, std::size_t end, unsigned) {
+          for (auto first = begin; first < end; ++first) {
+            for (auto i = first; i < blocks; i += rows) {
+              Moments segment;
+              auto origin = u[boundary[i]];
+              for (auto j = i + 1; j <= blocks; ++j) {
+                segment.add_shifted(block_moments[j - 1],
+                                    u[boundary[j - 1]] - origin);
+                errors[i * stride + j] = segment_error(segment, degree);
+              }
+            }
+          }
+        },
+        workers);
+
+    // Optimal partitioning: best[j] is the cost of segmenting blocks [0, j)
+    auto penalty = settings.penalty * (degree + 2) *
+                   std::max(noise_variance(v), 1e-12) *
+                   std::log(static_cast<double>(n));
+    std::vector<double> best(blocks + 1,
+                             std::numeric_limits<double>::infinity());
+    std::vector<std::size_t> previous(blocks + 1, 0);
+    best[0] = 0.0;
+    for (std::size_t j = 1; j <= blocks; ++j) {
+      for (std::size_t i = 0; i < j; ++i) {
+        if (boundary[j] - boundary[i] < min_points && (i > 0 || j < blocks)) {
+          continue;
+        }
+        auto cost = best[i] + errors[i * stride + j] + penalty;
+        if (cost < best[j]) {
+          best[j] = cost;
+          previous[j] = i;
+        }
+      }
+    }
+    std::vector<std::size_t> cuts;
+    for (auto j = blocks; j > 0; j = previous[j]) {
+      cuts.push_back(boundary[j]);
+    }
+    cuts.push_back(0);
+    std::reverse(cuts.begin(), cuts.end());
+
+    // Block boundaries are only candidates; refine within one block
+    auto reach = (n + blocks - 1) / blocks;
+    if (reach > 1 && cuts.size() > 2) {
+      for (std::size_t parity = 1; parity <= 2; ++parity) {
+        std::vector<std::size_t> movable;
+        for (auto k = parity; k + 1 < cuts.size(); k += 2) {
+          movable.push_back(k);
+        }
+        parallel_for(
+            movable.size(),
+            [&](std::size_t begin, std::size_t end, unsigned) {
+              for (auto m = begin; m < end; ++m) {
+                refine_breakpoint(cuts, movable[m], u, v, reach, min_points);
+              }
+            },
+            workers);
+      }
+    }
+    return cuts;
+  }
+
+public:
+  /**
+   * @brief Constructs a SegmentedFitter object.
+   * @param x The x-values of the data points, in any order.
+   * @param y The y-values of the data points.
+   * @param w The weights of the data points (empty for unit weights).
+   * @param options The options used when fitting each segment.
+   * @param settings The breakpoint search settings.
+   */
+  SegmentedFitter(std::vector<double> const &x, std::vector<double> const &y,
+                  std::vector<double> const &w,
+                  FitOptions const &options, Settings const &settings)
+      : options(options), settings(settings) {
+    std::vector<std::size_t> order(x.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    if (!std::is_sorted(x.begin(), x.end())) {
+      std::stable_sort(order.begin(), order.end(),
+                       [&x](auto a, auto b) { return x[a] < x[b]; });
+    }
+    this->x.reserve(x.size());
+    this->y.reserve(x.size());
+    for (auto i : order) {
+      this->x.push_back(x[i]);
+      this->y.push_back(y[i]);
+      if (!w.empty()) {
+        this->w.push_back(w[i]);
+      }
+    }
+  }
+
+  /**
+   * @brief Finds the breakpoints and fits every segment.
+   * @return The segments in ascending order of x.
+   */
+  std::vector<Segment> fit() const {
+    if (x.empty()) {
+      return {};
+    }
+    auto cuts = find_breakpoints();
+    std::vector<Segment> segments(cuts.size() - 1,
+                                  {0, 0, 0.0, 0.0,
+                                   Function(Function::Type::Polynomial, 1),
+                                   {}, 0.0});
+    parallel_for(
+        segments.size(),
+        [&](std::size_t begin, std::size_t end, unsigned) {
+          for (auto s = begin; s < end; ++s) {
+            auto &segment = segments[s];
+            segment.begin = cuts[s];
+            segment.end = cuts[s + 1];
+            segment.x_begin = x[segment.begin];
+            segment.x_end = x[segment.end - 1];
+            std::vector<double> sx(x.begin() + segment.begin,
+                                   x.begin() + segment.end);
+            std::vector<double> sy(y.begin() + segment.begin,
+                                   y.begin() + segment.end);
+            std::vector<double> sw;
+            if (!w.empty()) {
+              sw.assign(w.begin() + segment.begin, w.begin() + segment.end);
+            }
+            auto n = static_cast<int>(sx.size());
+            segment.function = ApproximationCalculator::find_best_function(
+                n, sx, sy, sw, options);
+            segment.coefficients =
+                ApproximationCalculator::approximation_calculation(
+                    segment.function, n, sx, sy, sw, options);
+            segment.deviation =
+                ApproximationCalculator::standard_deviation_calculation(
+                    ApproximationCalculator::differences_calculation(
+                        segment.function, n, segment.coefficients, sx, sy),
+                    n, sw, options.precision);
+          }
+        },
+        settings.workers);
+    return segments;
+  }
+};
+
+#endif /* E7B3D9A1_5C2F_4A84_B6E0_1F8D4C7A3E59 */
@@ -0,0 +1,69 @@
+#ifndef C6D2E8A4_1B9F_4F73_A5C1_9E3B7D5F2A08
+#define C6D2E8A4_1B9F_4F73_A5C1_9E3B7D5F2A08
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The StartupProfile class records when the milestones of the
+ * application startup are reached, in milliseconds since its construction
+ * at the top of main().
+ *
+ * The window marks "first paint" when it is first painted and
+ * "interactive" when the event loop is next idle, i.e. when input is
+ * handled; the deferred graph marks "plot created" and "plot ready".
+ */
+class StartupProfile {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Records a milestone; later marks of the same name are ignored.
+   */
+  void mark(std::string const &name) {
+    if (std::isnan(elapsed(name))) {
+      std::chrono::duration<double, std::milli> since = Clock::now() - start;
+      milestones.emplace_back(name, since.count());
+    }
+  }
+
+  /**
+   * @brief Retrieves the time of a milestone in milliseconds, or NAN if it
+   * was not reached.
+   */
+  double elapsed(std::string const &name) const {
+    for (auto const &[milestone, time] : milestones) {
+      if (milestone == name) {
+        return time;
+      }
+    }
+    return NAN;
+  }
+
+  /**
+   * @brief Prints one "milestone  time ms" line per milestone in the order
+   * they were reached.
+   */
+  void report(std::ostream &os) const {
+    auto flags = os.flags();
+    auto precision = os.precision();
+    for (auto const &[milestone, time] : milestones) {
+      os << std::left << std::setw(22) << milestone << std::right
+         << std::fixed << std::setprecision(1) << std::setw(10) << time
+         << " ms\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+private:
+  Clock::time_point start{Clock::now()}; /**< The origin of the times. */
+  std::vector<std::pair<std::string, double>> milestones; /**< In order. */
+};
+
+#endif /* C6D2E8A4_1B9F_4F73_A5C1_9E3B7D5F2A08 */
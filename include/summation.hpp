@@ -0,0 +1,127 @@
+#ifndef F4C7A2E9_8B1D_4E36_9A5C_2D7E0B6F1A83
+#define F4C7A2E9_8B1D_4E36_9A5C_2D7E0B6F1A83
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @brief The PlainSum struct accumulates values in a single double.
+ *
+ * All accumulators share the interface add(), value(), +=, -= so that the
+ * numeric kernels can be instantiated with any of them. PlainSum compiles
+ * to the bare additions of the original code.
+ */
+struct PlainSum {
+  double sum{0.0}; /**< The running sum. */
+
+  void add(double value) { sum += value; }
+  double value() const { return sum; }
+
+  PlainSum &operator+=(PlainSum const &other) {
+    sum += other.sum;
+    return *this;
+  }
+
+  PlainSum &operator-=(PlainSum const &other) {
+    sum -= other.sum;
+    return *this;
+  }
+};
+
+/**
+ * @brief The KahanSum struct accumulates values with Kahan-Babuska
+ * (Neumaier) compensation.
+ *
+ * The rounding error of every addition is collected in a second double, so
+ * the error of the sum does not grow with the number of values. It costs
+ * about four times the operations of a plain sum.
+ */
+struct KahanSum {
+  double sum{0.0};          /**< The running sum. */
+  double compensation{0.0}; /**< The accumulated rounding errors. */
+
+  void add(double value) {
+    auto total = sum + value;
+    if (std::fabs(sum) >= std::fabs(value)) {
+      compensation += (sum - total) + value;
+    } else {
+      compensation += (value - total) + sum;
+    }
+    sum = total;
+  }
+
+  double value() const { return sum + compensation; }
+
+  KahanSum &operator+=(KahanSum const &other) {
+    add(other.sum);
+    compensation += other.compensation;
+    return *this;
+  }
+
+  KahanSum &operator-=(KahanSum const &other) {
+    add(-other.sum);
+    compensation -= other.compensation;
+    return *this;
+  }
+};
+
+/**
+ * @brief The PairwiseSum class accumulates a stream of values by pairwise
+ * (cascade) summation.
+ *
+ * Values are summed plainly in blocks of BLOCK; the block sums are combined
+ * like a binary counter, so sums of equal numbers of blocks are always added
+ * to each other. The error grows with log(n) instead of n at little more
+ * than the cost of a plain sum. Merged accumulators enter as single values.
+ */
+class PairwiseSum {
+private:
+  constexpr static int BLOCK = 32; /**< Values summed plainly per block. */
+
+  double block{0.0};                 /**< The sum of the current block. */
+  int block_size{0};                 /**< Values in the current block. */
+  std::uint64_t blocks{0};           /**< Completed blocks as a counter. */
+  std::array<double, 64> partials{}; /**< Sums of 2^level blocks. */
+
+  void carry(double sum) {
+    int level = 0;
+    for (; (blocks >> level) & 1U; ++level) {
+      sum += partials[level];
+    }
+    partials[level] = sum;
+    ++blocks;
+  }
+
+public:
+  void add(double value) {
+    block += value;
+    if (++block_size == BLOCK) {
+      carry(block);
+      block = 0.0;
+      block_size = 0;
+    }
+  }
+
+  double value() const {
+    auto sum = block;
+    for (int level = 0; level < 64; ++level) {
+      if ((blocks >> level) & 1U) {
+        sum += partials[level];
+      }
+    }
+    return sum;
+  }
+
+  PairwiseSum &operator+=(PairwiseSum const &other) {
+    add(other.value());
+    return *this;
+  }
+
+  PairwiseSum &operator-=(PairwiseSum const &other) {
+    add(-other.value());
+    return *this;
+  }
+};
+
+#endif /* F4C7A2E9_8B1D_4E36_9A5C_2D7E0B6F1A83 */
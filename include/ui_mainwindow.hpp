@@ -10,11 +10,13 @@
 #define DESIGNERJRCBDP_H
 
 #include <QtCore/QVariant>
-#include <QtWebEngineWidgets/QWebEngineView>
 #include <QtWidgets/QAction>
 #include <QtWidgets/QApplication>
+#include <QtWidgets/QCheckBox>
+#include <QtWidgets/QDoubleSpinBox>
 #include <QtWidgets/QFrame>
 #include <QtWidgets/QGridLayout>
+#include <QtWidgets/QHBoxLayout>
 #include <QtWidgets/QHeaderView>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QMainWindow>
@@ -38,7 +40,9 @@ public:
   QFrame *frame_3;
   QVBoxLayout *verticalLayout_4;
   QLabel *label_3;
-  QWebEngineView *webview;
+  QWidget *plot_host;
+  QVBoxLayout *plot_layout;
+  QLabel *plot_placeholder;
   QFrame *frame_2;
   QVBoxLayout *verticalLayout_3;
   QLabel *label_2;
@@ -52,6 +56,16 @@ public:
   QPushButton *browse_btn;
   QPushButton *load_btn;
   QPushButton *calc_button;
+  QFrame *approx_frame;
+  QHBoxLayout *horizontalLayout;
+  QCheckBox *approx_check;
+  QLabel *time_budget_label;
+  QDoubleSpinBox *time_budget_spin;
+  QLabel *tolerance_label;
+  QDoubleSpinBox *tolerance_spin;
+  QCheckBox *confirm_check;
+  QPushButton *export_btn;
+  QCheckBox *live_check;
   QStatusBar *statusbar;
 
   void setupUi(QMainWindow *MainWindow) {
@@ -160,12 +174,19 @@ public:
 
     verticalLayout_4->addWidget(label_3);
 
-    webview = new QWebEngineView(frame_3);
-    webview->setObjectName(QString::fromUtf8("webview"));
-    webview->setMinimumSize(QSize(700, 643));
-    webview->setUrl(QUrl(QString::fromUtf8("about:blank")));
+    plot_host = new QWidget(frame_3);
+    plot_host->setObjectName(QString::fromUtf8("plot_host"));
+    plot_host->setMinimumSize(QSize(700, 643));
+    plot_layout = new QVBoxLayout(plot_host);
+    plot_layout->setObjectName(QString::fromUtf8("plot_layout"));
+    plot_layout->setContentsMargins(0, 0, 0, 0);
+    plot_placeholder = new QLabel(plot_host);
+    plot_placeholder->setObjectName(QString::fromUtf8("plot_placeholder"));
+    plot_placeholder->setAlignment(Qt::AlignCenter);
 
-    verticalLayout_4->addWidget(webview);
+    plot_layout->addWidget(plot_placeholder);
+
+    verticalLayout_4->addWidget(plot_host);
 
     gridLayout->addWidget(frame_3, 0, 1, 2, 1);
 
@@ -184,8 +205,8 @@ public:
     verticalLayout_3->addWidget(label_2);
 
     point_table = new QTableWidget(frame_2);
-    if (point_table->columnCount() < 2)
-      point_table->setColumnCount(2);
+    if (point_table->columnCount() < 3)
+      point_table->setColumnCount(3);
     QFont font1;
     font1.setBold(true);
     font1.setItalic(false);
@@ -201,6 +222,9 @@ public:
     QTableWidgetItem *__qtablewidgetitem1 = new QTableWidgetItem();
     __qtablewidgetitem1->setFont(font2);
     point_table->setHorizontalHeaderItem(1, __qtablewidgetitem1);
+    QTableWidgetItem *__qtablewidgetitem2 = new QTableWidgetItem();
+    __qtablewidgetitem2->setFont(font2);
+    point_table->setHorizontalHeaderItem(2, __qtablewidgetitem2);
     point_table->setObjectName(QString::fromUtf8("point_table"));
     point_table->setFrameShape(QFrame::StyledPanel);
     point_table->setFrameShadow(QFrame::Sunken);
@@ -219,7 +243,7 @@ public:
     point_table->horizontalHeader()->setVisible(true);
     point_table->horizontalHeader()->setCascadingSectionResizes(false);
     point_table->horizontalHeader()->setMinimumSectionSize(20);
-    point_table->horizontalHeader()->setDefaultSectionSize(110);
+    point_table->horizontalHeader()->setDefaultSectionSize(70);
     point_table->horizontalHeader()->setHighlightSections(false);
     point_table->horizontalHeader()->setProperty("showSortIndicator",
                                                  QVariant(false));
@@ -286,6 +310,63 @@ public:
 
     gridLayout->addWidget(calc_button, 5, 0, 1, 3);
 
+    approx_frame = new QFrame(centralwidget);
+    approx_frame->setObjectName(QString::fromUtf8("approx_frame"));
+    approx_frame->setFrameShape(QFrame::StyledPanel);
+    approx_frame->setFrameShadow(QFrame::Raised);
+    horizontalLayout = new QHBoxLayout(approx_frame);
+    horizontalLayout->setObjectName(QString::fromUtf8("horizontalLayout"));
+    approx_check = new QCheckBox(approx_frame);
+    approx_check->setObjectName(QString::fromUtf8("approx_check"));
+
+    horizontalLayout->addWidget(approx_check);
+
+    time_budget_label = new QLabel(approx_frame);
+    time_budget_label->setObjectName(QString::fromUtf8("time_budget_label"));
+
+    horizontalLayout->addWidget(time_budget_label);
+
+    time_budget_spin = new QDoubleSpinBox(approx_frame);
+    time_budget_spin->setObjectName(QString::fromUtf8("time_budget_spin"));
+    time_budget_spin->setDecimals(1);
+    time_budget_spin->setMaximum(600.000000000000000);
+    time_budget_spin->setSingleStep(0.500000000000000);
+    time_budget_spin->setValue(1.000000000000000);
+
+    horizontalLayout->addWidget(time_budget_spin);
+
+    tolerance_label = new QLabel(approx_frame);
+    tolerance_label->setObjectName(QString::fromUtf8("tolerance_label"));
+
+    horizontalLayout->addWidget(tolerance_label);
+
+    tolerance_spin = new QDoubleSpinBox(approx_frame);
+    tolerance_spin->setObjectName(QString::fromUtf8("tolerance_spin"));
+    tolerance_spin->setDecimals(3);
+    tolerance_spin->setMinimum(0.001000000000000);
+    tolerance_spin->setMaximum(1.000000000000000);
+    tolerance_spin->setSingleStep(0.010000000000000);
+    tolerance_spin->setValue(0.050000000000000);
+
+    horizontalLayout->addWidget(tolerance_spin);
+
+    confirm_check = new QCheckBox(approx_frame);
+    confirm_check->setObjectName(QString::fromUtf8("confirm_check"));
+
+    horizontalLayout->addWidget(confirm_check);
+
+    gridLayout->addWidget(approx_frame, 6, 0, 1, 3);
+
+    export_btn = new QPushButton(centralwidget);
+    export_btn->setObjectName(QString::fromUtf8("export_btn"));
+
+    gridLayout->addWidget(export_btn, 7, 0, 1, 3);
+
+    live_check = new QCheckBox(centralwidget);
+    live_check->setObjectName(QString::fromUtf8("live_check"));
+
+    gridLayout->addWidget(live_check, 8, 0, 1, 3);
+
     MainWindow->setCentralWidget(centralwidget);
     statusbar = new QStatusBar(MainWindow);
     statusbar->setObjectName(QString::fromUtf8("statusbar"));
@@ -307,6 +388,8 @@ public:
         QCoreApplication::translate("MainWindow", "Description", nullptr));
     label_3->setText(QCoreApplication::translate(
         "MainWindow", "Graphical representation", nullptr));
+    plot_placeholder->setText(QCoreApplication::translate(
+        "MainWindow", "Loading the graph...", nullptr));
     label_2->setText(
         QCoreApplication::translate("MainWindow", "Points input", nullptr));
     QTableWidgetItem *___qtablewidgetitem =
@@ -317,6 +400,10 @@ public:
         point_table->horizontalHeaderItem(1);
     ___qtablewidgetitem1->setText(
         QCoreApplication::translate("MainWindow", "Y", nullptr));
+    QTableWidgetItem *___qtablewidgetitem2 =
+        point_table->horizontalHeaderItem(2);
+    ___qtablewidgetitem2->setText(
+        QCoreApplication::translate("MainWindow", "W", nullptr));
     add_btn->setText(
         QCoreApplication::translate("MainWindow", "Add point", nullptr));
     clear_btn->setText(
@@ -329,6 +416,18 @@ public:
         QCoreApplication::translate("MainWindow", "Load", nullptr));
     calc_button->setText(
         QCoreApplication::translate("MainWindow", "Calculate", nullptr));
+    approx_check->setText(QCoreApplication::translate(
+        "MainWindow", "Approximate fit on a sample", nullptr));
+    time_budget_label->setText(
+        QCoreApplication::translate("MainWindow", "Time budget, s", nullptr));
+    tolerance_label->setText(
+        QCoreApplication::translate("MainWindow", "Tolerance", nullptr));
+    confirm_check->setText(QCoreApplication::translate(
+        "MainWindow", "Confirm with an exact pass", nullptr));
+    export_btn->setText(
+        QCoreApplication::translate("MainWindow", "Export results...", nullptr));
+    live_check->setText(QCoreApplication::translate(
+        "MainWindow", "Recalculate while editing", nullptr));
   } // retranslateUi
 };
 
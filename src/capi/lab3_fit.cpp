@@ -0,0 +1,296 @@
+#include "lab3_fit.h"
+#include "fit_engine.hpp"
+
+#include <climits>
+#include <cmath>
+#include <exception>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef LAB3_FIT_VERSION
+#define LAB3_FIT_VERSION "0.1"
+#endif
+
+struct lab3_fit {
+  FitEngine engine;                            /**< Options and buffers. */
+  std::vector<FitEngine::Series> batch_series; /**< Of lab3_fit_batch. */
+  std::vector<FitEngine::Summary> batch;       /**< Its summaries. */
+  std::string error;                           /**< The last failure. */
+};
+
+namespace {
+
+FitEngine::Series to_series(lab3_series const &series) {
+  return {series.x, series.y, series.w, series.n};
+}
+
+bool to_function(int type, int degree, Function &func) {
+  if (type == LAB3_POLYNOMIAL && degree >= 1 &&
+      degree < FitEngine::MAX_COEFFICIENTS) {
+    func = Function(Function::Type::Polynomial, degree);
+    return true;
+  }
+  if (type == LAB3_EXPONENTIAL || type == LAB3_LOGARITHMIC ||
+      type == LAB3_POWER) {
+    func = Function(static_cast<Function::Type>(type));
+    return true;
+  }
+  return false;
+}
+
+void to_result(FitEngine::Summary const &summary, lab3_fit_result &result) {
+  auto type = summary.function.get_type();
+  result.type = static_cast<int>(type);
+  result.degree =
+      type == Function::Type::Polynomial ? summary.function.get_m() : 0;
+  result.coefficient_count = summary.coefficient_count;
+  for (int k = 0; k < LAB3_FIT_MAX_COEFFICIENTS; ++k) {
+    result.coefficients[k] = summary.coefficients[k];
+  }
+  result.shift = summary.function.get_shift();
+  result.scale = summary.function.get_scale();
+  result.pearson_correlation = summary.pearson_correlation;
+  result.deviation = summary.deviation;
+  result.max_abs_epsilon = summary.max_abs_epsilon;
+}
+
+bool is_integer_option(lab3_option option) {
+  return option == LAB3_OPTION_MAX_REFINEMENT_ITERATIONS ||
+         option == LAB3_OPTION_ROBUST_LOSS ||
+         option == LAB3_OPTION_MAX_ROBUST_ITERATIONS ||
+         option == LAB3_OPTION_SELECTION || option == LAB3_OPTION_CV_FOLDS ||
+         option == LAB3_OPTION_PRECISION || option == LAB3_OPTION_WORKERS;
+}
+
+lab3_status fail(lab3_fit *fit, lab3_status status, std::string message) {
+  if (fit) {
+    fit->error = std::move(message);
+  }
+  return status;
+}
+
+/**
+ * @brief Runs body, turning exceptions into statuses so that none crosses
+ * the C interface.
+ */
+template <typename Body> lab3_status guarded(lab3_fit *fit, Body &&body) {
+  try {
+    fit->error.clear();
+    return body();
+  } catch (std::bad_alloc const &) {
+    return fail(fit, LAB3_OUT_OF_MEMORY, "out of memory");
+  } catch (std::exception const &e) {
+    return fail(fit, LAB3_INTERNAL_ERROR, e.what());
+  } catch (...) {
+    return fail(fit, LAB3_INTERNAL_ERROR, "unknown error");
+  }
+}
+
+} // namespace
+
+static_assert(FitEngine::MAX_COEFFICIENTS == LAB3_FIT_MAX_COEFFICIENTS,
+              "the C result must hold every coefficient");
+
+extern "C" {
+
+const char *lab3_fit_version(void) { return LAB3_FIT_VERSION; }
+
+const char *lab3_status_string(lab3_status status) {
+  switch (status) {
+  case LAB3_OK:
+    return "ok";
+  case LAB3_INVALID_ARGUMENT:
+    return "invalid argument";
+  case LAB3_OUT_OF_MEMORY:
+    return "out of memory";
+  case LAB3_INTERNAL_ERROR:
+    return "internal error";
+  }
+  return "unknown status";
+}
+
+lab3_fit *lab3_fit_create(void) { return new (std::nothrow) lab3_fit(); }
+
+void lab3_fit_destroy(lab3_fit *fit) { delete fit; }
+
+lab3_status lab3_fit_set_option(lab3_fit *fit, lab3_option option,
+                                double value) {
+  if (!fit) {
+    return LAB3_INVALID_ARGUMENT;
+  }
+  if (!std::isfinite(value) || value < 0.0) {
+    return fail(fit, LAB3_INVALID_ARGUMENT, "option values must be finite "
+                                            "and non-negative");
+  }
+  if (is_integer_option(option) &&
+      (value > INT_MAX || value != std::floor(value))) {
+    return fail(fit, LAB3_INVALID_ARGUMENT,
+                "this option takes an integer of at most INT_MAX");
+  }
+  auto &options = fit->engine.get_options();
+  auto integer = is_integer_option(option) ? static_cast<int>(value) : 0;
+  switch (option) {
+  case LAB3_OPTION_NONLINEAR_REFINEMENT:
+    options.nonlinear_refinement = value != 0.0;
+    break;
+  case LAB3_OPTION_MAX_REFINEMENT_ITERATIONS:
+    options.max_refinement_iterations = integer;
+    break;
+  case LAB3_OPTION_ROBUST_LOSS:
+    if (integer > static_cast<int>(FitOptions::RobustLoss::Tukey)) {
+      return fail(fit, LAB3_INVALID_ARGUMENT, "unknown robust loss");
+    }
+    options.robust_loss = static_cast<FitOptions::RobustLoss>(integer);
+    break;
+  case LAB3_OPTION_ROBUST_TUNING:
+    options.robust_tuning = value;
+    break;
+  case LAB3_OPTION_MAX_ROBUST_ITERATIONS:
+    options.max_robust_iterations = integer;
+    break;
+  case LAB3_OPTION_SELECTION:
+    if (integer > static_cast<int>(FitOptions::Selection::KFold)) {
+      return fail(fit, LAB3_INVALID_ARGUMENT, "unknown selection");
+    }
+    options.selection = static_cast<FitOptions::Selection>(integer);
+    break;
+  case LAB3_OPTION_CV_FOLDS:
+    if (integer < 2) {
+      return fail(fit, LAB3_INVALID_ARGUMENT, "at least 2 folds are needed");
+    }
+    options.cv_folds = integer;
+    break;
+  case LAB3_OPTION_PRECISION:
+    if (integer > static_cast<int>(FitOptions::Precision::Pairwise)) {
+      return fail(fit, LAB3_INVALID_ARGUMENT, "unknown precision");
+    }
+    if (integer == static_cast<int>(FitOptions::Precision::Float)) {
+      return fail(fit, LAB3_INVALID_ARGUMENT,
+                  "float precision is only used by multivariate regression");
+    }
+    options.precision = static_cast<FitOptions::Precision>(integer);
+    break;
+  case LAB3_OPTION_NORMALIZE_DATA:
+    options.normalize_data = value != 0.0;
+    break;
+  case LAB3_OPTION_WORKERS:
+    fit->engine.set_workers(static_cast<unsigned>(integer));
+    break;
+  default:
+    return fail(fit, LAB3_INVALID_ARGUMENT, "unknown option");
+  }
+  fit->error.clear();
+  return LAB3_OK;
+}
+
+const char *lab3_fit_error(const lab3_fit *fit) {
+  return fit ? fit->error.c_str() : "";
+}
+
+lab3_status lab3_find_best_function(lab3_fit *fit, const lab3_series *series,
+                                    int *type, int *degree) {
+  if (!fit || !series || !type || !degree) {
+    return fail(fit, LAB3_INVALID_ARGUMENT, "null argument");
+  }
+  return guarded(fit, [&] {
+    auto points = to_series(*series);
+    if (!FitEngine::is_valid(points)) {
+      return fail(fit, LAB3_INVALID_ARGUMENT, "invalid series");
+    }
+    auto func = fit->engine.find_best_function(points);
+    *type = static_cast<int>(func.get_type());
+    *degree = func.get_type() == Function::Type::Polynomial ? func.get_m() : 0;
+    return LAB3_OK;
+  });
+}
+
+lab3_status lab3_calculate_coefficients(lab3_fit *fit,
+                                        const lab3_series *series, int type,
+                                        int degree, lab3_fit_result *result) {
+  if (!fit || !series || !result) {
+    return fail(fit, LAB3_INVALID_ARGUMENT, "null argument");
+  }
+  return guarded(fit, [&] {
+    auto points = to_series(*series);
+    if (!FitEngine::is_valid(points)) {
+      return fail(fit, LAB3_INVALID_ARGUMENT, "invalid series");
+    }
+    Function func(Function::Type::Polynomial, 1);
+    if (!to_function(type, degree, func)) {
+      return fail(fit, LAB3_INVALID_ARGUMENT, "unsupported function");
+    }
+    to_result(fit->engine.fit_function(func, points), *result);
+    return LAB3_OK;
+  });
+}
+
+lab3_status lab3_fit_best(lab3_fit *fit, const lab3_series *series,
+                          lab3_fit_result *result) {
+  if (!fit || !series || !result) {
+    return fail(fit, LAB3_INVALID_ARGUMENT, "null argument");
+  }
+  return guarded(fit, [&] {
+    auto points = to_series(*series);
+    if (!FitEngine::is_valid(points)) {
+      return fail(fit, LAB3_INVALID_ARGUMENT, "invalid series");
+    }
+    to_result(fit->engine.fit(points), *result);
+    return LAB3_OK;
+  });
+}
+
+lab3_status lab3_fit_batch(lab3_fit *fit, const lab3_series *series,
+                           size_t count, lab3_fit_result *results) {
+  if (!fit || (count > 0 && (!series || !results))) {
+    return fail(fit, LAB3_INVALID_ARGUMENT, "null argument");
+  }
+  return guarded(fit, [&] {
+    for (size_t i = 0; i < count; ++i) {
+      if (!FitEngine::is_valid(to_series(series[i]))) {
+        return fail(fit, LAB3_INVALID_ARGUMENT,
+                    "invalid series at index " + std::to_string(i));
+      }
+    }
+    fit->batch_series.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      fit->batch_series[i] = to_series(series[i]);
+    }
+    fit->batch.resize(count);
+    fit->engine.fit_batch(fit->batch_series.data(), count, fit->batch.data());
+    for (size_t i = 0; i < count; ++i) {
+      to_result(fit->batch[i], results[i]);
+    }
+    return LAB3_OK;
+  });
+}
+
+lab3_status lab3_fit_evaluate(const lab3_fit_result *result,
+                              const lab3_series *series, double *phi,
+                              double *epsilon) {
+  if (!result || !series || (series->n > 0 && (!series->x || !series->y))) {
+    return LAB3_INVALID_ARGUMENT;
+  }
+  FitEngine::Summary summary;
+  if (!to_function(result->type, result->degree, summary.function) ||
+      result->coefficient_count < 0 ||
+      result->coefficient_count > LAB3_FIT_MAX_COEFFICIENTS ||
+      !std::isfinite(result->shift) || !(result->scale > 0.0) ||
+      !std::isfinite(result->scale)) {
+    return LAB3_INVALID_ARGUMENT;
+  }
+  summary.function =
+      summary.function.in_basis(result->shift, result->scale);
+  summary.coefficient_count = result->coefficient_count;
+  for (int k = 0; k < LAB3_FIT_MAX_COEFFICIENTS; ++k) {
+    summary.coefficients[k] = result->coefficients[k];
+  }
+  try {
+    FitEngine::evaluate(summary, to_series(*series), phi, epsilon);
+  } catch (std::bad_alloc const &) {
+    return LAB3_OUT_OF_MEMORY;
+  }
+  return LAB3_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,844 @@
+#include "command_line.hpp"
+#include "calculator.hpp"
+#include "column_reader.hpp"
+#include "file_parser.hpp"
+#include "fit_cache.hpp"
+#include "fit_protocol.hpp"
+#include "fit_service.hpp"
+#include "latency_recorder.hpp"
+#include "multi_series.hpp"
+#include "multivariate_regression.hpp"
+#include "rolling_window.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <signal.h>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+/** Command-line modes; any of these flags bypasses the GUI. */
+std::vector<std::string> const MODES = {
+    "--approximate", "--bootstrap", "--fit",          "--help",
+    "--jackknife",   "--multi",     "--multivariate", "--rolling",
+    "--segments",    "--serve"};
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void handle_interrupt(int) { interrupted = 1; }
+
+/**
+ * Installs handle_interrupt for SIGINT without SA_RESTART, so that a read
+ * blocked on an idle input fails instead of waiting for the next line.
+ */
+void interrupt_blocking_reads() {
+  struct sigaction action {};
+  action.sa_handler = handle_interrupt;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+}
+
+/**
+ * Parses a "x y [w]" point separated by whitespace or commas.
+ */
+bool parse_point_line(std::string line, double &x, double &y, double &w) {
+  std::replace(line.begin(), line.end(), ',', ' ');
+  std::istringstream ss(line);
+  if (!(ss >> x >> y)) {
+    return false;
+  }
+  if (double weight; ss >> weight) {
+    w = weight;
+  } else {
+    w = 1.0;
+  }
+  return true;
+}
+
+/**
+ * Names a function for the tabular modes, with the basis of its
+ * coefficients if they are not of x (or ln x) itself.
+ */
+std::string describe(Function const &func) {
+  if (!func.has_basis()) {
+    return func.to_string();
+  }
+  return func.to_string() + " [" + func.get_basis_string() + "]";
+}
+
+/**
+ * Prints the basis line of the report modes if the coefficients have one.
+ */
+void print_basis(Function const &func) {
+  if (func.has_basis()) {
+    std::cout << "Basis: " << func.get_basis_string() << '\n';
+  }
+}
+
+/**
+ * Streams the rows of a file into a multivariate regression and prints its
+ * coefficients and fit statistics.
+ */
+template <typename Regression>
+int run_regression(FileParser &parser, Regression regression) {
+  auto start = std::chrono::steady_clock::now();
+  parser.stream_rows([&regression](char const *begin, char const *end) {
+    regression.accumulate_text(begin, end);
+  });
+  auto coefficients = regression.solve();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (coefficients.empty()) {
+    std::cerr << "error: the predictors are linearly dependent or there are "
+                 "too few rows\n";
+    return 1;
+  }
+  auto rows = regression.size();
+  std::cout << std::setprecision(10) << "Coefficients:";
+  for (auto const &coefficient : coefficients) {
+    std::cout << ' ' << coefficient;
+  }
+  std::cout << "\nRMS: "
+            << std::sqrt(regression.residual_sum_of_squares(coefficients) /
+                         static_cast<double>(rows))
+            << "\nR^2: " << regression.r_squared(coefficients) << "\n";
+  std::cerr << rows << " rows (" << regression.malformed_rows()
+            << " malformed) in " << elapsed.count() << " s, "
+            << static_cast<double>(rows) / elapsed.count() << " rows/s\n";
+  return 0;
+}
+
+} // namespace
+
+CommandLine::CommandLine(int argc, char *argv[])
+    : arguments(argv + 1, argv + argc) {
+  for (auto const &argument : arguments) {
+    if (std::find(MODES.begin(), MODES.end(), argument) != MODES.end()) {
+      mode = argument.substr(2);
+      break;
+    }
+  }
+  startup_benchmark =
+      mode.empty() && std::find(arguments.begin(), arguments.end(),
+                                "--benchmark-startup") != arguments.end();
+}
+
+bool CommandLine::is_requested() const { return !mode.empty(); }
+
+bool CommandLine::parse(std::string &error) {
+  for (std::size_t i = 0; i < arguments.size(); ++i) {
+    auto const &argument = arguments[i];
+    auto value = [&](std::string &out) {
+      if (i + 1 >= arguments.size()) {
+        error = "missing value for " + argument;
+        return false;
+      }
+      out = arguments[++i];
+      return true;
+    };
+    std::string text;
+
+    if (argument == "--fit" || argument == "--help" ||
+        argument == "--multi" || argument == "--multivariate" ||
+        argument == "--segments" || argument == "--approximate") {
+      continue;
+    }
+    if (argument == "--jackknife") {
+      resampling.method = BootstrapAnalysis::Method::Jackknife;
+    } else if (argument == "--bootstrap") {
+      if (!value(text)) {
+        return false;
+      }
+      resampling.replicates = std::atoi(text.c_str());
+      if (resampling.replicates < 2) {
+        error = "at least 2 bootstrap replicates are needed";
+        return false;
+      }
+    } else if (argument == "--seed") {
+      if (!value(text)) {
+        return false;
+      }
+      resampling.seed = std::strtoull(text.c_str(), nullptr, 10);
+      sampling.seed = resampling.seed;
+    } else if (argument == "--confidence") {
+      if (!value(text)) {
+        return false;
+      }
+      resampling.confidence = std::atof(text.c_str());
+      if (!(resampling.confidence > 0.0 && resampling.confidence < 1.0)) {
+        error = "confidence must be between 0 and 1";
+        return false;
+      }
+    } else if (argument == "--penalty") {
+      if (!value(text)) {
+        return false;
+      }
+      segmentation.penalty = std::atof(text.c_str());
+      if (!(segmentation.penalty > 0.0)) {
+        error = "penalty must be positive";
+        return false;
+      }
+    } else if (argument == "--tolerance") {
+      if (!value(text)) {
+        return false;
+      }
+      sampling.tolerance = std::atof(text.c_str());
+    } else if (argument == "--time-budget") {
+      if (!value(text)) {
+        return false;
+      }
+      sampling.seconds = std::atof(text.c_str());
+    } else if (argument == "--sample") {
+      if (!value(text)) {
+        return false;
+      }
+      sampling.max_sample = std::strtoul(text.c_str(), nullptr, 10);
+      if (sampling.max_sample < 16) {
+        error = "the sample needs at least 16 points";
+        return false;
+      }
+      sampling.initial_sample =
+          std::min(sampling.initial_sample, sampling.max_sample);
+    } else if (argument == "--confirm") {
+      sampling.confirm = true;
+    } else if (argument == "--stream") {
+      stream_input = true;
+    } else if (argument == "--columns") {
+      if (!value(columns)) {
+        return false;
+      }
+    } else if (argument == "--export") {
+      if (!value(export_path)) {
+        return false;
+      }
+    } else if (argument == "--export-format") {
+      if (!value(export_format)) {
+        return false;
+      }
+      if (ResultWriter::Format format;
+          !ResultWriter::parse_format(export_format, format)) {
+        error = "unknown export format " + export_format;
+        return false;
+      }
+    } else if (argument == "--rolling") {
+      if (!value(text)) {
+        return false;
+      }
+      window = std::strtoul(text.c_str(), nullptr, 10);
+      if (window < 2) {
+        error = "window size must be at least 2";
+        return false;
+      }
+    } else if (argument == "--serve") {
+      if (!value(socket_path)) {
+        return false;
+      }
+    } else if (argument == "--workers") {
+      if (!value(text)) {
+        return false;
+      }
+      workers = static_cast<unsigned>(std::strtoul(text.c_str(), nullptr, 10));
+    } else if (argument == "--batch") {
+      if (!value(text)) {
+        return false;
+      }
+      batch_size = std::strtoul(text.c_str(), nullptr, 10);
+    } else if (argument == "--queue") {
+      if (!value(text)) {
+        return false;
+      }
+      queue_capacity = std::strtoul(text.c_str(), nullptr, 10);
+    } else if (argument == "--cache-dir") {
+      if (!value(cache_dir)) {
+        return false;
+      }
+    } else if (argument == "--follow") {
+      follow = true;
+    } else if (argument == "--refine") {
+      options.nonlinear_refinement = true;
+    } else if (argument == "--robust") {
+      if (!value(text)) {
+        return false;
+      }
+      if (text == "huber") {
+        options.robust_loss = FitOptions::RobustLoss::Huber;
+      } else if (text == "tukey") {
+        options.robust_loss = FitOptions::RobustLoss::Tukey;
+      } else {
+        error = "unknown robust loss " + text;
+        return false;
+      }
+    } else if (argument == "--selection") {
+      if (!value(text)) {
+        return false;
+      }
+      if (text == "insample") {
+        options.selection = FitOptions::Selection::InSample;
+      } else if (text == "loo") {
+        options.selection = FitOptions::Selection::LeaveOneOut;
+      } else if (text == "kfold") {
+        options.selection = FitOptions::Selection::KFold;
+      } else {
+        error = "unknown selection " + text;
+        return false;
+      }
+    } else if (argument == "--precision") {
+      if (!value(text)) {
+        return false;
+      }
+      if (!FitProtocol::parse_precision(text, options)) {
+        error = "unknown precision " + text;
+        return false;
+      }
+    } else if (argument == "--folds") {
+      if (!value(text)) {
+        return false;
+      }
+      options.cv_folds = std::atoi(text.c_str());
+      if (options.cv_folds < 2) {
+        error = "at least 2 folds are needed";
+        return false;
+      }
+    } else if (argument.size() > 1 && argument[0] == '-') {
+      error = "unknown option " + argument;
+      return false;
+    } else {
+      input = argument;
+    }
+  }
+  if (options.precision == FitOptions::Precision::Float &&
+      mode != "multivariate") {
+    error = "--precision float is only supported with --multivariate";
+    return false;
+  }
+  return true;
+}
+
+int CommandLine::run() {
+  std::string error;
+  if (!parse(error)) {
+    std::cerr << "error: " << error << "\n";
+    print_usage(std::cerr);
+    return 2;
+  }
+  if (mode == "fit") {
+    return run_fit();
+  }
+  if (mode == "bootstrap" || mode == "jackknife") {
+    resampling.workers = workers;
+    return run_resampling();
+  }
+  if (mode == "approximate") {
+    sampling.workers = workers;
+    return run_approximate();
+  }
+  if (mode == "segments") {
+    segmentation.workers = workers;
+    return run_segments();
+  }
+  if (mode == "rolling") {
+    return run_rolling();
+  }
+  if (mode == "serve") {
+    return run_serve();
+  }
+  if (mode == "multi") {
+    return run_multi();
+  }
+  if (mode == "multivariate") {
+    return run_multivariate();
+  }
+  print_usage(std::cout);
+  return 0;
+}
+
+bool CommandLine::read_points(std::vector<double> &x, std::vector<double> &y,
+                              std::vector<double> &w) const {
+  FileParser parser(QString::fromStdString(input));
+  if (parser.has_row_layout() || !columns.empty()) {
+    std::size_t malformed = 0;
+    if (!parser.read_columns(columns, x, y, w, malformed)) {
+      std::cerr << "error: " << parser.getError() << "\n";
+      return false;
+    }
+    if (malformed > 0) {
+      std::cerr << "skipped " << malformed << " malformed lines\n";
+    }
+    return true;
+  }
+  if (!parser.parse()) {
+    std::cerr << "error: cannot read points from " << input << "\n";
+    return false;
+  }
+  for (auto const &[x_text, y_text] : parser.getLines()) {
+    x.push_back(x_text.toDouble());
+    y.push_back(y_text.toDouble());
+  }
+  for (auto const &weight : parser.getWeights()) {
+    w.push_back(weight.toDouble());
+  }
+  return true;
+}
+
+std::unique_ptr<ResultWriter> CommandLine::open_export() const {
+  auto format = ResultWriter::format_of(export_path);
+  if (!export_format.empty()) {
+    ResultWriter::parse_format(export_format, format);
+  }
+  return std::make_unique<ResultWriter>(export_path, format, workers);
+}
+
+bool CommandLine::finish_export(
+    ResultWriter &writer, std::chrono::steady_clock::time_point start) const {
+  if (!writer.finish()) {
+    std::cerr << "error: " << writer.error() << "\n";
+    return false;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  auto megabytes = static_cast<double>(writer.bytes_written()) / 1e6;
+  std::cerr << "exported " << megabytes << " MB to " << export_path << " in "
+            << elapsed.count() << " s (" << megabytes / elapsed.count()
+            << " MB/s)\n";
+  return true;
+}
+
+bool CommandLine::export_points(FitResult const &result,
+                                std::vector<double> const &x,
+                                std::vector<double> const &y,
+                                std::vector<double> const &w) const {
+  auto start = std::chrono::steady_clock::now();
+  auto writer = open_export();
+  writer->write_header(result);
+  writer->write_rows(x.data(), y.data(), w.empty() ? nullptr : w.data(),
+                     x.size());
+  return finish_export(*writer, start);
+}
+
+int CommandLine::run_fit() {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> w;
+  if (!read_points(x, y, w)) {
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  FitCache cache(1, cache_dir);
+  auto key = FitCache::make_key(x, y, w, options);
+  auto result = cache.find(key, x, y);
+  auto hit = result.has_value();
+  if (!hit) {
+    result = ApproximationCalculator::fit_best_function(x, y, w, options);
+    if (!cache_dir.empty()) {
+      cache.insert(key, *result);
+    }
+  }
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (!result->error.empty()) {
+    std::cerr << "error: " << result->error << "\n";
+    return 1;
+  }
+  std::cout << std::setprecision(10) << "Function: "
+            << result->function.to_string() << ' '
+            << result->function.get_string_function(result->coefficients)
+            << "\nCoefficients:";
+  for (auto const &coefficient : result->coefficients) {
+    std::cout << ' ' << coefficient;
+  }
+  std::cout << '\n';
+  print_basis(result->function);
+  std::cout << "Pearson correlation: " << result->pearson_correlation
+            << "\nRMS: " << result->deviation
+            << "\nMax |epsilon|: " << result->max_abs_epsilon << "\n";
+  std::cerr << (hit ? "cache hit" : "cache miss") << " in " << elapsed.count()
+            << " us\n";
+  if (!export_path.empty() && !export_points(*result, x, y, w)) {
+    return 1;
+  }
+  return 0;
+}
+
+int CommandLine::run_resampling() {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> w;
+  if (!read_points(x, y, w)) {
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto report = BootstrapAnalysis::analyze(x, y, w, options, resampling);
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  auto jackknife = resampling.method == BootstrapAnalysis::Method::Jackknife;
+  std::cout << std::setprecision(10) << "Function: "
+            << report.function.to_string() << ' '
+            << report.function.get_string_function(report.coefficients)
+            << "\nCoefficients (" << resampling.confidence * 100.0 << "% "
+            << (jackknife ? "jackknife normal" : "bootstrap percentile")
+            << " interval, standard error):\n";
+  for (std::size_t k = 0; k < report.intervals.size(); ++k) {
+    auto const &interval = report.intervals[k];
+    std::cout << "  c" << k << '\t' << interval.estimate << "\t["
+              << interval.lower << ", " << interval.upper << "]\t"
+              << interval.standard_error << '\n';
+  }
+  print_basis(report.function);
+  std::cout << "Model selection over " << report.replicates
+            << " replicates:\n";
+  for (auto const &selection : report.selections) {
+    std::cout << "  " << selection.function.to_string() << '\t'
+              << 100.0 * selection.wins / std::max(1, report.replicates)
+              << "%\n";
+  }
+  std::cerr << report.replicates << " replicates (" << report.failed
+            << " failed) in " << elapsed.count() << " ms\n";
+  return 0;
+}
+
+int CommandLine::run_segments() {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> w;
+  if (!read_points(x, y, w)) {
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto segments = SegmentedFitter(x, y, w, options, segmentation).fit();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << std::setprecision(10);
+  for (auto const &segment : segments) {
+    std::cout << segment.x_begin << '\t' << segment.x_end << '\t'
+              << segment.end - segment.begin << '\t'
+              << describe(segment.function) << '\t';
+    for (auto const &coefficient : segment.coefficients) {
+      std::cout << coefficient << ' ';
+    }
+    std::cout << '\t' << segment.deviation << '\n';
+  }
+  std::cerr << segments.size() << " segments of " << x.size() << " points in "
+            << elapsed.count() << " ms\n";
+  return 0;
+}
+
+int CommandLine::run_approximate() {
+  auto start = std::chrono::steady_clock::now();
+  SampledFitter::Result result;
+  if (stream_input) {
+    FileParser parser(QString::fromStdString(input));
+    std::size_t malformed = 0;
+    std::string failure;
+    auto stream = [this, &parser, &malformed, &failure](auto &&visit) {
+      ColumnReader reader(columns);
+      auto ok = parser.stream_rows([&](char const *begin, char const *end) {
+        malformed += reader.parse(begin, end, visit);
+      });
+      failure = ok ? reader.error() : parser.getError();
+      return failure.empty();
+    };
+    SampledFitter::Reservoir reservoir(sampling.max_sample, sampling.seed);
+    if (!stream([&reservoir](double x, double y, double w) {
+          reservoir.add(x, y, w);
+        })) {
+      std::cerr << "error: " << failure << "\n";
+      return 1;
+    }
+    if (malformed > 0) {
+      std::cerr << "skipped " << malformed << " malformed lines\n";
+    }
+    result = SampledFitter::fit(reservoir, options, sampling);
+    if (sampling.confirm && result.sample_size > 0) {
+      SampledFitter::ExactPass pass(result);
+      stream([&pass](double x, double y, double w) { pass.add(x, y, w); });
+      pass.finish(result);
+    }
+    if (!export_path.empty() && result.sample_size > 0) {
+      // A third pass; the header needs the statistics of the exact pass
+      auto export_start = std::chrono::steady_clock::now();
+      auto writer = open_export();
+      writer->write_header(result.to_fit_result());
+      std::vector<double> chunk[3];
+      auto write_chunk = [&writer, &chunk] {
+        writer->write_rows(chunk[0].data(), chunk[1].data(), chunk[2].data(),
+                           chunk[0].size());
+        for (auto &column : chunk) {
+          column.clear();
+        }
+      };
+      stream([&](double x, double y, double w) {
+        chunk[0].push_back(x);
+        chunk[1].push_back(y);
+        chunk[2].push_back(w);
+        if (chunk[0].size() == 4096) {
+          write_chunk();
+        }
+      });
+      write_chunk();
+      if (!finish_export(*writer, export_start)) {
+        return 1;
+      }
+    }
+  } else {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> w;
+    if (!read_points(x, y, w)) {
+      return 1;
+    }
+    start = std::chrono::steady_clock::now();
+    result = SampledFitter::fit(x, y, w, options, sampling);
+    if (!export_path.empty() && result.sample_size > 0 &&
+        !export_points(result.to_fit_result(), x, y, w)) {
+      return 1;
+    }
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (result.sample_size == 0) {
+    std::cerr << "error: no points in " << input << "\n";
+    return 1;
+  }
+
+  std::cout << std::setprecision(10) << "Function: "
+            << result.function.to_string() << ' '
+            << result.function.get_string_function(result.coefficients)
+            << "\nCoefficients (standard error):\n";
+  for (std::size_t k = 0; k < result.coefficients.size(); ++k) {
+    std::cout << "  c" << k << '\t' << result.coefficients[k] << '\t'
+              << result.coefficient_errors[k] << '\n';
+  }
+  print_basis(result.function);
+  std::cout << "Sample: " << result.sample_size << " of " << result.population
+            << " points, " << result.rounds << " round(s) ("
+            << (result.converged ? "within tolerance" : "budget exhausted")
+            << ")\nEstimated RMS: " << result.deviation << " +- "
+            << result.deviation_error
+            << "\nCurve standard error: " << result.curve_error << '\n';
+  if (result.confirmed) {
+    std::cout << "Exact RMS: " << result.exact_deviation
+              << "\nExact max |epsilon|: " << result.exact_max_abs_epsilon
+              << '\n';
+  }
+  std::cerr << "approximate fit in " << elapsed.count() << " ms\n";
+  return 0;
+}
+
+int CommandLine::run_rolling() {
+  std::ifstream file;
+  std::istream *in = &std::cin;
+  if (input != "-") {
+    file.open(input);
+    if (!file.is_open()) {
+      std::cerr << "error: cannot open " << input << "\n";
+      return 1;
+    }
+    in = &file;
+  }
+  interrupt_blocking_reads();
+
+  RollingWindowFitter fitter(window, options);
+  LatencyRecorder latencies;
+  std::string line;
+  std::string pending;
+  std::cout << std::setprecision(10);
+  while (!interrupted) {
+    if (!std::getline(*in, line) || in->eof()) {
+      if (interrupted) {
+        break;
+      }
+      // At the end of a growing file keep any partial line and wait
+      if (follow && in == &file) {
+        pending += line;
+        file.clear();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        continue;
+      }
+      if (line.empty()) {
+        break;
+      }
+    }
+    line = pending + line;
+    pending.clear();
+
+    double x;
+    double y;
+    double w;
+    if (!parse_point_line(line, x, y, w)) {
+      if (!line.empty()) {
+        std::cerr << "skipping malformed line: " << line << "\n";
+      }
+      continue;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    fitter.add(x, y, w);
+    auto result = fitter.fit();
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+    latencies.record(elapsed.count());
+
+    std::cout << x << '\t';
+    if (result) {
+      std::cout << describe(result->function) << '\t';
+      for (auto const &coefficient : result->coefficients) {
+        std::cout << coefficient << ' ';
+      }
+      std::cout << '\t' << result->deviation;
+    } else {
+      std::cout << "-\t-\t-";
+    }
+    std::cout << '\t' << elapsed.count() << std::endl;
+  }
+
+  std::cerr << "latency: " << latencies.summary() << "\n";
+  return 0;
+}
+
+int CommandLine::run_multi() {
+  FileParser parser(QString::fromStdString(input));
+  if (!parser.parse_series()) {
+    std::cerr << "error: cannot read series from " << input << "\n";
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto results = MultiSeriesFitter(parser.getX(), parser.getSeries(), options)
+                     .fit();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << std::setprecision(10);
+  for (std::size_t s = 0; s < results.size(); ++s) {
+    auto const &result = results[s];
+    std::cout << s << '\t' << describe(result.function) << '\t';
+    for (auto const &coefficient : result.coefficients) {
+      std::cout << coefficient << ' ';
+    }
+    std::cout << '\t' << result.deviation << '\n';
+  }
+  std::cerr << "fitted " << results.size() << " series in " << elapsed.count()
+            << " ms\n";
+  return 0;
+}
+
+int CommandLine::run_multivariate() {
+  FileParser parser(QString::fromStdString(input));
+  auto columns = parser.count_columns();
+  if (columns < 2) {
+    std::cerr << "error: cannot read rows from " << input << "\n";
+    return 1;
+  }
+  auto predictors = static_cast<int>(columns) - 1;
+  switch (options.precision) {
+  case FitOptions::Precision::Float:
+    return run_regression(parser,
+                          BasicMultivariateRegression<float>(predictors));
+  case FitOptions::Precision::Compensated:
+    return run_regression(
+        parser, BasicMultivariateRegression<double, KahanSum>(predictors));
+  case FitOptions::Precision::Pairwise:
+    return run_regression(
+        parser, BasicMultivariateRegression<double, PairwiseSum>(predictors));
+  default:
+    return run_regression(parser, MultivariateRegression(predictors));
+  }
+}
+
+int CommandLine::run_serve() {
+  FitService::Settings settings;
+  settings.socket_path = socket_path;
+  settings.workers = workers;
+  settings.batch_size = batch_size;
+  settings.queue_capacity = queue_capacity;
+  settings.cache_dir = cache_dir;
+  std::signal(SIGINT, handle_interrupt);
+  std::signal(SIGTERM, handle_interrupt);
+
+  FitService service(settings, options);
+  auto status = service.run(interrupted);
+  std::cerr << "latency: " << service.summary() << "\n";
+  return status;
+}
+
+void CommandLine::print_usage(std::ostream &os) {
+  os << "Usage: lab3_cpp [mode] [options] [input]\n"
+        "\n"
+        "Without a mode the graphical interface is started.\n"
+        "\n"
+        "Modes:\n"
+        "  --fit              Find the best function for a point file\n"
+        "  --bootstrap N      Fit a point file and estimate coefficient\n"
+        "                     intervals and selection frequencies from N\n"
+        "                     bootstrap resamples\n"
+        "  --jackknife        Like --bootstrap with leave-one-out resamples\n"
+        "  --segments         Split a point file into regimes and find the\n"
+        "                     best function for each\n"
+        "  --approximate      Fit a growing sample of a point file and\n"
+        "                     estimate the error of the approximation\n"
+        "  --rolling W        Fit the last W points of a stream of\n"
+        "                     \"x y [w]\" lines after every sample and\n"
+        "                     report the latency\n"
+        "  --multi            Fit every y line of a file with one x line\n"
+        "                     followed by several y lines\n"
+        "  --multivariate     Fit y = b0 + b1*x1 + ... + bk*xk to a file of\n"
+        "                     \"x1 ... xk y\" lines in one streaming pass\n"
+        "  --serve SOCKET     Answer newline-delimited JSON fit requests on\n"
+        "                     a Unix domain socket until interrupted\n"
+        "  --benchmark-startup\n"
+        "                     Start the interface, print the startup\n"
+        "                     milestones once the graph has loaded and exit\n"
+        "  --help             Show this help\n"
+        "\n"
+        "Options:\n"
+        "  --cache-dir DIR    Reuse --fit and --serve results stored in DIR\n"
+        "  --workers N        Threads of --serve, --bootstrap, --jackknife,\n"
+        "                     --segments and --export (default: all)\n"
+        "  --seed S           Seed of the --bootstrap and --approximate\n"
+        "                     samples (default 1)\n"
+        "  --confidence C     Coverage of the intervals (default 0.95)\n"
+        "  --penalty P        Scale of the --segments cost per segment;\n"
+        "                     larger values give fewer segments (default 1)\n"
+        "  --tolerance T      Stop --approximate once the curve error is\n"
+        "                     below T times the RMS error (default 0.05)\n"
+        "  --time-budget S    Seconds --approximate may spend on samples\n"
+        "  --sample K         Largest --approximate sample (default 1048576)\n"
+        "  --stream           Sample a point file of any length with a\n"
+        "                     reservoir of --sample points in one pass\n"
+        "  --confirm          Evaluate the --approximate fit on all points\n"
+        "  --columns X,Y[,W]  Columns of a CSV/TSV point file, by header\n"
+        "                     name or 1-based number (default x, y, w or\n"
+        "                     the first three)\n"
+        "  --export FILE      Write the --fit or --approximate model and\n"
+        "                     x, y, w, phi, epsilon of every point to FILE\n"
+        "  --export-format F  csv, jsonl or binary (default: by the FILE\n"
+        "                     extension, .jsonl, .bin or else csv)\n"
+        "  --batch N          Requests a --serve worker takes at once\n"
+        "  --queue N          Queued --serve requests before reading pauses\n"
+        "  --follow           Keep reading the input file as it grows\n"
+        "  --refine           Refine exponential and power fits (LM)\n"
+        "  --robust LOSS      Robust fitting: huber or tukey\n"
+        "  --selection MODE   Model selection: insample, loo or kfold\n"
+        "  --folds K          Number of folds for kfold selection (at\n"
+        "                     least 2, capped at the number of points)\n"
+        "  --precision MODE   Accumulation: double, float (--multivariate\n"
+        "                     only), compensated or pairwise\n"
+        "\n"
+        "Point files named *.csv or *.tsv, gzip- or zstd-compressed point\n"
+        "files and any input with --columns hold one point per line.\n"
+        "--rolling reads stdin when the input is \"-\" or omitted.\n";
+}
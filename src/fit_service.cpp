@@ -0,0 +1,398 @@
+#include "fit_service.hpp"
+#include "calculator.hpp"
+#include "fit_protocol.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/** Bytes read from one connection per event loop iteration. */
+constexpr std::size_t READ_CHUNK = 64 * 1024;
+
+/** Responses kept in memory by the service's fit cache. */
+constexpr std::size_t CACHE_CAPACITY = 256;
+
+} // namespace
+
+FitService::FitService(Settings settings, FitOptions const &options)
+    : settings(std::move(settings)), options(options),
+      cache(CACHE_CAPACITY, this->settings.cache_dir) {
+  auto &limits = this->settings;
+  limits.batch_size = std::max<std::size_t>(1, limits.batch_size);
+  limits.max_in_flight = std::max<std::size_t>(1, limits.max_in_flight);
+}
+
+FitService::~FitService() {
+  {
+    std::lock_guard lock(queue_mutex);
+    stopping = true;
+  }
+  queue_ready.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+#ifndef _WIN32
+  for (auto &[id, connection] : connections) {
+    ::close(connection.fd);
+  }
+  for (auto fd : {listener, wake_pipe[0], wake_pipe[1]}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  if (listener >= 0) {
+    ::unlink(settings.socket_path.c_str());
+  }
+#endif
+}
+
+std::string FitService::summary() {
+  std::lock_guard lock(metrics_mutex);
+  return "requests=" + std::to_string(answered) + " " + latencies.summary();
+}
+
+std::size_t FitService::queued() {
+  std::lock_guard lock(queue_mutex);
+  return queue.size();
+}
+
+std::string FitService::answer(Job const &job) {
+  FitRequest request;
+  request.options = options;
+  std::string error;
+  std::string response;
+  if (!FitProtocol::parse(job.line, request, error)) {
+    response = FitProtocol::format_error(request, error);
+  } else if (request.metrics) {
+    auto backlog = queued();
+    std::lock_guard lock(metrics_mutex);
+    return FitProtocol::format_metrics(request, answered,
+                                       latencies.percentile(0.5),
+                                       latencies.percentile(0.99), backlog);
+  } else {
+    try {
+      auto key = FitCache::make_key(request.x, request.y, request.w,
+                                    request.options);
+      std::optional<FitResult> result;
+      {
+        std::lock_guard lock(cache_mutex);
+        result = cache.find(key, request.x, request.y);
+      }
+      auto cached = result.has_value();
+      if (!cached) {
+        result = ApproximationCalculator::fit_best_function(
+            request.x, request.y, request.w, request.options);
+        std::lock_guard lock(cache_mutex);
+        cache.insert(key, *result);
+      }
+      response = FitProtocol::format(request, *result, cached);
+    } catch (std::exception const &e) {
+      response = FitProtocol::format_error(request, e.what());
+    }
+  }
+
+  std::chrono::duration<double, std::micro> latency =
+      Clock::now() - job.received;
+  std::lock_guard lock(metrics_mutex);
+  latencies.record(latency.count());
+  ++answered;
+  return response;
+}
+
+void FitService::work() {
+  std::vector<Job> batch;
+  std::vector<Completion> done;
+  while (true) {
+    {
+      std::unique_lock lock(queue_mutex);
+      queue_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (stopping) {
+        return;
+      }
+      // Spread a short queue over the workers instead of one taking it all
+      auto share = (queue.size() + workers.size() - 1) / workers.size();
+      auto count = std::clamp<std::size_t>(share, 1, settings.batch_size);
+      for (std::size_t i = 0; i < count; ++i) {
+        batch.push_back(std::move(queue.front()));
+        queue.pop_front();
+      }
+    }
+    for (auto const &job : batch) {
+      done.push_back({job.connection, answer(job)});
+    }
+    {
+      std::lock_guard lock(completion_mutex);
+      for (auto &completion : done) {
+        completions.push_back(std::move(completion));
+      }
+    }
+#ifndef _WIN32
+    // A full pipe already guarantees a wakeup, so the result is ignored
+    [[maybe_unused]] auto written = ::write(wake_pipe[1], "", 1);
+#endif
+    batch.clear();
+    done.clear();
+  }
+}
+
+#ifndef _WIN32
+
+namespace {
+
+bool set_non_blocking(int fd) {
+  auto flags = ::fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+} // namespace
+
+bool FitService::listen(std::string &error) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (settings.socket_path.empty() ||
+      settings.socket_path.size() >= sizeof address.sun_path) {
+    error = "invalid socket path " + settings.socket_path;
+    return false;
+  }
+  std::strcpy(address.sun_path, settings.socket_path.c_str());
+
+  if (::pipe(wake_pipe) != 0 || !set_non_blocking(wake_pipe[0]) ||
+      !set_non_blocking(wake_pipe[1])) {
+    error = std::string("cannot create pipe: ") + std::strerror(errno);
+    return false;
+  }
+  listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    error = std::string("cannot create socket: ") + std::strerror(errno);
+    return false;
+  }
+  // A socket file left behind by a previous run would make bind fail
+  ::unlink(settings.socket_path.c_str());
+  if (::bind(listener, reinterpret_cast<sockaddr *>(&address),
+             sizeof address) != 0 ||
+      ::listen(listener, SOMAXCONN) != 0 || !set_non_blocking(listener)) {
+    error = "cannot listen on " + settings.socket_path + ": " +
+            std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+void FitService::accept_connections() {
+  while (true) {
+    auto fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      return;
+    }
+    if (!set_non_blocking(fd)) {
+      ::close(fd);
+      continue;
+    }
+    Connection connection;
+    connection.fd = fd;
+    connections.emplace(next_connection++, std::move(connection));
+  }
+}
+
+bool FitService::read_connection(Connection &connection) {
+  char buffer[READ_CHUNK];
+  auto count = ::read(connection.fd, buffer, sizeof buffer);
+  if (count < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  }
+  if (count == 0) {
+    // Answer a last request that lacks its newline
+    if (!connection.input.empty()) {
+      connection.input += '\n';
+    }
+    connection.closed = true;
+    return true;
+  }
+  connection.input.append(buffer, static_cast<std::size_t>(count));
+  if (connection.input.size() > settings.max_line &&
+      connection.input.find('\n') == std::string::npos) {
+    FitRequest request;
+    connection.output +=
+        FitProtocol::format_error(request, "request line too long");
+    connection.input.clear();
+    connection.closed = true;
+  }
+  return true;
+}
+
+bool FitService::write_connection(Connection &connection) {
+  auto count = ::write(connection.fd, connection.output.data(),
+                       connection.output.size());
+  if (count < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  }
+  connection.output.erase(0, static_cast<std::size_t>(count));
+  return true;
+}
+
+void FitService::dispatch_lines(std::uint64_t id, Connection &connection) {
+  auto const &input = connection.input;
+  std::size_t start = 0;
+  std::size_t added = 0;
+  {
+    std::lock_guard lock(queue_mutex);
+    auto now = Clock::now();
+    while (connection.in_flight < settings.max_in_flight &&
+           queue.size() < settings.queue_capacity) {
+      auto end = input.find('\n', start);
+      if (end == std::string::npos) {
+        break;
+      }
+      auto first = input.find_first_not_of(" \t\r", start);
+      if (first < end) {
+        queue.push_back({id, input.substr(start, end - start), now});
+        ++connection.in_flight;
+        ++added;
+      }
+      start = end + 1;
+    }
+  }
+  connection.input.erase(0, start);
+  if (added == 1) {
+    queue_ready.notify_one();
+  } else if (added > 1) {
+    queue_ready.notify_all();
+  }
+}
+
+void FitService::collect_completions() {
+  char buffer[256];
+  while (::read(wake_pipe[0], buffer, sizeof buffer) > 0) {
+  }
+  std::vector<Completion> ready;
+  {
+    std::lock_guard lock(completion_mutex);
+    ready.swap(completions);
+  }
+  for (auto &completion : ready) {
+    if (auto it = connections.find(completion.connection);
+        it != connections.end()) {
+      it->second.output += completion.response;
+      --it->second.in_flight;
+    }
+  }
+  // Lines held back by backpressure can be queued now
+  for (auto &[id, connection] : connections) {
+    if (!connection.input.empty()) {
+      dispatch_lines(id, connection);
+    }
+  }
+}
+
+int FitService::run(volatile std::sig_atomic_t const &stop) {
+  std::string error;
+  if (!listen(error)) {
+    std::cerr << "error: " << error << "\n";
+    return 1;
+  }
+  std::signal(SIGPIPE, SIG_IGN);
+
+  auto count = settings.workers == 0 ? worker_count() : settings.workers;
+  workers.reserve(count);
+  {
+    // Workers read workers.size(), so start them once it is final
+    std::lock_guard lock(queue_mutex);
+    for (unsigned i = 0; i < count; ++i) {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+  std::cerr << "serving on " << settings.socket_path << " with " << count
+            << " workers\n";
+
+  std::vector<pollfd> fds;
+  std::vector<std::uint64_t> ids;
+  while (!stop) {
+    auto throttled = queued() >= settings.queue_capacity;
+    fds.clear();
+    ids.clear();
+    fds.push_back({wake_pipe[0], POLLIN, 0});
+    fds.push_back({listener, POLLIN, 0});
+    for (auto const &[id, connection] : connections) {
+      short events = 0;
+      if (!connection.closed && !throttled &&
+          connection.in_flight < settings.max_in_flight) {
+        events |= POLLIN;
+      }
+      if (!connection.output.empty()) {
+        events |= POLLOUT;
+      }
+      fds.push_back({connection.fd, events, 0});
+      ids.push_back(id);
+    }
+
+    // The timeout bounds how long a stop request goes unnoticed
+    if (::poll(fds.data(), fds.size(), 200) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "error: poll failed: " << std::strerror(errno) << "\n";
+      return 1;
+    }
+    if (fds[0].revents & POLLIN) {
+      collect_completions();
+    }
+    if (fds[1].revents & POLLIN) {
+      accept_connections();
+    }
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      auto it = connections.find(ids[i]);
+      auto &connection = it->second;
+      auto events = fds[i + 2].revents;
+      auto keep = true;
+      if (events & POLLIN) {
+        keep = read_connection(connection);
+        dispatch_lines(ids[i], connection);
+      }
+      if (events & (POLLHUP | POLLERR)) {
+        // The client is gone and cannot receive the pending responses
+        keep = false;
+      } else if (keep && !connection.output.empty()) {
+        keep = write_connection(connection);
+      }
+      if (connection.closed && connection.in_flight == 0 &&
+          connection.input.empty() && connection.output.empty()) {
+        keep = false;
+      }
+      if (!keep) {
+        ::close(connection.fd);
+        connections.erase(it);
+      }
+    }
+  }
+  return 0;
+}
+
+#else
+
+bool FitService::listen(std::string &error) {
+  error = "the fitting service needs Unix domain sockets";
+  return false;
+}
+
+int FitService::run(volatile std::sig_atomic_t const &) {
+  std::string error;
+  listen(error);
+  std::cerr << "error: " << error << "\n";
+  return 1;
+}
+
+#endif
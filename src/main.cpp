@@ -1,12 +1,39 @@
+#include "command_line.hpp"
 #include "mainwindow.hpp"
+#include "startup_profile.hpp"
 #include <QApplication>
+#include <QTimer>
+#include <iostream>
 #include <qresource.h>
 
 int main(int argc, char *argv[]) {
+  StartupProfile profile;
+  CommandLine command_line(argc, argv);
+  if (command_line.is_requested()) {
+    return command_line.run();
+  }
+
+  // QtWebEngine is started after the application, when the graph is needed
+  QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
   QApplication a(argc, argv);
+  profile.mark("application");
 
-  MainWindow w;
+  MainWindow w(nullptr, &profile);
+  profile.mark("window constructed");
   w.show();
+  profile.mark("window shown");
+
+  if (command_line.is_startup_benchmark()) {
+    auto report = [&profile](int status) {
+      profile.report(std::cout);
+      QApplication::exit(status);
+    };
+    QObject::connect(&w, &MainWindow::plot_ready, &a, [report] { report(0); });
+    QTimer::singleShot(30000, &a, [report] {
+      std::cout << "the graph did not load within 30 s\n";
+      report(1);
+    });
+  }
 
   return QApplication::exec();
-}
\ No newline at end of file
+}
@@ -1,12 +1,17 @@
 #include "mainwindow.hpp"
 #include "calculator.hpp"
+#include "result_writer.hpp"
 #include "table_event_handler.hpp"
+#include <QEvent>
+#include <QTimer>
+#include <algorithm>
 #include <file_parser.hpp>
 #include <fstream>
 #include <qmessagebox.h>
 #include <qpushbutton.h>
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
+MainWindow::MainWindow(QWidget *parent, StartupProfile *profile)
+    : QMainWindow(parent), profile(profile) {
   ui->setupUi(this);
 
   ui->result_output->acceptRichText();
@@ -18,9 +23,31 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
   connect(ui->add_btn, &QPushButton::clicked, this, &MainWindow::add_point);
   connect(ui->load_btn, &QPushButton::clicked, this, &MainWindow::load_file);
   connect(ui->calc_button, &QPushButton::clicked, this, &MainWindow::calculate);
+  connect(ui->export_btn, &QPushButton::clicked, this,
+          &MainWindow::export_results);
 
   table_event_handler = std::make_unique<TableEventHandler>(ui->point_table);
 
+  // Live mode: edits restart the timer, and the fit starts once they settle
+  live_timer.setSingleShot(true);
+  live_timer.setInterval(LIVE_DEBOUNCE_MS);
+  connect(&live_timer, &QTimer::timeout, this, &MainWindow::start_live_fit);
+  connect(ui->live_check, &QCheckBox::toggled, this, &MainWindow::set_live);
+  connect(ui->point_table, &QTableWidget::itemChanged, this,
+          &MainWindow::point_edited);
+  auto rows_changed = [this] {
+    live_rescan = true;
+    if (ui->live_check->isChecked()) {
+      live_timer.start();
+    }
+  };
+  auto const *model = ui->point_table->model();
+  connect(model, &QAbstractItemModel::rowsInserted, this, rows_changed);
+  connect(model, &QAbstractItemModel::rowsRemoved, this, rows_changed);
+
+  fit_options.nonlinear_refinement = true;
+  fit_options.selection = FitOptions::Selection::LeaveOneOut;
+
   QString html = R"(
 <!DOCTYPE html>
 <html>
@@ -38,12 +65,43 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 </body>
 </html>
 )";
-  ui->webview->setHtml(html);
+  plot = std::make_unique<LazyPlot>(ui->plot_host, ui->plot_placeholder, html);
+  plot->on_created([this] {
+    if (this->profile) {
+      this->profile->mark("plot created");
+    }
+  });
+  plot->on_ready([this] {
+    if (this->profile) {
+      this->profile->mark("plot ready");
+    }
+    emit plot_ready();
+  });
+}
+
+bool MainWindow::event(QEvent *event) {
+  auto handled = QMainWindow::event(event);
+  if (event->type() == QEvent::Paint && !painted) {
+    painted = true;
+    if (profile) {
+      profile->mark("first paint");
+    }
+    // Runs once the events queued behind the first paint are handled
+    QTimer::singleShot(0, this, [this] {
+      if (profile) {
+        profile->mark("interactive");
+      }
+      // Start QtWebEngine while the user looks at the window
+      QTimer::singleShot(0, this, [this] { plot->preload(); });
+    });
+  }
+  return handled;
 }
 
 void MainWindow::clear_points() {
   ui->point_table->setRowCount(0);
-  ui->webview->page()->runJavaScript("calculator.setBlank()");
+  plot->run("calculator.setBlank()");
+  plotted_points = 0;
 }
 
 void MainWindow::add_point() {
@@ -51,6 +109,7 @@ void MainWindow::add_point() {
   ui->point_table->setRowCount(row + 1);
   ui->point_table->setItem(row, 0, new QTableWidgetItem("0"));
   ui->point_table->setItem(row, 1, new QTableWidgetItem("0"));
+  ui->point_table->setItem(row, 2, new QTableWidgetItem("1"));
   ui->point_table->editItem(ui->point_table->item(row, 0));
 }
 
@@ -67,11 +126,14 @@ void MainWindow::load_file() {
     return;
   }
   auto lines = parser.getLines();
+  auto const &weights = parser.getWeights();
   ui->point_table->setRowCount(static_cast<int>(lines.size()));
   for (int i = 0; i < lines.size(); i++) {
     auto [x, y] = lines[i];
     ui->point_table->setItem(i, 0, new QTableWidgetItem(x));
     ui->point_table->setItem(i, 1, new QTableWidgetItem(y));
+    ui->point_table->setItem(
+        i, 2, new QTableWidgetItem(weights.empty() ? "1" : weights[i]));
   }
   QMessageBox::information(this, "File loaded", "File loaded successfully.");
 }
@@ -89,38 +151,48 @@ void MainWindow::calculate() {
   std::vector<double> y;
   y.reserve(ui->point_table->rowCount());
 
-  ui->webview->page()->runJavaScript("calculator.setBlank()");
+  std::vector<double> w;
+  w.reserve(ui->point_table->rowCount());
+
+  plot->run("calculator.setBlank()");
+  last_result.reset();
 
   // Draw points on graph
   for (int i = 0; i < ui->point_table->rowCount(); i++) {
-    x.push_back(ui->point_table->item(i, 0)->text().toDouble());
-    y.push_back(ui->point_table->item(i, 1)->text().toDouble());
+    read_point(i, x.emplace_back(), y.emplace_back(), w.emplace_back());
     QString query =
         QString(
             "calculator.setExpression({ id: 'point%1', latex: '(%2, %3)' })")
             .arg(QString::number(i), QString::number(x[i]),
                  QString::number(y[i]));
-    ui->webview->page()->runJavaScript(query);
+    plot->run(query);
   }
-
-  // Calculation
-  auto n = ui->point_table->rowCount();
-
-  // Getting function
-  auto func = ApproximationCalculator::find_best_function(n, x, y);
-
-  auto calc = ApproximationCalculator(func, x, y);
-
-  auto coefficients = calc.calculate_coefficients();
-  auto phi_values = calc.get_phi_values();
-  auto eps_values = calc.get_epsilon_values();
-  auto [pearson_correlation, error] = calc.calculate_pearson_correlation();
+  plotted_points = ui->point_table->rowCount();
 
   QDateTime currentDateTime = QDateTime::currentDateTime();
   QString currentTimeString = currentDateTime.toString("yyyy-MM-dd hh:mm:ss");
   ui->result_output->append("<h3> Approximation result from " +
                             currentTimeString + ":</h3>");
 
+  if (ui->approx_check->isChecked()) {
+    calculate_sampled(std::move(x), std::move(y), std::move(w));
+    return;
+  }
+
+  // Calculation, reusing the result of an identical earlier one
+  auto key = FitCache::make_key(x, y, w, fit_options);
+  auto cached = fit_cache.find(key, x, y);
+  if (!cached) {
+    cached = ApproximationCalculator::fit_best_function(x, y, w, fit_options);
+    fit_cache.insert(key, *cached);
+  }
+  auto const &func = cached->function;
+  auto const &coefficients = cached->coefficients;
+  auto const &phi_values = cached->phi_values;
+  auto const &eps_values = cached->epsilon_values;
+  auto pearson_correlation = cached->pearson_correlation;
+  auto const &error = cached->error;
+
   if (!error.empty()) {
     ui->result_output->append("<b>" + QString::fromUtf8(error.c_str()) +
                               "</b>");
@@ -136,6 +208,11 @@ void MainWindow::calculate() {
   ui->result_output->append("<b>Pearson correlation:</b> " +
                             QString::number(pearson_correlation));
 
+  // The coefficients are of u, not of x, when the fit keeps a basis
+  if (func.has_basis()) {
+    ui->result_output->append(
+        "<b>Basis:</b> " + QString::fromUtf8(func.get_basis_string().c_str()));
+  }
   ui->result_output->append("<b>Coefficients:</b>");
   for (auto const &coefficient : coefficients) {
     ui->result_output->append(QString::number(coefficient));
@@ -154,8 +231,277 @@ void MainWindow::calculate() {
   }
 
   // Update graph
-  ui->webview->page()->runJavaScript(
+  plot->run(
+      QString("calculator.setExpression({ id: '%1', latex: "
+              "'%2', color: Desmos.Colors.BLUE })")
+          .arg("graph", func.get_string_function(coefficients).c_str()));
+  remember_result(*cached, std::move(x), std::move(y), std::move(w));
+}
+
+void MainWindow::calculate_sampled(std::vector<double> &&x,
+                                   std::vector<double> &&y,
+                                   std::vector<double> &&w) {
+  if (x.empty()) {
+    ui->result_output->append("<b>No points to approximate.</b>");
+    return;
+  }
+  SampledFitter::Budget budget;
+  budget.seconds = ui->time_budget_spin->value();
+  budget.tolerance = ui->tolerance_spin->value();
+  budget.confirm = ui->confirm_check->isChecked();
+  auto result = SampledFitter::fit(x, y, w, fit_options, budget);
+  auto const &func = result.function;
+  auto const &coefficients = result.coefficients;
+
+  ui->result_output->append(
+      "<b>Best matching function (sampled):</b> " +
+      QString::fromUtf8(func.to_string().c_str()) + " " +
+      QString::fromUtf8(func.get_string_function(coefficients).c_str()));
+
+  if (func.has_basis()) {
+    ui->result_output->append(
+        "<b>Basis:</b> " + QString::fromUtf8(func.get_basis_string().c_str()));
+  }
+  ui->result_output->append("<b>Coefficients:</b>");
+  for (std::size_t k = 0; k < coefficients.size(); ++k) {
+    ui->result_output->append(
+        QString::number(coefficients[k]) + " &plusmn; " +
+        QString::number(result.coefficient_errors[k]));
+  }
+
+  ui->result_output->append(
+      QString("<b>Sample:</b> %1 of %2 points, %3 round(s), %4")
+          .arg(result.sample_size)
+          .arg(result.population)
+          .arg(result.rounds)
+          .arg(result.converged ? "within tolerance" : "budget exhausted"));
+  ui->result_output->append("<b>Estimated RMS error:</b> " +
+                            QString::number(result.deviation) + " &plusmn; " +
+                            QString::number(result.deviation_error));
+  ui->result_output->append("<b>Curve standard error:</b> " +
+                            QString::number(result.curve_error));
+  if (result.confirmed) {
+    ui->result_output->append("<b>Exact RMS error:</b> " +
+                              QString::number(result.exact_deviation));
+    ui->result_output->append("<b>Exact max |epsilon|:</b> " +
+                              QString::number(result.exact_max_abs_epsilon));
+  }
+
+  // Update graph
+  plot->run(
       QString("calculator.setExpression({ id: '%1', latex: "
               "'%2', color: Desmos.Colors.BLUE })")
           .arg("graph", func.get_string_function(coefficients).c_str()));
-}
\ No newline at end of file
+  remember_result(result.to_fit_result(), std::move(x), std::move(y),
+                  std::move(w));
+}
+
+void MainWindow::remember_result(FitResult const &result,
+                                 std::vector<double> &&x,
+                                 std::vector<double> &&y,
+                                 std::vector<double> &&w) {
+  last_result = result;
+  last_x = std::move(x);
+  last_y = std::move(y);
+  last_w = std::move(w);
+}
+
+void MainWindow::export_results() {
+  if (!last_result) {
+    QMessageBox::warning(this, "Error", "Calculate a fit before exporting.");
+    return;
+  }
+  QString filter;
+  auto file_name = QFileDialog::getSaveFileName(
+      this, tr("Export Results"), ".",
+      tr("CSV (*.csv);;JSON Lines (*.jsonl);;Binary columns (*.bin)"),
+      &filter);
+  if (file_name.isEmpty()) {
+    return;
+  }
+  auto format = filter.startsWith("JSON")     ? ResultWriter::Format::JsonLines
+                : filter.startsWith("Binary") ? ResultWriter::Format::Binary
+                                              : ResultWriter::Format::Csv;
+  ResultWriter writer(file_name.toStdString(), format);
+  if (!writer.write(*last_result, last_x, last_y, last_w)) {
+    QMessageBox::critical(this, "Error writing file",
+                          QString::fromStdString(writer.error()));
+    return;
+  }
+  ui->statusbar->showMessage(
+      QString("Exported %1 points to %2").arg(last_x.size()).arg(file_name));
+}
+
+void MainWindow::read_point(int row, double &x, double &y, double &w) const {
+  auto const *x_item = ui->point_table->item(row, 0);
+  auto const *y_item = ui->point_table->item(row, 1);
+  x = x_item ? x_item->text().toDouble() : 0.0;
+  y = y_item ? y_item->text().toDouble() : 0.0;
+  bool ok = false;
+  auto const *weight_item = ui->point_table->item(row, 2);
+  auto weight = weight_item ? weight_item->text().toDouble(&ok) : 1.0;
+  w = ok && weight >= 0.0 ? weight : 1.0;
+}
+
+void MainWindow::set_live(bool enabled) {
+  // Results of earlier snapshots are dropped when they arrive
+  ++live_generation;
+  if (!enabled) {
+    live_timer.stop();
+    return;
+  }
+  if (!live_worker) {
+    live_worker = std::make_unique<LiveFitWorker>(
+        fit_options, [this](LiveFitWorker::Request &&request,
+                            FitResult &&result, double fit_ms) {
+          // Runs on the worker thread; the fit is shown on the GUI thread
+          QMetaObject::invokeMethod(
+              this,
+              [this, request = std::move(request),
+               result = std::move(result), fit_ms] {
+                fit_cache.insert(FitCache::make_key(request.x, request.y,
+                                                    request.w, fit_options),
+                                 result);
+                apply_live_fit(request, result, fit_ms);
+              },
+              Qt::QueuedConnection);
+        });
+  }
+  live_rescan = true;
+  live_timer.start();
+}
+
+void MainWindow::point_edited(QTableWidgetItem *item) {
+  if (!ui->live_check->isChecked()) {
+    return;
+  }
+  auto row = item->row();
+  if (!live_rescan && row < static_cast<int>(live_x.size())) {
+    double x, y, w;
+    read_point(row, x, y, w);
+    if (x == live_x[row] && y == live_y[row] && w == live_w[row]) {
+      return;
+    }
+    live_x[row] = x;
+    live_y[row] = y;
+    live_w[row] = w;
+    live_edited.push_back(row);
+  } else {
+    live_rescan = true;
+  }
+  live_timer.start();
+}
+
+void MainWindow::start_live_fit() {
+  live_start = std::chrono::steady_clock::now();
+  if (live_rescan) {
+    auto rows = ui->point_table->rowCount();
+    live_x.resize(rows);
+    live_y.resize(rows);
+    live_w.resize(rows);
+    for (int i = 0; i < rows; i++) {
+      read_point(i, live_x[i], live_y[i], live_w[i]);
+    }
+    live_rescan = false;
+    live_replot = true;
+    live_edited.clear();
+  }
+  live_stale.insert(live_stale.end(), live_edited.begin(), live_edited.end());
+  live_edited.clear();
+
+  LiveFitWorker::Request request{++live_generation, live_x, live_y, live_w};
+  if (request.x.size() < 2) {
+    apply_live_fit(request, FitResult{}, 0.0);
+    return;
+  }
+  auto key = FitCache::make_key(live_x, live_y, live_w, fit_options);
+  if (auto cached = fit_cache.find(key, live_x, live_y)) {
+    apply_live_fit(request, *cached, 0.0);
+    return;
+  }
+  live_worker->submit(std::move(request));
+}
+
+void MainWindow::apply_live_fit(LiveFitWorker::Request const &request,
+                                FitResult const &result, double fit_ms) {
+  if (request.generation != live_generation) {
+    return;
+  }
+  auto n = static_cast<int>(request.x.size());
+
+  // One script for the whole refresh, with only the changed points
+  QStringList expressions;
+  auto add_point = [&](int i) {
+    expressions << QString("{ id: 'point%1', latex: '(%2, %3)' }")
+                       .arg(QString::number(i), QString::number(request.x[i]),
+                            QString::number(request.y[i]));
+  };
+  if (live_replot) {
+    for (int i = 0; i < n; i++) {
+      add_point(i);
+    }
+  } else {
+    std::sort(live_stale.begin(), live_stale.end());
+    live_stale.erase(std::unique(live_stale.begin(), live_stale.end()),
+                     live_stale.end());
+    for (auto row : live_stale) {
+      if (row < n) {
+        add_point(row);
+      }
+    }
+  }
+  live_replot = false;
+  live_stale.clear();
+
+  QString script;
+  if (plotted_points > n) {
+    QStringList removed;
+    for (int i = n; i < plotted_points; i++) {
+      removed << QString("{ id: 'point%1' }").arg(i);
+    }
+    script += "calculator.removeExpressions([" + removed.join(", ") + "]);";
+  }
+  plotted_points = n;
+  auto const &func = result.function;
+  if (n < 2) {
+    script += "calculator.removeExpression({ id: 'graph' });";
+  } else {
+    expressions << QString("{ id: 'graph', latex: '%1', "
+                           "color: Desmos.Colors.BLUE }")
+                       .arg(func.get_string_function(result.coefficients)
+                                .c_str());
+  }
+  script += "calculator.setExpressions([" + expressions.join(", ") + "]);";
+  plot->run(script);
+
+  std::chrono::duration<double, std::milli> latency =
+      std::chrono::steady_clock::now() - live_start;
+  live_latency.record(latency.count() * 1000.0);
+  ++live_refreshes;
+  if (latency.count() > LIVE_BUDGET_MS) {
+    ++live_misses;
+    qDebug() << "Live fit missed the" << LIVE_BUDGET_MS
+             << "ms budget:" << latency.count() << "ms for" << n
+             << "points, fitting took" << fit_ms << "ms";
+  }
+
+  QString summary =
+      n < 2 ? QString("Live: too few points")
+      : result.error.empty()
+          ? QString("Live: %1, RMS error %2")
+                .arg(QString::fromUtf8(func.to_string().c_str()))
+                .arg(result.deviation)
+          : QString("Live: %1").arg(QString::fromUtf8(result.error.c_str()));
+  ui->statusbar->showMessage(
+      summary +
+      QString(" | %1 points in %2 ms (fit %3 ms), p99 %4 ms, %5 of %6 over "
+              "%7 ms, %8 discarded")
+          .arg(n)
+          .arg(latency.count(), 0, 'f', 1)
+          .arg(fit_ms, 0, 'f', 1)
+          .arg(live_latency.percentile(0.99) / 1000.0, 0, 'f', 1)
+          .arg(live_misses)
+          .arg(live_refreshes)
+          .arg(LIVE_BUDGET_MS)
+          .arg(live_worker ? live_worker->discarded_requests() : 0));
+}
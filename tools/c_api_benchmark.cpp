@@ -0,0 +1,198 @@
+/**
+ * @file c_api_benchmark.cpp
+ * @brief Compares the throughput of the C API in liblab3_fit with the
+ * command line.
+ *
+ * The same random series are fitted one call at a time through a reused
+ * handle, in one lab3_fit_batch call, and, given the path of lab3_cpp, by
+ * running lab3_cpp --fit on a point file per series, which is how services
+ * used the engine before the library existed. Only the C header is used, so
+ * the benchmark also checks that the library links as a C ABI.
+ */
+
+#include "lab3_fit.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Settings {
+  int series{1000};
+  int points{100};
+  int workers{0};
+  std::string cli;
+  int cli_runs{20};
+};
+
+struct Data {
+  std::vector<std::vector<double>> x;
+  std::vector<std::vector<double>> y;
+  std::vector<lab3_series> series;
+};
+
+Data make_data(Settings const &settings) {
+  std::mt19937_64 random(42);
+  std::uniform_real_distribution<double> slope(0.5, 2.0);
+  std::normal_distribution<double> noise(0.0, 0.05);
+  Data data;
+  data.x.resize(settings.series);
+  data.y.resize(settings.series);
+  for (int s = 0; s < settings.series; ++s) {
+    auto a = slope(random);
+    for (int i = 0; i < settings.points; ++i) {
+      auto x = 1.0 + 0.1 * i;
+      data.x[s].push_back(x);
+      // Alternate the shapes so that model selection has work to do
+      data.y[s].push_back((s % 2 == 0 ? a * x : std::exp(0.1 * a * x)) *
+                          (1.0 + noise(random)));
+    }
+  }
+  for (int s = 0; s < settings.series; ++s) {
+    data.series.push_back({data.x[s].data(), data.y[s].data(), nullptr,
+                           static_cast<size_t>(settings.points)});
+  }
+  return data;
+}
+
+void report(char const *name, int series, int points, double seconds) {
+  std::printf("%-10s %12.1f series/s %10.2f Mpoints/s %10.1f us/series\n",
+              name, series / seconds,
+              static_cast<double>(series) * points / seconds / 1e6,
+              seconds / series * 1e6);
+}
+
+bool write_point_file(std::string const &path, lab3_series const &series) {
+  auto *file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    return false;
+  }
+  for (auto const *values : {series.x, series.y}) {
+    for (size_t i = 0; i < series.n; ++i) {
+      std::fprintf(file, i == 0 ? "%.17g" : " %.17g", values[i]);
+    }
+    std::fputc('\n', file);
+  }
+  return std::fclose(file) == 0;
+}
+
+void print_usage() {
+  std::fprintf(stderr,
+               "Usage: c_api_benchmark [--series S] [--points P] "
+               "[--workers N]\n"
+               "                       [--cli PATH] [--cli-runs K]\n"
+               "\n"
+               "  --series S    Series to fit (default 1000)\n"
+               "  --points P    Points per series (default 100)\n"
+               "  --workers N   Threads of lab3_fit_batch (default: all)\n"
+               "  --cli PATH    Also time PATH --fit on the first K series\n"
+               "  --cli-runs K  Series fitted by the command line "
+               "(default 20)\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Settings settings;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    if (i + 1 >= argc) {
+      print_usage();
+      return 2;
+    }
+    if (argument == "--series") {
+      settings.series = std::atoi(argv[++i]);
+    } else if (argument == "--points") {
+      settings.points = std::atoi(argv[++i]);
+    } else if (argument == "--workers") {
+      settings.workers = std::atoi(argv[++i]);
+    } else if (argument == "--cli") {
+      settings.cli = argv[++i];
+    } else if (argument == "--cli-runs") {
+      settings.cli_runs = std::atoi(argv[++i]);
+    } else {
+      print_usage();
+      return 2;
+    }
+  }
+  if (settings.series < 1 || settings.points < 4 || settings.workers < 0 ||
+      settings.cli_runs < 1) {
+    print_usage();
+    return 2;
+  }
+
+  auto data = make_data(settings);
+  auto *fit = lab3_fit_create();
+  if (!fit) {
+    return 1;
+  }
+  lab3_fit_set_option(fit, LAB3_OPTION_WORKERS, settings.workers);
+  std::printf("liblab3_fit %s, %d series of %d points\n", lab3_fit_version(),
+              settings.series, settings.points);
+
+  // Warm up the handle so that its buffers have grown
+  std::vector<lab3_fit_result> single(settings.series);
+  lab3_fit_best(fit, &data.series[0], &single[0]);
+
+  auto start = Clock::now();
+  for (int s = 0; s < settings.series; ++s) {
+    if (auto status = lab3_fit_best(fit, &data.series[s], &single[s]);
+        status != LAB3_OK) {
+      std::fprintf(stderr, "lab3_fit_best: %s\n", lab3_fit_error(fit));
+      return 1;
+    }
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  report("single", settings.series, settings.points, elapsed.count());
+
+  std::vector<lab3_fit_result> batch(settings.series);
+  start = Clock::now();
+  if (lab3_fit_batch(fit, data.series.data(), data.series.size(),
+                     batch.data()) != LAB3_OK) {
+    std::fprintf(stderr, "lab3_fit_batch: %s\n", lab3_fit_error(fit));
+    return 1;
+  }
+  elapsed = Clock::now() - start;
+  report("batch", settings.series, settings.points, elapsed.count());
+
+  for (int s = 0; s < settings.series; ++s) {
+    if (batch[s].type != single[s].type ||
+        batch[s].coefficients[0] != single[s].coefficients[0]) {
+      std::fprintf(stderr, "series %d: batch and single fits differ\n", s);
+      return 1;
+    }
+  }
+  lab3_fit_destroy(fit);
+
+  if (!settings.cli.empty()) {
+    auto runs = std::min(settings.cli_runs, settings.series);
+    std::string path = "c_api_benchmark_points.txt";
+    elapsed = {};
+    for (int s = 0; s < runs; ++s) {
+      // Writing the file is part of what a service had to do, too
+      start = Clock::now();
+      if (!write_point_file(path, data.series[s])) {
+        std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        return 1;
+      }
+      auto command = "\"" + settings.cli + "\" --fit " + path + " >/dev/null 2>&1";
+      if (std::system(command.c_str()) != 0) {
+        std::fprintf(stderr, "%s failed\n", command.c_str());
+        std::remove(path.c_str());
+        return 1;
+      }
+      elapsed += Clock::now() - start;
+    }
+    std::remove(path.c_str());
+    report("cli", runs, settings.points, elapsed.count());
+  }
+  return 0;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file fit_load_generator.cpp
+ * @brief Benchmarks the fitting service started with lab3_cpp --serve.
+ *
+ * Every connection runs in its own thread and keeps up to --pipeline
+ * requests in flight. Latency is measured per request from the write to the
+ * matching response line; the throughput, the latency distribution and the
+ * service's own metrics are printed at the end.
+ */
+
+#include "latency_recorder.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Settings {
+  std::string socket_path;
+  int connections{4};
+  int requests{1000};
+  int points{100};
+  int pipeline{8};
+  int distinct{0};
+};
+
+struct Outcome {
+  std::vector<double> latencies;
+  int errors{0};
+  bool failed{false};
+};
+
+int connect_to(std::string const &path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof address.sun_path) {
+    return -1;
+  }
+  std::strcpy(address.sun_path, path.c_str());
+  auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                           sizeof address) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool write_all(int fd, std::string const &data) {
+  std::size_t offset = 0;
+  while (offset < data.size()) {
+    auto count = ::write(fd, data.data() + offset, data.size() - offset);
+    if (count <= 0) {
+      return false;
+    }
+    offset += static_cast<std::size_t>(count);
+  }
+  return true;
+}
+
+/**
+ * Builds a request whose data set is determined by its index, so repeated
+ * data sets (--distinct) produce identical lines.
+ */
+std::string make_request(long id, long data_set, int points) {
+  std::mt19937_64 random(static_cast<std::uint64_t>(data_set));
+  std::normal_distribution<double> noise(0.0, 0.05);
+  auto a = 1.0 + static_cast<double>(data_set % 7);
+  auto b = 0.1 * static_cast<double>(data_set % 5 + 1);
+  std::string x = "[";
+  std::string y = "[";
+  for (int i = 0; i < points; ++i) {
+    auto t = 1.0 + 0.1 * i;
+    auto value = data_set % 2 == 0 ? a * std::pow(t, b) : a + b * t * t;
+    x += (i ? "," : "") + std::to_string(t);
+    y += (i ? "," : "") + std::to_string(value + noise(random));
+  }
+  return "{\"id\":" + std::to_string(id) + ",\"x\":" + x + "],\"y\":" + y +
+         "]}\n";
+}
+
+void run_connection(Settings const &settings, int connection,
+                    Outcome &outcome) {
+  auto fd = connect_to(settings.socket_path);
+  if (fd < 0) {
+    outcome.failed = true;
+    return;
+  }
+  std::unordered_map<long, Clock::time_point> sent_at;
+  std::string pending;
+  char buffer[64 * 1024];
+  long sent = 0;
+  long received = 0;
+  while (received < settings.requests) {
+    while (sent < settings.requests &&
+           sent - received < settings.pipeline) {
+      auto id = static_cast<long>(connection) * settings.requests + sent;
+      auto data_set = settings.distinct > 0 ? id % settings.distinct : id;
+      auto line = make_request(id, data_set, settings.points);
+      sent_at[id] = Clock::now();
+      if (!write_all(fd, line)) {
+        outcome.failed = true;
+        ::close(fd);
+        return;
+      }
+      ++sent;
+    }
+    auto count = ::read(fd, buffer, sizeof buffer);
+    if (count <= 0) {
+      outcome.failed = true;
+      break;
+    }
+    pending.append(buffer, static_cast<std::size_t>(count));
+    std::size_t start = 0;
+    for (auto end = pending.find('\n'); end != std::string::npos;
+         end = pending.find('\n', start)) {
+      auto now = Clock::now();
+      auto line = pending.substr(start, end - start);
+      start = end + 1;
+      auto id = std::strtol(line.c_str() + std::strlen("{\"id\":"), nullptr,
+                            10);
+      if (auto it = sent_at.find(id); it != sent_at.end()) {
+        std::chrono::duration<double, std::micro> latency = now - it->second;
+        outcome.latencies.push_back(latency.count());
+        sent_at.erase(it);
+      }
+      if (line.find("\"error\"") != std::string::npos) {
+        ++outcome.errors;
+      }
+      ++received;
+    }
+    pending.erase(0, start);
+  }
+  ::close(fd);
+}
+
+std::string query_metrics(std::string const &path) {
+  auto fd = connect_to(path);
+  if (fd < 0 || !write_all(fd, "{\"id\":\"metrics\",\"metrics\":true}\n")) {
+    return "unavailable";
+  }
+  std::string response;
+  char c;
+  while (::read(fd, &c, 1) == 1 && c != '\n') {
+    response += c;
+  }
+  ::close(fd);
+  return response;
+}
+
+void print_usage() {
+  std::cerr << "Usage: fit_load_generator SOCKET [--connections C] "
+               "[--requests N] [--points P]\n"
+               "                          [--pipeline D] [--distinct K]\n"
+               "\n"
+               "  --connections C  Concurrent connections (default 4)\n"
+               "  --requests N     Requests per connection (default 1000)\n"
+               "  --points P       Data points per request (default 100)\n"
+               "  --pipeline D     Requests in flight per connection "
+               "(default 8)\n"
+               "  --distinct K     Cycle through K data sets to exercise the "
+               "cache\n"
+               "                   (default 0: every request is distinct)\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Settings settings;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    auto number = [&](int &out) {
+      if (i + 1 >= argc) {
+        return false;
+      }
+      out = std::atoi(argv[++i]);
+      return true;
+    };
+    auto ok = true;
+    if (argument == "--connections") {
+      ok = number(settings.connections);
+    } else if (argument == "--requests") {
+      ok = number(settings.requests);
+    } else if (argument == "--points") {
+      ok = number(settings.points);
+    } else if (argument == "--pipeline") {
+      ok = number(settings.pipeline);
+    } else if (argument == "--distinct") {
+      ok = number(settings.distinct);
+    } else if (argument[0] != '-' && settings.socket_path.empty()) {
+      settings.socket_path = argument;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      print_usage();
+      return 2;
+    }
+  }
+  if (settings.socket_path.empty() || settings.connections < 1 ||
+      settings.requests < 1 || settings.points < 2 || settings.pipeline < 1) {
+    print_usage();
+    return 2;
+  }
+
+  std::vector<Outcome> outcomes(settings.connections);
+  std::vector<std::thread> threads;
+  auto start = Clock::now();
+  for (int c = 0; c < settings.connections; ++c) {
+    threads.emplace_back(run_connection, std::cref(settings), c,
+                         std::ref(outcomes[c]));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  LatencyRecorder latencies;
+  auto errors = 0;
+  auto failed = 0;
+  for (auto const &outcome : outcomes) {
+    for (auto latency : outcome.latencies) {
+      latencies.record(latency);
+    }
+    errors += outcome.errors;
+    failed += outcome.failed;
+  }
+  std::cout << latencies.count() << " responses (" << errors << " errors, "
+            << failed << " failed connections) in " << elapsed.count()
+            << " s, " << static_cast<double>(latencies.count()) /
+                             elapsed.count()
+            << " requests/s\n"
+            << "client latency: " << latencies.summary() << "\n"
+            << "service metrics: " << query_metrics(settings.socket_path)
+            << "\n";
+  return failed == 0 ? 0 : 1;
+}
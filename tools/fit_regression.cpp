@@ -0,0 +1,830 @@
+/**
+ * @file fit_regression.cpp
+ * @brief Checks changes to ApproximationCalculator for both speed and
+ * correctness on a fixed corpus of synthetic data sets.
+ *
+ * The corpus crosses every Function::Type with several x ranges, some of
+ * them pathological, noise levels and sizes from 8 points (like input.txt)
+ * to 10^8. Every data set is a pure function of its name: x and the noise
+ * come from a counter-based generator seeded with a hash of the name, so
+ * adding cases does not change the others and all machines see the same
+ * points.
+ *
+ *   fit_regression generate DIR   writes the data sets as point files
+ *   fit_regression run OUT.tsv    fits every data set and records the
+ *                                 time, peak memory, chosen model and
+ *                                 coefficient and curve errors
+ *   fit_regression compare A B    flags cases of run B that are slower,
+ *                                 larger or less accurate than in run A
+ *   fit_regression rolling OUT.tsv
+ *                                 streams every data set through the
+ *                                 rolling window fitter and compares the
+ *                                 fit of its last window with a fit of the
+ *                                 same function from scratch
+ *
+ * Each case runs in a child process, so the peak memory is its own and a
+ * crash or timeout only fails that case. Since every range sees the same
+ * curve, run also fails cases whose fitted curve is far further from the
+ * true one than the noise explains.
+ */
+
+#include "calculator.hpp"
+#include "counter_random.hpp"
+#include "fit_options.hpp"
+#include "math_function.hpp"
+#include "rolling_window.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint64_t SEED = 0x1AB3C0DE5EEDULL;
+
+/**
+ * A fit of the right family misses the true curve by about the noise level
+ * times sqrt(p / n), so a curve error above twice the noise level (plus the
+ * rounding of noiseless fits) means the fit is broken, not just noisy.
+ */
+constexpr double NOISE_ALLOWANCE = 2.0;
+constexpr double ROUNDING_ALLOWANCE = 1e-6;
+
+/**
+ * @brief A ground-truth model in terms of u = (t - t_lo) / (t_hi - t_lo),
+ * where t is ln x for logarithmic and power models and x otherwise, so that
+ * u runs over [0, 1] and every range sees the same curve shape. The
+ * exponential and power models are a0 * exp(a1 * u).
+ */
+struct Model {
+  char const *name;
+  Function function;
+  std::vector<double> coefficients;
+};
+
+struct Range {
+  char const *name;
+  double lo;
+  double hi;
+  bool log_spaced; /**< Spread x evenly in log space. */
+  bool clustered;  /**< Put half of the points on lo. */
+};
+
+struct Case {
+  std::string id;
+  Model const *model;
+  Range const *range;
+  double noise; /**< Relative standard deviation of the noise. */
+  std::size_t points;
+};
+
+std::vector<Model> const &models() {
+  static std::vector<Model> const list = {
+      {"poly1", Function(Function::Type::Polynomial, 1), {2.0, 3.0}},
+      {"poly2", Function(Function::Type::Polynomial, 2), {1.0, -2.0, 4.0}},
+      {"poly3",
+       Function(Function::Type::Polynomial, 3),
+       {0.5, 1.0, -3.0, 2.5}},
+      {"exp", Function(Function::Type::Exponential), {1.5, 2.0}},
+      {"log", Function(Function::Type::Logarithmic), {3.0, 1.0}},
+      {"power", Function(Function::Type::Power), {2.0, 1.5}},
+  };
+  return list;
+}
+
+std::vector<Range> const &ranges() {
+  static std::vector<Range> const list = {
+      {"unit", 1.0, 10.0, false, false},
+      {"offset", 1e9, 1e9 + 10.0, false, false}, // timestamps
+      {"tiny", 1e-6, 1e-5, false, false},
+      {"wide", 1e-3, 1e4, true, false},
+      {"negative", -10.0, -1.0, false, false},
+      {"clustered", 1.0, 10.0, false, true},
+  };
+  return list;
+}
+
+bool is_defined(Model const &model, Range const &range) {
+  auto type = model.function.get_type();
+  return range.lo > 0.0 || (type != Function::Type::Logarithmic &&
+                            type != Function::Type::Power);
+}
+
+std::string format_noise(double noise) {
+  std::ostringstream ss;
+  ss << noise;
+  return ss.str();
+}
+
+/**
+ * @brief Builds the corpus: every model, range and noise level at 8, 10^3
+ * and 10^5 points, every model and range at 10^6 points with 1% noise, and
+ * every model on the unit range at 10^8 points with 1% noise.
+ */
+std::vector<Case> corpus() {
+  std::vector<Case> cases;
+  auto add = [&](Model const &model, Range const &range, double noise,
+                 std::size_t points) {
+    auto id = std::string(model.name) + "-" + range.name + "-n" +
+              std::to_string(points) + "-e" + format_noise(noise);
+    cases.push_back({id, &model, &range, noise, points});
+  };
+  for (auto const &model : models()) {
+    for (auto const &range : ranges()) {
+      if (!is_defined(model, range)) {
+        continue;
+      }
+      for (auto points : {std::size_t{8}, std::size_t{1000},
+                          std::size_t{100000}}) {
+        for (auto noise : {0.0, 0.01, 0.1}) {
+          add(model, range, noise, points);
+        }
+      }
+      add(model, range, 0.01, 1000000);
+    }
+    add(model, ranges()[0], 0.01, 100000000);
+  }
+  return cases;
+}
+
+bool uses_log_x(Model const &model) {
+  auto type = model.function.get_type();
+  return type == Function::Type::Logarithmic || type == Function::Type::Power;
+}
+
+/**
+ * @brief The start and width of the range of t, so that
+ * t = start + width * u.
+ */
+std::pair<double, double> variable_range(Case const &c) {
+  auto const &range = *c.range;
+  if (uses_log_x(*c.model)) {
+    return {std::log(range.lo), std::log1p((range.hi - range.lo) / range.lo)};
+  }
+  return {range.lo, range.hi - range.lo};
+}
+
+/**
+ * @brief The model variable u at x, computed without forming t for ln x so
+ * that narrow ranges far from the origin keep their digits.
+ */
+double model_variable(Case const &c, double x) {
+  auto const &range = *c.range;
+  auto width = variable_range(c).second;
+  if (uses_log_x(*c.model)) {
+    return std::log1p((x - range.lo) / range.lo) / width;
+  }
+  return (x - range.lo) / width;
+}
+
+double true_value(Case const &c, double x) {
+  auto u = model_variable(c, x);
+  auto const &a = c.model->coefficients;
+  switch (c.model->function.get_type()) {
+  case Function::Type::Polynomial:
+  case Function::Type::Logarithmic: {
+    auto sum = 0.0;
+    for (auto k = a.size(); k-- > 0;) {
+      sum = sum * u + a[k];
+    }
+    return sum;
+  }
+  case Function::Type::Exponential:
+  case Function::Type::Power:
+    return a[0] * std::exp(a[1] * u);
+  }
+  return NAN;
+}
+
+/**
+ * @brief Converts fitted coefficients from the basis of the fit to the model
+ * variable u, where they compare with the true ones.
+ */
+std::vector<double> fitted_coefficients(Case const &c,
+                                        FitResult const &result) {
+  auto [start, width] = variable_range(c);
+  return result.function.rebase(result.coefficients, start, width);
+}
+
+std::uint64_t hash_of(std::string const &text) {
+  auto h = 0xCBF29CE484222325ULL;
+  for (auto c : text) {
+    h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3ULL;
+  }
+  return h;
+}
+
+/**
+ * @brief Generates the points of a case; truth receives the noiseless y.
+ */
+void generate(Case const &c, std::vector<double> &x, std::vector<double> &y,
+              std::vector<double> &truth) {
+  CounterRandom random(SEED, hash_of(c.id));
+  auto n = c.points;
+  auto const &range = *c.range;
+  x.resize(n);
+  y.resize(n);
+  truth.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    // Stratified positions: one point at a random place in each of n cells
+    auto t = (static_cast<double>(i) + random.unit_at(2 * n + i)) /
+             static_cast<double>(n);
+    if (range.clustered && i % 2 == 0) {
+      x[i] = range.lo;
+    } else if (range.log_spaced) {
+      x[i] = range.lo * std::pow(range.hi / range.lo, t);
+    } else {
+      x[i] = range.lo + (range.hi - range.lo) * t;
+    }
+    truth[i] = true_value(c, x[i]);
+    // Box-Muller
+    auto u1 = 1.0 - random.unit_at(2 * i);
+    auto u2 = random.unit_at(2 * i + 1);
+    auto gauss = std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+    y[i] = truth[i] * (1.0 + c.noise * gauss);
+  }
+}
+
+/**
+ * @brief The largest difference of the coefficients in the model variable
+ * relative to the largest true one, or NAN if the fitted function is of
+ * another type.
+ */
+double coefficient_error(Case const &c, FitResult const &result) {
+  if (result.function.get_type() != c.model->function.get_type()) {
+    return NAN;
+  }
+  auto truth = c.model->coefficients;
+  auto fitted = fitted_coefficients(c, result);
+  auto size = std::max(truth.size(), fitted.size());
+  truth.resize(size, 0.0);
+  fitted.resize(size, 0.0);
+  auto difference = 0.0;
+  auto magnitude = 0.0;
+  for (std::size_t k = 0; k < size; ++k) {
+    difference = std::max(difference, std::fabs(fitted[k] - truth[k]));
+    magnitude = std::max(magnitude, std::fabs(truth[k]));
+  }
+  return difference / magnitude;
+}
+
+/**
+ * @brief The RMS distance of the fitted curve from the true one relative to
+ * the RMS of the true curve.
+ */
+double curve_error(std::vector<double> const &phi,
+                   std::vector<double> const &truth) {
+  auto difference = 0.0L;
+  auto magnitude = 0.0L;
+  for (std::size_t i = 0; i < truth.size(); ++i) {
+    auto d = static_cast<long double>(phi[i]) - truth[i];
+    difference += d * d;
+    magnitude += static_cast<long double>(truth[i]) * truth[i];
+  }
+  return static_cast<double>(std::sqrt(difference / magnitude));
+}
+
+double peak_megabytes() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0);
+#else
+  return static_cast<double>(usage.ru_maxrss) / 1024.0;
+#endif
+}
+
+struct Settings {
+  FitOptions options;
+  std::size_t max_points{1000000};
+  std::string filter;
+  double min_time{0.2};
+  unsigned timeout{600};
+  double time_threshold{0.10};
+  double memory_threshold{0.10};
+  double accuracy_threshold{0.05};
+};
+
+/**
+ * @brief Fits a case in the current process and returns the result fields
+ * "status chosen seconds peak_mb coef_error curve_error"; the status is ok
+ * or inaccurate, and the peak memory includes the points themselves.
+ */
+std::string measure(Case const &c, Settings const &settings) {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> truth;
+  generate(c, x, y, truth);
+
+  // The fastest of as many fits as fit in min_time, at least one
+  FitResult result;
+  double best = INFINITY;
+  auto total = 0.0;
+  auto repeats = 0;
+  do {
+    auto start = Clock::now();
+    result =
+        ApproximationCalculator::fit_best_function(x, y, {}, settings.options);
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    best = std::min(best, elapsed.count());
+    total += elapsed.count();
+  } while (++repeats < 1000 && total < settings.min_time);
+
+  auto error = curve_error(result.phi_values, truth);
+  auto accurate = error <= NOISE_ALLOWANCE * c.noise + ROUNDING_ALLOWANCE;
+  std::ostringstream ss;
+  ss << std::setprecision(6) << (accurate ? "ok" : "inaccurate") << '\t'
+     << result.function.to_string() << '\t' << best << '\t'
+     << peak_megabytes() << '\t' << coefficient_error(c, result) << '\t'
+     << error;
+  return ss.str();
+}
+
+/**
+ * @brief Runs measure() in a child process with a timeout.
+ * @return The result fields, or the reason the child failed.
+ */
+std::string measure_isolated(Case const &c, Settings const &settings,
+                             bool &ok) {
+  ok = false;
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return "pipe failed";
+  }
+  auto pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return "fork failed";
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    alarm(settings.timeout);
+    std::string line;
+    try {
+      line = measure(c, settings);
+    } catch (std::exception const &e) {
+      line = std::string("error: ") + e.what();
+    }
+    auto written = write(fds[1], line.data(), line.size());
+    _exit(written == static_cast<ssize_t>(line.size()) ? 0 : 1);
+  }
+  close(fds[1]);
+  std::string line;
+  char buffer[4096];
+  for (ssize_t count; (count = read(fds[0], buffer, sizeof buffer)) > 0;) {
+    line.append(buffer, static_cast<std::size_t>(count));
+  }
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (WIFSIGNALED(status)) {
+    return WTERMSIG(status) == SIGALRM ? "timeout" : "crashed";
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+      line.rfind("error: ", 0) == 0) {
+    return line.empty() ? "failed" : line;
+  }
+  ok = true;
+  return line;
+}
+
+/**
+ * @brief Streams a case through a RollingWindowFitter over a quarter of its
+ * points and fits the function it chose to the last window from scratch.
+ * @return The result fields "status chosen curve_difference rms_difference",
+ * both differences relative to the RMS of y over the window; the status is
+ * ok or diverged.
+ */
+std::string measure_rolling(Case const &c) {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> truth;
+  generate(c, x, y, truth);
+  auto window = std::max<std::size_t>(c.points / 4, 4);
+  RollingWindowFitter fitter(window);
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    fitter.add(x[i], y[i]);
+  }
+  auto rolling = fitter.fit();
+  if (!rolling) {
+    return "diverged	-	nan	nan";
+  }
+
+  std::vector<double> window_x(x.end() - static_cast<long>(window), x.end());
+  std::vector<double> window_y(y.end() - static_cast<long>(window), y.end());
+  ApproximationCalculator calc(rolling->function.in_basis(0.0, 1.0),
+                               window_x, window_y);
+  calc.calculate_coefficients();
+  auto phi = calc.get_phi_values();
+  auto curve = 0.0L;
+  auto squares = 0.0L;
+  auto magnitude = 0.0L;
+  for (std::size_t i = 0; i < window; ++i) {
+    // Both candidate families are polynomials in the basis variable
+    auto u = rolling->function.basis_value(window_x[i]);
+    auto value = 0.0L;
+    for (auto k = rolling->coefficients.size(); k-- > 0;) {
+      value = value * u + rolling->coefficients[k];
+    }
+    auto d = value - phi[i];
+    auto epsilon = static_cast<long double>(window_y[i]) - phi[i];
+    curve += d * d;
+    squares += epsilon * epsilon;
+    magnitude += static_cast<long double>(window_y[i]) * window_y[i];
+  }
+  auto curve_difference = static_cast<double>(std::sqrt(curve / magnitude));
+  auto rms = std::sqrt(squares / window);
+  auto rms_difference = static_cast<double>(
+      std::fabs(rolling->deviation - rms) / std::sqrt(magnitude / window));
+  auto agrees = curve_difference <= ROUNDING_ALLOWANCE &&
+                rms_difference <= ROUNDING_ALLOWANCE;
+  std::ostringstream ss;
+  ss << std::setprecision(6) << (agrees ? "ok" : "diverged") << '\t'
+     << rolling->function.to_string() << '\t' << curve_difference << '\t'
+     << rms_difference;
+  return ss.str();
+}
+
+char const *selection_name(FitOptions::Selection selection) {
+  switch (selection) {
+  case FitOptions::Selection::InSample:
+    return "insample";
+  case FitOptions::Selection::LeaveOneOut:
+    return "loo";
+  case FitOptions::Selection::KFold:
+    return "kfold";
+  }
+  return "?";
+}
+
+int run_generate(std::string const &directory, Settings const &settings) {
+  mkdir(directory.c_str(), 0755);
+  std::ofstream manifest(directory + "/manifest.tsv");
+  if (!manifest) {
+    std::cerr << "cannot write " << directory << "/manifest.tsv\n";
+    return 1;
+  }
+  manifest << "case\tmodel\trange\tnoise\tpoints\tcoefficients\tstart\t"
+              "width\tfile\n";
+  manifest << std::setprecision(17);
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> truth;
+  for (auto const &c : corpus()) {
+    if (c.points > settings.max_points ||
+        c.id.find(settings.filter) == std::string::npos) {
+      continue;
+    }
+    generate(c, x, y, truth);
+    auto file = c.id + ".txt";
+    // The legacy format of input.txt: a line of x, then a line of y
+    std::ofstream out(directory + "/" + file);
+    out << std::setprecision(17);
+    for (auto const *values : {&x, &y}) {
+      for (std::size_t i = 0; i < values->size(); ++i) {
+        out << (i == 0 ? "" : " ") << (*values)[i];
+      }
+      out << '\n';
+    }
+    if (!out) {
+      std::cerr << "cannot write " << directory << "/" << file << "\n";
+      return 1;
+    }
+    manifest << c.id << '\t' << c.model->name << '\t' << c.range->name << '\t'
+             << c.noise << '\t' << c.points << '\t';
+    auto const &coefficients = c.model->coefficients;
+    for (std::size_t k = 0; k < coefficients.size(); ++k) {
+      manifest << (k == 0 ? "" : ",") << coefficients[k];
+    }
+    auto [start, width] = variable_range(c);
+    manifest << '\t' << start << '\t' << width << '\t' << file << '\n';
+  }
+  return 0;
+}
+
+int run_corpus(std::string const &path, Settings const &settings) {
+  std::ofstream out(path);
+  if (!out) {
+    std::cerr << "cannot write " << path << "\n";
+    return 1;
+  }
+  out << "# selection=" << selection_name(settings.options.selection)
+      << " refine=" << settings.options.nonlinear_refinement
+      << " max_points=" << settings.max_points << "\n"
+      << "case\tpoints\tstatus\tchosen\tseconds\tpeak_mb\tcoef_error\t"
+         "curve_error\n";
+  auto failures = 0;
+  for (auto const &c : corpus()) {
+    if (c.points > settings.max_points ||
+        c.id.find(settings.filter) == std::string::npos) {
+      continue;
+    }
+    bool ok;
+    auto fields = measure_isolated(c, settings, ok);
+    if (ok) {
+      out << c.id << '\t' << c.points << '\t' << fields << '\n';
+      ok = fields.rfind("ok\t", 0) == 0;
+    } else {
+      out << c.id << '\t' << c.points << '\t' << fields
+          << "\t-\tnan\tnan\tnan\tnan\n";
+    }
+    failures += !ok;
+    out.flush();
+    std::cerr << c.id << ": " << fields.substr(0, fields.find('\t'))
+              << "\n";
+  }
+  if (failures > 0) {
+    std::cerr << failures << " case(s) failed or missed the accuracy bound\n";
+  }
+  return out && failures == 0 ? 0 : 1;
+}
+
+int run_rolling(std::string const &path, Settings const &settings) {
+  std::ofstream out(path);
+  if (!out) {
+    std::cerr << "cannot write " << path << "\n";
+    return 1;
+  }
+  out << "case\tpoints\tstatus\tchosen\tcurve_difference\t"
+         "rms_difference\n";
+  auto failures = 0;
+  for (auto const &c : corpus()) {
+    if (c.points > settings.max_points ||
+        c.id.find(settings.filter) == std::string::npos) {
+      continue;
+    }
+    auto fields = measure_rolling(c);
+    out << c.id << '\t' << c.points << '\t' << fields << '\n';
+    failures += fields.rfind("ok\t", 0) != 0;
+    out.flush();
+    std::cerr << c.id << ": " << fields.substr(0, fields.find('\t'))
+              << "\n";
+  }
+  if (failures > 0) {
+    std::cerr << failures << " case(s) diverged from the fit from scratch\n";
+  }
+  return out && failures == 0 ? 0 : 1;
+}
+
+struct Record {
+  std::string status;
+  std::string chosen;
+  double seconds{NAN};
+  double peak_mb{NAN};
+  double coef_error{NAN};
+  double curve_error{NAN};
+};
+
+bool load_run(std::string const &path, std::string &options,
+              std::map<std::string, Record> &run) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "cannot read " << path << "\n";
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind("# ", 0) == 0) {
+      options = line.substr(2);
+      continue;
+    }
+    if (line.empty() || line.rfind("case\t", 0) == 0) {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string id;
+    std::string points;
+    Record record;
+    std::string numbers[4];
+    std::getline(fields, id, '\t');
+    std::getline(fields, points, '\t');
+    std::getline(fields, record.status, '\t');
+    std::getline(fields, record.chosen, '\t');
+    for (auto &number : numbers) {
+      std::getline(fields, number, '\t');
+    }
+    record.seconds = std::strtod(numbers[0].c_str(), nullptr);
+    record.peak_mb = std::strtod(numbers[1].c_str(), nullptr);
+    record.coef_error = std::strtod(numbers[2].c_str(), nullptr);
+    record.curve_error = std::strtod(numbers[3].c_str(), nullptr);
+    run[id] = record;
+  }
+  return true;
+}
+
+/**
+ * @brief Checks whether an error grew beyond the threshold; errors at the
+ * level of rounding (below 1e-9) are not compared.
+ */
+bool is_less_accurate(double base, double now, double threshold) {
+  if (std::isnan(base)) {
+    return false;
+  }
+  if (std::isnan(now)) {
+    return true;
+  }
+  return now > 1e-9 && now > base * (1.0 + threshold) + 1e-12;
+}
+
+int run_compare(std::string const &base_path, std::string const &new_path,
+                Settings const &settings) {
+  std::map<std::string, Record> base;
+  std::map<std::string, Record> now;
+  std::string base_options;
+  std::string new_options;
+  if (!load_run(base_path, base_options, base) ||
+      !load_run(new_path, new_options, now)) {
+    return 2;
+  }
+  if (base_options != new_options) {
+    std::cout << "warning: the runs used different options (" << base_options
+              << " and " << new_options << ")\n";
+  }
+  auto regressions = 0;
+  auto compared = 0;
+  auto unmatched = 0;
+  auto log_ratio = 0.0;
+  auto flag = [&](std::string const &id, char const *what,
+                  std::string const &detail) {
+    ++regressions;
+    std::cout << std::left << std::setw(36) << id << std::setw(10) << what
+              << detail << "\n";
+  };
+  auto change = [](double from, double to) {
+    std::ostringstream ss;
+    ss << std::setprecision(4) << from << " -> " << to;
+    if (from > 0.0) {
+      ss << std::showpos << std::fixed << std::setprecision(1) << " ("
+         << (to / from - 1.0) * 100.0 << "%)";
+    }
+    return ss.str();
+  };
+  for (auto const &[id, old] : base) {
+    auto it = now.find(id);
+    if (it == now.end()) {
+      // Runs with another --filter or --max-points cover other cases
+      ++unmatched;
+      continue;
+    }
+    auto const &record = it->second;
+    if (old.status == "ok" && record.status != "ok") {
+      flag(id, "failed", record.status);
+      continue;
+    }
+    if (old.status != "ok" || record.status != "ok") {
+      continue;
+    }
+    ++compared;
+    log_ratio += std::log(record.seconds / old.seconds);
+    if (record.chosen != old.chosen) {
+      flag(id, "model", old.chosen + " -> " + record.chosen);
+    }
+    if (record.seconds > old.seconds * (1.0 + settings.time_threshold)) {
+      flag(id, "time", change(old.seconds, record.seconds) + " s");
+    }
+    // Below 1 MB the peak is dominated by the process itself
+    if (record.peak_mb >
+        old.peak_mb * (1.0 + settings.memory_threshold) + 1.0) {
+      flag(id, "memory", change(old.peak_mb, record.peak_mb) + " MB");
+    }
+    if (is_less_accurate(old.coef_error, record.coef_error,
+                         settings.accuracy_threshold)) {
+      flag(id, "coef", change(old.coef_error, record.coef_error));
+    }
+    if (is_less_accurate(old.curve_error, record.curve_error,
+                         settings.accuracy_threshold)) {
+      flag(id, "curve", change(old.curve_error, record.curve_error));
+    }
+  }
+  if (unmatched > 0) {
+    std::cout << unmatched << " case(s) of " << base_path << " not in "
+              << new_path << "\n";
+  }
+  if (compared > 0) {
+    std::cout << compared << " cases compared, geometric mean time ratio "
+              << std::fixed << std::setprecision(3)
+              << std::exp(log_ratio / compared) << ", " << regressions
+              << " regression(s)\n";
+  }
+  return regressions == 0 ? 0 : 1;
+}
+
+void print_usage() {
+  std::cerr
+      << "Usage: fit_regression generate DIR [options]\n"
+         "       fit_regression run OUT.tsv [options]\n"
+         "       fit_regression compare BASE.tsv NEW.tsv [options]\n"
+         "       fit_regression rolling OUT.tsv [options]\n"
+         "\n"
+         "  --max-points N     Skip larger data sets (default 1000000;\n"
+         "                     the largest are 100000000 points)\n"
+         "  --filter TEXT      Only cases whose name contains TEXT\n"
+         "  --selection MODE   insample, loo or kfold (default insample)\n"
+         "  --refine           Refine exponential and power fits (LM)\n"
+         "  --min-time S       Repeat small fits for S seconds and keep the\n"
+         "                     fastest (default 0.2)\n"
+         "  --timeout S        Fail a case after S seconds (default 600)\n"
+         "  --time-threshold R     Flag fits slower by more than R\n"
+         "                         (default 0.10)\n"
+         "  --memory-threshold R   Flag peaks larger by more than R\n"
+         "                         (default 0.10)\n"
+         "  --accuracy-threshold R Flag errors larger by more than R\n"
+         "                         (default 0.05)\n"
+         "\n"
+         "run exits with status 1 if any case failed or missed its accuracy\n"
+         "bound, compare if any case regressed and rolling if any case\n"
+         "diverged from the fit from scratch.\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    print_usage();
+    return 2;
+  }
+  std::string command = argv[1];
+  std::vector<std::string> paths;
+  Settings settings;
+  for (int i = 2; i < argc; ++i) {
+    std::string argument = argv[i];
+    if (argument.rfind("--", 0) != 0) {
+      paths.push_back(argument);
+      continue;
+    }
+    if (argument == "--refine") {
+      settings.options.nonlinear_refinement = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      print_usage();
+      return 2;
+    }
+    std::string value = argv[++i];
+    if (argument == "--max-points") {
+      settings.max_points = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (argument == "--filter") {
+      settings.filter = value;
+    } else if (argument == "--selection") {
+      if (value == "insample") {
+        settings.options.selection = FitOptions::Selection::InSample;
+      } else if (value == "loo") {
+        settings.options.selection = FitOptions::Selection::LeaveOneOut;
+      } else if (value == "kfold") {
+        settings.options.selection = FitOptions::Selection::KFold;
+      } else {
+        print_usage();
+        return 2;
+      }
+    } else if (argument == "--min-time") {
+      settings.min_time = std::atof(value.c_str());
+    } else if (argument == "--timeout") {
+      settings.timeout = static_cast<unsigned>(std::atoi(value.c_str()));
+    } else if (argument == "--time-threshold") {
+      settings.time_threshold = std::atof(value.c_str());
+    } else if (argument == "--memory-threshold") {
+      settings.memory_threshold = std::atof(value.c_str());
+    } else if (argument == "--accuracy-threshold") {
+      settings.accuracy_threshold = std::atof(value.c_str());
+    } else {
+      print_usage();
+      return 2;
+    }
+  }
+
+  if (command == "generate" && paths.size() == 1) {
+    return run_generate(paths[0], settings);
+  }
+  if (command == "run" && paths.size() == 1) {
+    return run_corpus(paths[0], settings);
+  }
+  if (command == "compare" && paths.size() == 2) {
+    return run_compare(paths[0], paths[1], settings);
+  }
+  if (command == "rolling" && paths.size() == 1) {
+    return run_rolling(paths[0], settings);
+  }
+  print_usage();
+  return 2;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file live_fit_benchmark.cpp
+ * @brief Checks the fitting part of the latency budget of live editing.
+ *
+ * A table of points is fitted through LiveFitWorker with the options of the
+ * main window, one edited point per snapshot, and the time from submitting
+ * a snapshot to receiving its fit is recorded. A second run submits a large
+ * snapshot and, while it is being fitted, a small one, so the time until
+ * the small one arrives shows how quickly the outdated fit is cancelled;
+ * the fit polls the flag every few thousand rows, so the delay grows with
+ * the size of the outdated snapshot.
+ * Drawing the graph is not part of the measurement, so the fit has to stay
+ * well inside LiveFitWorker::BUDGET_MS for the whole refresh to meet it.
+ */
+
+#include "fit_options.hpp"
+#include "latency_recorder.hpp"
+#include "live_fit.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Settings {
+  int points{10000};
+  int refreshes{200};
+  int stale_points{100000};
+};
+
+LiveFitWorker::Request make_request(int points, std::uint64_t generation) {
+  std::mt19937_64 random(generation);
+  std::normal_distribution<double> noise(0.0, 0.05);
+  LiveFitWorker::Request request;
+  request.generation = generation;
+  for (int i = 0; i < points; ++i) {
+    auto x = 1.0 + 9.0 * i / points;
+    request.x.push_back(x);
+    request.y.push_back(2.0 * std::exp(0.3 * x) * (1.0 + noise(random)));
+    request.w.push_back(1.0);
+  }
+  return request;
+}
+
+/**
+ * @brief Receives the fits of a worker and lets the caller wait for one.
+ */
+class Receiver {
+private:
+  std::mutex mutex;
+  std::condition_variable arrived;
+  std::uint64_t generation{0};
+  std::string error;
+
+public:
+  void deliver(LiveFitWorker::Request &&request, FitResult &&result, double) {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation = request.generation;
+    error = result.error;
+    arrived.notify_one();
+  }
+
+  /**
+   * @brief Waits for the fit of a generation and returns its error.
+   */
+  std::string wait(std::uint64_t wanted) {
+    std::unique_lock<std::mutex> lock(mutex);
+    arrived.wait(lock, [&] { return generation == wanted; });
+    return error;
+  }
+};
+
+void print_usage() {
+  std::fprintf(stderr,
+               "Usage: live_fit_benchmark [--points P] [--refreshes R]\n"
+               "                          [--stale-points S]\n"
+               "\n"
+               "  --points P        Points in the table (default 10000)\n"
+               "  --refreshes R     Snapshots fitted one after another\n"
+               "                    (default 200)\n"
+               "  --stale-points S  Points of the snapshot that a newer one\n"
+               "                    cancels (default 100000)\n"
+               "\n"
+               "Exits with status 1 if the p99 latency of either run is over\n"
+               "the budget.\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Settings settings;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    if (i + 1 >= argc) {
+      print_usage();
+      return 2;
+    }
+    if (argument == "--points") {
+      settings.points = std::atoi(argv[++i]);
+    } else if (argument == "--refreshes") {
+      settings.refreshes = std::atoi(argv[++i]);
+    } else if (argument == "--stale-points") {
+      settings.stale_points = std::atoi(argv[++i]);
+    } else {
+      print_usage();
+      return 2;
+    }
+  }
+  if (settings.points < 2 || settings.refreshes < 1 ||
+      settings.stale_points < 2) {
+    print_usage();
+    return 2;
+  }
+
+  // The options of MainWindow
+  FitOptions options;
+  options.nonlinear_refinement = true;
+  options.selection = FitOptions::Selection::LeaveOneOut;
+
+  Receiver receiver;
+  LiveFitWorker worker(options, [&](LiveFitWorker::Request &&request,
+                                    FitResult &&result, double fit_ms) {
+    receiver.deliver(std::move(request), std::move(result), fit_ms);
+  });
+
+  std::uint64_t generation = 0;
+  auto table = make_request(settings.points, ++generation);
+  worker.submit(table);
+  receiver.wait(generation);
+
+  // Edit one point per snapshot, as typing into the table does
+  LatencyRecorder refreshes;
+  std::mt19937_64 random(7);
+  for (int r = 0; r < settings.refreshes; ++r) {
+    auto request = table;
+    request.generation = ++generation;
+    request.y[random() % request.y.size()] *= 1.01;
+    auto start = Clock::now();
+    worker.submit(std::move(request));
+    auto error = receiver.wait(generation);
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    if (!error.empty()) {
+      std::fprintf(stderr, "refresh %d: %s\n", r, error.c_str());
+      return 1;
+    }
+    refreshes.record(elapsed.count());
+  }
+  std::printf("refresh of %d points: %s\n", settings.points,
+              refreshes.summary().c_str());
+
+  // Replace a large snapshot while it is being fitted
+  LatencyRecorder replacements;
+  auto stale = make_request(settings.stale_points, 0);
+  for (int r = 0; r < 10; ++r) {
+    stale.generation = ++generation;
+    worker.submit(stale);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    auto request = table;
+    request.generation = ++generation;
+    auto start = Clock::now();
+    worker.submit(std::move(request));
+    receiver.wait(generation);
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    replacements.record(elapsed.count());
+  }
+  std::printf("refresh cancelling a fit of %d points: %s\n",
+              settings.stale_points, replacements.summary().c_str());
+
+  auto passed = true;
+  for (auto const *recorder : {&refreshes, &replacements}) {
+    auto p99 = recorder->percentile(0.99) / 1000.0;
+    if (p99 > LiveFitWorker::BUDGET_MS) {
+      std::fprintf(stderr, "p99 of %.1f ms is over the %.0f ms budget\n",
+                   p99, LiveFitWorker::BUDGET_MS);
+      passed = false;
+    }
+  }
+  return passed ? 0 : 1;
+}
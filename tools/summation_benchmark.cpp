@@ -0,0 +1,135 @@
+/**
+ * @file summation_benchmark.cpp
+ * @brief Measures the throughput/accuracy trade-off of the accumulation
+ * modes.
+ *
+ * The first table accumulates the power sums of a quadratic fit of a long,
+ * offset series with plain, Kahan and pairwise sums and compares them with a
+ * long double reference. The second table runs the multivariate regression
+ * with double and float tiles and with compensated sums and compares the
+ * coefficients with the Kahan result.
+ */
+
+#include "multivariate_regression.hpp"
+#include "polynomial_moments.hpp"
+#include "summation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int DEGREE = 2;
+
+template <typename Accumulator>
+void benchmark_moments(char const *name, std::vector<double> const &x,
+                       std::vector<double> const &y,
+                       std::vector<long double> const &reference) {
+  auto start = Clock::now();
+  BasicPolynomialMoments<Accumulator> moments(DEGREE);
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    moments.add(x[i], y[i]);
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  auto matrix = moments.normal_matrix(DEGREE);
+  auto b = moments.right_hand_side(DEGREE);
+  std::vector<double> sums;
+  for (int k = 0; k <= 2 * DEGREE; ++k) {
+    sums.push_back(matrix[std::min(k, DEGREE)][k - std::min(k, DEGREE)]);
+  }
+  sums.insert(sums.end(), b.begin(), b.end());
+  auto error = 0.0L;
+  for (std::size_t k = 0; k < sums.size(); ++k) {
+    error = std::max(error, std::fabs(sums[k] - reference[k]) /
+                                std::fabs(reference[k]));
+  }
+  std::printf("%-12s %10.1f Mpoints/s   max relative error %.3Le\n", name,
+              static_cast<double>(x.size()) / elapsed.count() / 1e6, error);
+}
+
+template <typename Regression>
+std::vector<double> benchmark_regression(char const *name,
+                                         std::vector<double> const &rows,
+                                         int predictors,
+                                         std::vector<double> const &exact) {
+  Regression regression(predictors);
+  auto count = rows.size() / (predictors + 1);
+  auto start = Clock::now();
+  regression.accumulate(rows.data(), count);
+  auto coefficients = regression.solve();
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  auto error = 0.0;
+  for (std::size_t k = 0; k < coefficients.size() && !exact.empty(); ++k) {
+    error = std::max(error, std::fabs(coefficients[k] - exact[k]));
+  }
+  std::printf("%-20s %10.1f Mrows/s   max coefficient error %.3e\n", name,
+              static_cast<double>(count) / elapsed.count() / 1e6, error);
+  return coefficients;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  auto points = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000UL;
+  std::mt19937_64 random(42);
+  std::normal_distribution<double> noise(0.0, 0.01);
+
+  // A long series far from the origin, where power sums lose digits
+  std::vector<double> x(points);
+  std::vector<double> y(points);
+  for (std::size_t i = 0; i < points; ++i) {
+    x[i] = 1000.0 + 1e-4 * static_cast<double>(i) + noise(random);
+    y[i] = 3.0 + 0.5 * x[i] + noise(random);
+  }
+  std::vector<long double> reference(3 * DEGREE + 2, 0.0L);
+  for (std::size_t i = 0; i < points; ++i) {
+    long double power = 1.0L;
+    for (int k = 0; k <= 2 * DEGREE; ++k) {
+      reference[k] += power;
+      if (k <= DEGREE) {
+        reference[2 * DEGREE + 1 + k] += power * y[i];
+      }
+      power *= x[i];
+    }
+  }
+
+  std::printf("Power sums of a degree %d fit, %zu points\n", DEGREE, points);
+  benchmark_moments<PlainSum>("plain", x, y, reference);
+  benchmark_moments<KahanSum>("kahan", x, y, reference);
+  benchmark_moments<PairwiseSum>("pairwise", x, y, reference);
+
+  constexpr int PREDICTORS = 8;
+  auto count = points / 4;
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<double> rows(count * (PREDICTORS + 1));
+  for (std::size_t r = 0; r < count; ++r) {
+    auto *row = &rows[r * (PREDICTORS + 1)];
+    row[PREDICTORS] = 0.5 + noise(random);
+    for (int c = 0; c < PREDICTORS; ++c) {
+      row[c] = uniform(random);
+      row[PREDICTORS] += (c + 1) * row[c];
+    }
+  }
+
+  std::printf("\nMultivariate regression, %d predictors, %zu rows\n",
+              PREDICTORS, count);
+  auto exact =
+      benchmark_regression<BasicMultivariateRegression<double, KahanSum>>(
+          "double + kahan", rows, PREDICTORS, {});
+  benchmark_regression<BasicMultivariateRegression<double, PairwiseSum>>(
+      "double + pairwise", rows, PREDICTORS, exact);
+  benchmark_regression<MultivariateRegression>("double", rows, PREDICTORS,
+                                               exact);
+  benchmark_regression<BasicMultivariateRegression<float>>(
+      "float tiles", rows, PREDICTORS, exact);
+  return 0;
+}